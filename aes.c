@@ -0,0 +1,576 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * AES as specified in FIPS 197, in the ctr and cbc modes openssh uses for
+ * private keys. The portable kernel has no secret dependent table lookups
+ * or branches: the S-box is computed as the inverse in GF(2^8) followed by
+ * the affine map, for eight bytes at once in a 64 bit word.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "aes.h"
+#include "cpufeatures.h"
+#include "utilities.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define AES_X86_KERNELS
+# include <immintrin.h>
+#endif
+
+/* signatures of the mode kernels */
+typedef void (*aes_ctr_fn) (const struct aes_key *key, unsigned char ctr[AES_BLOCK_SIZE], unsigned char *buf, size_t len);
+typedef void (*aes_cbc_fn) (const struct aes_key *key, unsigned char iv[AES_BLOCK_SIZE], unsigned char *buf, size_t nblocks);
+
+/* selected kernels, resolved on first use */
+static aes_ctr_fn aes_ctr_kernel = NULL;
+static aes_cbc_fn aes_cbc_kernel = NULL;
+static const char *aes_kernel_label = NULL;
+
+/* advance the 128 bit big endian counter, which is not secret */
+static void aes_ctr_increment (unsigned char ctr[AES_BLOCK_SIZE])
+{
+    for (int i = AES_BLOCK_SIZE - 1; i >= 0 && ++ctr[i] == 0; i--)
+        ;
+}
+
+
+/* +---------------------------+ */
+/* | constant-time field math  | */
+/* +---------------------------+ */
+
+/* a byte repeated in all eight lanes */
+#define AES_BYTES(b) (0x0101010101010101ULL * (b))
+
+/* multiplication by x in every lane */
+static inline uint64_t aes_xtime8 (uint64_t a)
+{
+    return ((a & AES_BYTES(0x7f)) << 1) ^ (((a >> 7) & AES_BYTES(0x01)) * 0x1b);
+}
+
+/* lane-wise product, bits of b are turned into masks instead of branches */
+static uint64_t aes_gmul8 (uint64_t a, uint64_t b)
+{
+    uint64_t p = 0;
+
+    for (int i = 0; i < 8; i++) {
+        p ^= a & (((b >> i) & AES_BYTES(0x01)) * 0xff);
+        a = aes_xtime8(a);
+    }
+    return p;
+}
+
+/* lane-wise inverse as x^254, with 0 mapped to 0 */
+static uint64_t aes_inv8 (uint64_t x)
+{
+    uint64_t x2, x3, x12, x15, y;
+
+    x2  = aes_gmul8(x, x);
+    x3  = aes_gmul8(x2, x);
+    x12 = aes_gmul8(x3, x3);
+    x12 = aes_gmul8(x12, x12);
+    x15 = aes_gmul8(x12, x3);
+    y   = aes_gmul8(x15, x15);              /* x^30 */
+    y   = aes_gmul8(y, y);                  /* x^60 */
+    y   = aes_gmul8(y, y);                  /* x^120 */
+    y   = aes_gmul8(y, y);                  /* x^240 */
+    y   = aes_gmul8(y, x12);                /* x^252 */
+    return aes_gmul8(y, x2);
+}
+
+/* lane-wise rotation */
+#define AES_ROTL8(x, n) \
+    ((((x) << (n)) & AES_BYTES((0xff << (n)) & 0xff)) | (((x) >> (8 - (n))) & AES_BYTES(0xff >> (8 - (n)))))
+
+static inline uint64_t aes_sbox8 (uint64_t x)
+{
+    uint64_t b = aes_inv8(x);
+    return b ^ AES_ROTL8(b, 1) ^ AES_ROTL8(b, 2) ^ AES_ROTL8(b, 3) ^ AES_ROTL8(b, 4) ^ AES_BYTES(0x63);
+}
+
+static inline uint64_t aes_inv_sbox8 (uint64_t x)
+{
+    return aes_inv8(AES_ROTL8(x, 1) ^ AES_ROTL8(x, 3) ^ AES_ROTL8(x, 6) ^ AES_BYTES(0x05));
+}
+
+#undef AES_ROTL8
+
+
+/* +-----------------+ */
+/* | key expansion   | */
+/* +-----------------+ */
+
+int aes_setkey (struct aes_key *key, const unsigned char *k, size_t keylen)
+{
+    unsigned char *w = &key->rk[0][0], t[8] = { 0 }, rcon = 0x01;
+    size_t nk = keylen / 4, nwords;
+    uint64_t lanes;
+
+    if (keylen != 16 && keylen != 24 && keylen != 32)
+        return -1;
+    key->rounds = nk + 6;
+    nwords = 4 * (key->rounds + 1);
+
+    memcpy(w, k, keylen);
+    for (size_t i = nk; i < nwords; i++) {
+        memcpy(t, w + 4 * (i - 1), 4);
+
+        /* RotWord and SubWord, on every nk-th word and in the middle for 256 bit keys */
+        if (i % nk == 0 || (nk > 6 && i % nk == 4)) {
+            if (i % nk == 0) {
+                unsigned char first = t[0];
+                memmove(t, t + 1, 3);
+                t[3] = first;
+            }
+            memcpy(&lanes, t, 8);
+            lanes = aes_sbox8(lanes);
+            memcpy(t, &lanes, 8);
+            if (i % nk == 0) {
+                t[0] ^= rcon;
+                rcon = aes_xtime8(rcon);
+            }
+        }
+
+        for (int j = 0; j < 4; j++)
+            w[4 * i + j] = w[4 * (i - nk) + j] ^ t[j];
+    }
+
+    memzero(t, sizeof t);
+    memzero(&lanes, sizeof lanes);
+    return 0;
+}
+
+void aes_clearkey (struct aes_key *key)
+{
+    memzero(key, sizeof *key);
+}
+
+
+/* +-----------------+ */
+/* | portable kernel | */
+/* +-----------------+ */
+
+/* the state is column major, byte r + 4c is row r of column c */
+static void aes_subbytes (unsigned char s[AES_BLOCK_SIZE], int inverse)
+{
+    uint64_t lo, hi;
+
+    memcpy(&lo, s, 8);
+    memcpy(&hi, s + 8, 8);
+    lo = inverse ? aes_inv_sbox8(lo) : aes_sbox8(lo);
+    hi = inverse ? aes_inv_sbox8(hi) : aes_sbox8(hi);
+    memcpy(s, &lo, 8);
+    memcpy(s + 8, &hi, 8);
+}
+
+/* row r rotates left by r columns, or right when inverse */
+static void aes_shiftrows (unsigned char s[AES_BLOCK_SIZE], int inverse)
+{
+    unsigned char t[AES_BLOCK_SIZE];
+
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++) {
+            if (inverse)
+                t[r + 4 * ((c + r) % 4)] = s[r + 4 * c];
+            else
+                t[r + 4 * c] = s[r + 4 * ((c + r) % 4)];
+        }
+    memcpy(s, t, sizeof t);
+}
+
+static void aes_mixcolumns (unsigned char s[AES_BLOCK_SIZE], int inverse)
+{
+    unsigned char a0, a1, a2, a3, t, u, v;
+
+    for (int c = 0; c < 4; c++) {
+        a0 = s[4 * c]; a1 = s[4 * c + 1]; a2 = s[4 * c + 2]; a3 = s[4 * c + 3];
+
+        /* the inverse matrix is the forward one times { 05 00 04 00 } */
+        if (inverse) {
+            u = aes_xtime8(aes_xtime8(a0 ^ a2));
+            v = aes_xtime8(aes_xtime8(a1 ^ a3));
+            a0 ^= u; a1 ^= v; a2 ^= u; a3 ^= v;
+        }
+
+        t = a0 ^ a1 ^ a2 ^ a3;
+        s[4 * c]     = a0 ^ t ^ aes_xtime8(a0 ^ a1);
+        s[4 * c + 1] = a1 ^ t ^ aes_xtime8(a1 ^ a2);
+        s[4 * c + 2] = a2 ^ t ^ aes_xtime8(a2 ^ a3);
+        s[4 * c + 3] = a3 ^ t ^ aes_xtime8(a3 ^ a0);
+    }
+}
+
+static void aes_addroundkey (unsigned char s[AES_BLOCK_SIZE], const unsigned char rk[AES_BLOCK_SIZE])
+{
+    for (int i = 0; i < AES_BLOCK_SIZE; i++)
+        s[i] ^= rk[i];
+}
+
+static void aes_encrypt_portable (const struct aes_key *key, const unsigned char in[AES_BLOCK_SIZE], unsigned char out[AES_BLOCK_SIZE])
+{
+    unsigned char s[AES_BLOCK_SIZE];
+
+    memcpy(s, in, sizeof s);
+    aes_addroundkey(s, key->rk[0]);
+    for (unsigned int r = 1; r <= key->rounds; r++) {
+        aes_subbytes(s, 0);
+        aes_shiftrows(s, 0);
+        if (r < key->rounds)
+            aes_mixcolumns(s, 0);
+        aes_addroundkey(s, key->rk[r]);
+    }
+    memcpy(out, s, sizeof s);
+    memzero(s, sizeof s);
+}
+
+static void aes_decrypt_portable (const struct aes_key *key, const unsigned char in[AES_BLOCK_SIZE], unsigned char out[AES_BLOCK_SIZE])
+{
+    unsigned char s[AES_BLOCK_SIZE];
+
+    memcpy(s, in, sizeof s);
+    aes_addroundkey(s, key->rk[key->rounds]);
+    for (unsigned int r = key->rounds; r-- > 0; ) {
+        aes_shiftrows(s, 1);
+        aes_subbytes(s, 1);
+        aes_addroundkey(s, key->rk[r]);
+        if (r > 0)
+            aes_mixcolumns(s, 1);
+    }
+    memcpy(out, s, sizeof s);
+    memzero(s, sizeof s);
+}
+
+static void aes_ctr_portable (const struct aes_key *key, unsigned char ctr[AES_BLOCK_SIZE], unsigned char *buf, size_t len)
+{
+    unsigned char keystream[AES_BLOCK_SIZE];
+    size_t n;
+
+    while (len > 0) {
+        aes_encrypt_portable(key, ctr, keystream);
+        aes_ctr_increment(ctr);
+        n = len < AES_BLOCK_SIZE ? len : AES_BLOCK_SIZE;
+        for (size_t i = 0; i < n; i++)
+            buf[i] ^= keystream[i];
+        buf += n;
+        len -= n;
+    }
+    memzero(keystream, sizeof keystream);
+}
+
+static void aes_cbc_portable (const struct aes_key *key, unsigned char iv[AES_BLOCK_SIZE], unsigned char *buf, size_t nblocks)
+{
+    unsigned char cipher[AES_BLOCK_SIZE], plain[AES_BLOCK_SIZE];
+
+    while (nblocks-- > 0) {
+        memcpy(cipher, buf, sizeof cipher);
+        aes_decrypt_portable(key, cipher, plain);
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+            buf[i] = plain[i] ^ iv[i];
+        memcpy(iv, cipher, sizeof cipher);
+        buf += AES_BLOCK_SIZE;
+    }
+    memzero(plain, sizeof plain);
+}
+
+
+#ifdef AES_X86_KERNELS
+
+/* +--------------------+ */
+/* | x86 aes-ni kernels | */
+/* +--------------------+ */
+
+/* blocks in flight, enough to cover the latency of aesenc */
+#define AES_NI_LANES 8
+
+/* the ctr counter as two native words, so that counter blocks are built in
+   registers rather than stored bytewise and loaded again */
+struct aes_counter {
+    uint64_t hi, lo;
+};
+
+static void aes_counter_load (struct aes_counter *c, const unsigned char ctr[AES_BLOCK_SIZE])
+{
+    c->hi = c->lo = 0;
+    for (int i = 0; i < 8; i++) {
+        c->hi = c->hi << 8 | ctr[i];
+        c->lo = c->lo << 8 | ctr[8 + i];
+    }
+}
+
+static void aes_counter_store (const struct aes_counter *c, unsigned char ctr[AES_BLOCK_SIZE])
+{
+    for (int i = 0; i < 8; i++) {
+        ctr[7 - i]  = c->hi >> (8 * i);
+        ctr[15 - i] = c->lo >> (8 * i);
+    }
+}
+
+/* the current counter block, then advance */
+__attribute__((target("sse2"), always_inline))
+static inline __m128i aes_counter_next (struct aes_counter *c)
+{
+    __m128i block = _mm_set_epi64x(__builtin_bswap64(c->lo), __builtin_bswap64(c->hi));
+
+    if (++c->lo == 0)
+        c->hi++;
+    return block;
+}
+
+__attribute__((target("aes,sse2")))
+static void aes_ctr_aesni (const struct aes_key *key, unsigned char ctr[AES_BLOCK_SIZE], unsigned char *buf, size_t len)
+{
+    __m128i rk[AES_MAXROUNDS + 1], b[AES_NI_LANES];
+    unsigned char keystream[AES_BLOCK_SIZE];
+    struct aes_counter counter;
+    unsigned int rounds = key->rounds;
+    size_t n;
+
+    for (unsigned int r = 0; r <= rounds; r++)
+        rk[r] = _mm_load_si128((const __m128i *)key->rk[r]);
+
+    /* full batches with a fixed lane count, which the compiler keeps in registers */
+    aes_counter_load(&counter, ctr);
+    while (len >= AES_NI_LANES * AES_BLOCK_SIZE) {
+        for (size_t i = 0; i < AES_NI_LANES; i++)
+            b[i] = _mm_xor_si128(aes_counter_next(&counter), rk[0]);
+        for (unsigned int r = 1; r < rounds; r++)
+            for (size_t i = 0; i < AES_NI_LANES; i++)
+                b[i] = _mm_aesenc_si128(b[i], rk[r]);
+        for (size_t i = 0; i < AES_NI_LANES; i++) {
+            b[i] = _mm_aesenclast_si128(b[i], rk[rounds]);
+            _mm_storeu_si128((__m128i *)buf, _mm_xor_si128(_mm_loadu_si128((const __m128i *)buf), b[i]));
+            buf += AES_BLOCK_SIZE;
+        }
+        len -= AES_NI_LANES * AES_BLOCK_SIZE;
+    }
+
+    /* the rest, a partial last block through the keystream buffer */
+    while (len > 0) {
+        n = len < AES_BLOCK_SIZE ? len : AES_BLOCK_SIZE;
+        b[0] = _mm_xor_si128(aes_counter_next(&counter), rk[0]);
+        for (unsigned int r = 1; r < rounds; r++)
+            b[0] = _mm_aesenc_si128(b[0], rk[r]);
+        _mm_storeu_si128((__m128i *)keystream, _mm_aesenclast_si128(b[0], rk[rounds]));
+        for (size_t j = 0; j < n; j++)
+            buf[j] ^= keystream[j];
+        buf += n;
+        len -= n;
+    }
+    aes_counter_store(&counter, ctr);
+    memzero(keystream, sizeof keystream);
+}
+
+/* decryption round keys, in reverse order and through InvMixColumns */
+__attribute__((target("aes,sse2"), always_inline))
+static inline void aes_ni_decryption_keys (const struct aes_key *key, __m128i *dk)
+{
+    dk[0] = _mm_load_si128((const __m128i *)key->rk[key->rounds]);
+    for (unsigned int r = 1; r < key->rounds; r++)
+        dk[r] = _mm_aesimc_si128(_mm_load_si128((const __m128i *)key->rk[key->rounds - r]));
+    dk[key->rounds] = _mm_load_si128((const __m128i *)key->rk[0]);
+}
+
+__attribute__((target("aes,sse2")))
+static void aes_cbc_aesni (const struct aes_key *key, unsigned char iv[AES_BLOCK_SIZE], unsigned char *buf, size_t nblocks)
+{
+    __m128i dk[AES_MAXROUNDS + 1], c[AES_NI_LANES], b[AES_NI_LANES], prev;
+    unsigned int rounds = key->rounds;
+    size_t lanes;
+
+    aes_ni_decryption_keys(key, dk);
+    prev = _mm_loadu_si128((const __m128i *)iv);
+
+    while (nblocks > 0) {
+        lanes = nblocks < AES_NI_LANES ? nblocks : AES_NI_LANES;
+
+        /* keep the ciphertext, the blocks are overwritten in place */
+        for (size_t i = 0; i < lanes; i++) {
+            c[i] = _mm_loadu_si128((const __m128i *)buf + i);
+            b[i] = _mm_xor_si128(c[i], dk[0]);
+        }
+        for (unsigned int r = 1; r < rounds; r++)
+            for (size_t i = 0; i < lanes; i++)
+                b[i] = _mm_aesdec_si128(b[i], dk[r]);
+        for (size_t i = 0; i < lanes; i++) {
+            b[i] = _mm_xor_si128(_mm_aesdeclast_si128(b[i], dk[rounds]), prev);
+            _mm_storeu_si128((__m128i *)buf + i, b[i]);
+            prev = c[i];
+        }
+
+        buf += lanes * AES_BLOCK_SIZE;
+        nblocks -= lanes;
+    }
+    _mm_storeu_si128((__m128i *)iv, prev);
+}
+
+/* +------------------+ */
+/* | x86 vaes kernels | */
+/* +------------------+ */
+
+/* four blocks per register, sixteen in flight */
+#define AES_VAES_REGS   4
+#define AES_VAES_BLOCKS ( 4 * AES_VAES_REGS )
+
+__attribute__((target("vaes,avx512f,avx512bw,aes")))
+static void aes_ctr_vaes (const struct aes_key *key, unsigned char ctr[AES_BLOCK_SIZE], unsigned char *buf, size_t len)
+{
+    __m512i rk[AES_MAXROUNDS + 1], b[AES_VAES_REGS];
+    struct aes_counter counter;
+    unsigned int rounds = key->rounds;
+
+    for (unsigned int r = 0; r <= rounds; r++)
+        rk[r] = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *)key->rk[r]));
+
+    aes_counter_load(&counter, ctr);
+    while (len >= AES_VAES_BLOCKS * AES_BLOCK_SIZE) {
+        for (size_t i = 0; i < AES_VAES_REGS; i++) {
+            b[i] = _mm512_castsi128_si512(aes_counter_next(&counter));
+            b[i] = _mm512_inserti32x4(b[i], aes_counter_next(&counter), 1);
+            b[i] = _mm512_inserti32x4(b[i], aes_counter_next(&counter), 2);
+            b[i] = _mm512_inserti32x4(b[i], aes_counter_next(&counter), 3);
+            b[i] = _mm512_xor_si512(b[i], rk[0]);
+        }
+        for (unsigned int r = 1; r < rounds; r++)
+            for (size_t i = 0; i < AES_VAES_REGS; i++)
+                b[i] = _mm512_aesenc_epi128(b[i], rk[r]);
+        for (size_t i = 0; i < AES_VAES_REGS; i++) {
+            b[i] = _mm512_aesenclast_epi128(b[i], rk[rounds]);
+            _mm512_storeu_si512((void *)(buf + 64 * i), _mm512_xor_si512(_mm512_loadu_si512((const void *)(buf + 64 * i)), b[i]));
+        }
+
+        buf += AES_VAES_BLOCKS * AES_BLOCK_SIZE;
+        len -= AES_VAES_BLOCKS * AES_BLOCK_SIZE;
+    }
+    aes_counter_store(&counter, ctr);
+
+    /* the aes-ni kernel is not vex encoded and would stall on dirty upper halves */
+    _mm256_zeroupper();
+    aes_ctr_aesni(key, ctr, buf, len);
+}
+
+__attribute__((target("vaes,avx512f,avx512bw,aes")))
+static void aes_cbc_vaes (const struct aes_key *key, unsigned char iv[AES_BLOCK_SIZE], unsigned char *buf, size_t nblocks)
+{
+    __m128i dk128[AES_MAXROUNDS + 1];
+    __m512i dk[AES_MAXROUNDS + 1], c[AES_VAES_REGS], b[AES_VAES_REGS];
+    unsigned char prev[AES_VAES_BLOCKS][AES_BLOCK_SIZE] __attribute__((aligned(64)));
+    unsigned int rounds = key->rounds;
+
+    aes_ni_decryption_keys(key, dk128);
+    for (unsigned int r = 0; r <= rounds; r++)
+        dk[r] = _mm512_broadcast_i32x4(dk128[r]);
+
+    while (nblocks >= AES_VAES_BLOCKS) {
+        /* the block before each block, which is overwritten in place */
+        memcpy(prev[0], iv, AES_BLOCK_SIZE);
+        memcpy(prev[1], buf, (AES_VAES_BLOCKS - 1) * AES_BLOCK_SIZE);
+        memcpy(iv, buf + (AES_VAES_BLOCKS - 1) * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+
+        for (size_t i = 0; i < AES_VAES_REGS; i++) {
+            c[i] = _mm512_loadu_si512((const void *)(buf + 64 * i));
+            b[i] = _mm512_xor_si512(c[i], dk[0]);
+        }
+        for (unsigned int r = 1; r < rounds; r++)
+            for (size_t i = 0; i < AES_VAES_REGS; i++)
+                b[i] = _mm512_aesdec_epi128(b[i], dk[r]);
+        for (size_t i = 0; i < AES_VAES_REGS; i++) {
+            b[i] = _mm512_aesdeclast_epi128(b[i], dk[rounds]);
+            b[i] = _mm512_xor_si512(b[i], _mm512_load_si512((const void *)prev[4 * i]));
+            _mm512_storeu_si512((void *)(buf + 64 * i), b[i]);
+        }
+
+        buf += AES_VAES_BLOCKS * AES_BLOCK_SIZE;
+        nblocks -= AES_VAES_BLOCKS;
+    }
+
+    _mm256_zeroupper();
+    aes_cbc_aesni(key, iv, buf, nblocks);
+}
+
+#endif /* AES_X86_KERNELS */
+
+
+/* +----------+ */
+/* | dispatch | */
+/* +----------+ */
+
+/* all kernels, hardware first, with the cpu features each one uses */
+static const struct {
+    const char *name;
+    unsigned int features;
+    aes_ctr_fn ctr;
+    aes_cbc_fn cbc;
+} aes_kernels[] = {
+#ifdef AES_X86_KERNELS
+    { "vaes",       CPU_MASK(CPU_VAES) | CPU_MASK(CPU_AVX512BW) | CPU_MASK(CPU_AES),
+                    aes_ctr_vaes,       aes_cbc_vaes        },
+    { "aes-ni",     CPU_MASK(CPU_AES),
+                    aes_ctr_aesni,      aes_cbc_aesni       },
+#endif
+    { "portable",   0,
+                    aes_ctr_portable,   aes_cbc_portable    },
+};
+#define n_aes_kernels (sizeof aes_kernels / sizeof *aes_kernels)
+
+static void aes_kernels_install (size_t i)
+{
+    aes_kernel_label = aes_kernels[i].name;
+    aes_ctr_kernel = aes_kernels[i].ctr;
+    aes_cbc_kernel = aes_kernels[i].cbc;
+}
+
+/* pick the hardware kernels if the enabled cpu features allow, portable needs none */
+void aes_kernels_resolve ()
+{
+    size_t i = 0;
+    while ((aes_kernels[i].features & ~cpu_features()) != 0)
+        i++;
+    aes_kernels_install(i);
+}
+
+/* install kernels by name, if the enabled cpu features allow them */
+int aes_kernels_select (const char *name)
+{
+    for (size_t i = 0; i < n_aes_kernels; i++)
+        if (strcmp(aes_kernels[i].name, name) == 0) {
+            if ((aes_kernels[i].features & ~cpu_features()) != 0)
+                return -1;
+            aes_kernels_install(i);
+            return 0;
+        }
+    return -1;
+}
+
+const char *aes_kernels_list (size_t i)
+{
+    return i < n_aes_kernels ? aes_kernels[i].name : NULL;
+}
+
+const char *aes_kernel_name ()
+{
+    if (aes_kernel_label == NULL)
+        aes_kernels_resolve();
+    return aes_kernel_label;
+}
+
+
+/* +-------+ */
+/* | modes | */
+/* +-------+ */
+
+void aes_ctr (const struct aes_key *key, unsigned char ctr[AES_BLOCK_SIZE], unsigned char *buf, size_t len)
+{
+    if (aes_ctr_kernel == NULL)
+        aes_kernels_resolve();
+    aes_ctr_kernel(key, ctr, buf, len);
+}
+
+void aes_cbc_decrypt (const struct aes_key *key, unsigned char iv[AES_BLOCK_SIZE], unsigned char *buf, size_t nblocks)
+{
+    if (aes_cbc_kernel == NULL)
+        aes_kernels_resolve();
+    aes_cbc_kernel(key, iv, buf, nblocks);
+}
@@ -0,0 +1,50 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_aes_h_
+#define _headerguard_aes_h_
+
+#include <stddef.h>
+
+/****************************************************************************************/
+
+#define AES_BLOCK_SIZE 16
+#define AES_MAXROUNDS  14
+
+/* expanded key, the round keys in the byte order of the state */
+struct aes_key {
+    unsigned char rk[AES_MAXROUNDS + 1][AES_BLOCK_SIZE] __attribute__((aligned(16)));
+    unsigned int rounds;
+};
+
+/****************************************************************************************/
+
+/* expand a 16, 24 or 32 byte key, returns 0 or -1 for other lengths */
+int aes_setkey (struct aes_key *key, const unsigned char *k, size_t keylen);
+
+/* wipe an expanded key */
+void aes_clearkey (struct aes_key *key);
+
+/* ctr mode in place on len bytes, the whole block is the big endian counter
+   as in openssh. ctr is advanced by the blocks used, a partial one included */
+void aes_ctr (const struct aes_key *key, unsigned char ctr[AES_BLOCK_SIZE], unsigned char *buf, size_t len);
+
+/* cbc decryption in place on whole blocks, iv is replaced by the last ciphertext */
+void aes_cbc_decrypt (const struct aes_key *key, unsigned char iv[AES_BLOCK_SIZE], unsigned char *buf, size_t nblocks);
+
+/* select the kernels for the enabled cpu features, which otherwise happens on first use */
+void aes_kernels_resolve ();
+
+/* force the named kernels, returns -1 if unknown or not allowed on this cpu */
+int aes_kernels_select (const char *name);
+
+/* name of the i-th kernel built in, hardware first, NULL after the last */
+const char *aes_kernels_list (size_t i);
+
+/* name of the kernel selected for this cpu */
+const char *aes_kernel_name ();
+
+#endif
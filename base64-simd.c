@@ -0,0 +1,481 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * The vectorised decoding and encoding follows the approach described in:
+ *  - Wojciech Mula, Daniel Lemire: "Faster Base64 Encoding and Decoding
+ *    Using AVX2 Instructions", ACM Transactions on the Web 12(3), 2018
+ *  - the SSSE3/AVX2 codecs of https://github.com/aklomp/base64
+ *    Copyright (c) 2005-2007, Nick Galbreath
+ *    Copyright (c) 2015-2018, Wojciech Mula
+ *    Copyright (c) 2016-2017, Matthieu Darbois
+ *    Copyright (c) 2013-2019, Alfred Klomp
+ *    (BSD 2-Clause License)
+ */
+
+#include <string.h>
+
+#include "base64-simd.h"
+#include "cpufeatures.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define B64_X86_KERNELS
+# include <immintrin.h>
+#endif
+
+/* signatures of all decoding and encoding kernels */
+typedef size_t (*b64_decode_fn) (const char *src, size_t srclen, unsigned char *dst, size_t dstlen);
+typedef size_t (*b64_encode_fn) (const unsigned char *src, size_t srclen, char *dst);
+
+/* selected kernels, resolved on first use */
+static b64_decode_fn b64_decode_kernel = NULL;
+static b64_encode_fn b64_encode_kernel = NULL;
+static const char *b64_kernel_label = NULL;
+
+#define SPC B64_SPACE
+#define PAD B64_PAD
+#define BAD B64_INVALID
+
+/* 6 bit values of the alphabet, whitespace as in isspace() in the C locale */
+const unsigned char b64_decode_table[256] = {
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, SPC, SPC, SPC, SPC, SPC, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    SPC, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,  62, BAD, BAD, BAD,  63,
+     52,  53,  54,  55,  56,  57,  58,  59,  60,  61, BAD, BAD, BAD, PAD, BAD, BAD,
+    BAD,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, BAD, BAD, BAD, BAD, BAD,
+    BAD,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+    BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD, BAD,
+};
+
+#undef SPC
+#undef PAD
+#undef BAD
+
+
+/* +---------------+ */
+/* | scalar kernel | */
+/* +---------------+ */
+
+/* one quantum of four characters at a time through the lookup table */
+static size_t b64_decode_scalar (const char *src, size_t srclen, unsigned char *dst, size_t dstlen)
+{
+    const unsigned char *in = (const unsigned char *)src;
+    size_t consumed = 0, written = 0;
+    unsigned char a, b, c, d;
+
+    while (srclen - consumed >= 4 && dstlen - written >= 3) {
+        a = b64_decode_table[in[consumed]];
+        b = b64_decode_table[in[consumed + 1]];
+        c = b64_decode_table[in[consumed + 2]];
+        d = b64_decode_table[in[consumed + 3]];
+
+        /* anything but a 6 bit value ends the run */
+        if ((a | b | c | d) & 0xc0)
+            break;
+
+        dst[written]     = a << 2 | b >> 4;
+        dst[written + 1] = b << 4 | c >> 2;
+        dst[written + 2] = c << 6 | d;
+        consumed += 4;
+        written  += 3;
+    }
+    return consumed;
+}
+
+
+#ifdef B64_X86_KERNELS
+
+/* +------------------------+ */
+/* | x86 vectorised kernels | */
+/* +------------------------+ */
+
+/* translate 16 characters to 6 bit values, returns 0 if any was not in the alphabet */
+__attribute__((target("ssse3")))
+static inline int b64_translate_ssse3 (__m128i *str)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+           0,   16,   19,    4,  -65,  -65,  -71,  -71,
+           0,    0,    0,    0,    0,    0,    0,    0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+    /* classify by nibbles, a valid character has no bit in common */
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(*str, 4), mask_2f);
+    const __m128i lo_nibbles = _mm_and_si128(*str, mask_2f);
+    const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff)
+        return 0;
+
+    /* shift each range of the alphabet to its value */
+    const __m128i eq_2f = _mm_cmpeq_epi8(*str, mask_2f);
+    const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    *str = _mm_add_epi8(*str, roll);
+    return 1;
+}
+
+/* 16 characters to 12 bytes per step */
+__attribute__((target("ssse3")))
+static size_t b64_decode_ssse3 (const char *src, size_t srclen, unsigned char *dst, size_t dstlen)
+{
+    size_t consumed = 0, written = 0;
+    __m128i str;
+
+    /* stores are 16 bytes wide, of which 12 are valid */
+    while (srclen - consumed >= 16 && dstlen - written >= 16) {
+        str = _mm_loadu_si128((const __m128i *)(src + consumed));
+        if (!b64_translate_ssse3(&str))
+            break;
+
+        /* pack four 6 bit values into three bytes in each 32 bit lane */
+        str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+        str = _mm_shuffle_epi8(str, _mm_setr_epi8(
+             2,  1,  0,  6,  5,  4, 10,  9,  8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *)(dst + written), str);
+
+        consumed += 16;
+        written  += 12;
+    }
+    return consumed + b64_decode_scalar(src + consumed, srclen - consumed, dst + written, dstlen - written);
+}
+
+/* 32 characters to 24 bytes per step */
+__attribute__((target("avx2")))
+static size_t b64_decode_avx2 (const char *src, size_t srclen, unsigned char *dst, size_t dstlen)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+           0,   16,   19,    4,  -65,  -65,  -71,  -71,
+           0,    0,    0,    0,    0,    0,    0,    0,
+           0,   16,   19,    4,  -65,  -65,  -71,  -71,
+           0,    0,    0,    0,    0,    0,    0,    0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    size_t consumed = 0, written = 0;
+    __m256i str, hi_nibbles, lo_nibbles, hi, lo, roll;
+
+    /* stores are 32 bytes wide, of which 24 are valid */
+    while (srclen - consumed >= 32 && dstlen - written >= 32) {
+        str = _mm256_loadu_si256((const __m256i *)(src + consumed));
+
+        /* classify by nibbles, a valid character has no bit in common */
+        hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        lo_nibbles = _mm256_and_si256(str, mask_2f);
+        hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+
+        /* shift each range of the alphabet to its value */
+        roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(str, mask_2f), hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        /* pack to three bytes per lane, then close the gaps between 128 bit halves */
+        str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+        str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(
+             2,  1,  0,  6,  5,  4, 10,  9,  8, 14, 13, 12, -1, -1, -1, -1,
+             2,  1,  0,  6,  5,  4, 10,  9,  8, 14, 13, 12, -1, -1, -1, -1));
+        str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+        _mm256_storeu_si256((__m256i *)(dst + written), str);
+
+        consumed += 32;
+        written  += 24;
+    }
+    /* the ssse3 kernel is not vex encoded and would stall on dirty upper halves */
+    _mm256_zeroupper();
+    return consumed + b64_decode_ssse3(src + consumed, srclen - consumed, dst + written, dstlen - written);
+}
+
+/* 7 bit lookup for vpermi2b, 0x80 marks anything outside the alphabet */
+static const unsigned char b64_vbmi_lut[128] __attribute__((aligned(64))) = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x3e, 0x80, 0x80, 0x80, 0x3f,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+    0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0x80, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+/* byte order of the 48 valid output bytes after packing */
+static const unsigned char b64_vbmi_pack[64] __attribute__((aligned(64))) = {
+     2,  1,  0,  6,  5,  4, 10,  9,  8, 14, 13, 12, 18, 17, 16, 22,
+    21, 20, 26, 25, 24, 30, 29, 28, 34, 33, 32, 38, 37, 36, 42, 41,
+    40, 46, 45, 44, 50, 49, 48, 54, 53, 52, 58, 57, 56, 62, 61, 60,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+/* 64 characters to 48 bytes per step */
+__attribute__((target("avx512f,avx512bw,avx512vbmi,avx2")))
+static size_t b64_decode_avx512vbmi (const char *src, size_t srclen, unsigned char *dst, size_t dstlen)
+{
+    const __m512i lut_lo = _mm512_load_si512((const void *)b64_vbmi_lut);
+    const __m512i lut_hi = _mm512_load_si512((const void *)(b64_vbmi_lut + 64));
+    const __m512i pack = _mm512_load_si512((const void *)b64_vbmi_pack);
+    size_t consumed = 0, written = 0;
+    __m512i str, val;
+
+    /* masked stores write exactly 48 bytes */
+    while (srclen - consumed >= 64 && dstlen - written >= 48) {
+        str = _mm512_loadu_si512((const void *)(src + consumed));
+
+        /* translate low 7 bits, high bit in input or result means invalid */
+        val = _mm512_permutex2var_epi8(lut_lo, str, lut_hi);
+        if (_mm512_movepi8_mask(_mm512_or_si512(str, val)) != 0)
+            break;
+
+        /* pack four 6 bit values into three bytes in each 32 bit lane */
+        val = _mm512_maddubs_epi16(val, _mm512_set1_epi32(0x01400140));
+        val = _mm512_madd_epi16(val, _mm512_set1_epi32(0x00011000));
+        val = _mm512_permutexvar_epi8(pack, val);
+        _mm512_mask_storeu_epi8(dst + written, 0x0000ffffffffffffULL, val);
+
+        consumed += 64;
+        written  += 48;
+    }
+    return consumed + b64_decode_avx2(src + consumed, srclen - consumed, dst + written, dstlen - written);
+}
+
+#endif /* B64_X86_KERNELS */
+
+
+/* +------------------+ */
+/* | encoding kernels | */
+/* +------------------+ */
+
+/* the base64 alphabet, indexed by 6 bit value */
+const char b64_encode_table[64] __attribute__((aligned(64))) =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* three bytes to four characters at a time through the alphabet */
+static size_t b64_encode_scalar (const unsigned char *src, size_t srclen, char *dst)
+{
+    const unsigned char *in = src, *end = src + srclen / 3 * 3;
+    unsigned int group;
+
+    while (in < end) {
+        group = (unsigned int)in[0] << 16 | (unsigned int)in[1] << 8 | in[2];
+        dst[0] = b64_encode_table[group >> 18];
+        dst[1] = b64_encode_table[group >> 12 & 0x3f];
+        dst[2] = b64_encode_table[group >> 6 & 0x3f];
+        dst[3] = b64_encode_table[group & 0x3f];
+        in  += 3;
+        dst += 4;
+    }
+    return (size_t)(in - src);
+}
+
+#ifdef B64_X86_KERNELS
+
+/* 12 bytes to 16 characters per step */
+__attribute__((target("ssse3")))
+static size_t b64_encode_ssse3 (const unsigned char *src, size_t srclen, char *dst)
+{
+    const __m128i lut_shift = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,      'A',        0,        0);
+    size_t consumed = 0, written = 0;
+    __m128i str, idx, hi, lo;
+
+    /* loads are 16 bytes wide, of which 12 are used */
+    while (srclen - consumed >= 16) {
+        str = _mm_loadu_si128((const __m128i *)(src + consumed));
+
+        /* spread each group of three bytes over a 32 bit lane as b1 b0 b2 b1 */
+        str = _mm_shuffle_epi8(str, _mm_setr_epi8(
+             1,  0,  2,  1,  4,  3,  5,  4,  7,  6,  8,  7, 10,  9, 11, 10));
+
+        /* shift the four 6 bit fields into the low bits of each byte */
+        hi = _mm_mulhi_epu16(_mm_and_si128(str, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        lo = _mm_mullo_epi16(_mm_and_si128(str, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        idx = _mm_or_si128(hi, lo);
+
+        /* 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12 */
+        str = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+        str = _mm_or_si128(str, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+        str = _mm_add_epi8(idx, _mm_shuffle_epi8(lut_shift, str));
+        _mm_storeu_si128((__m128i *)(dst + written), str);
+
+        consumed += 12;
+        written  += 16;
+    }
+    return consumed + b64_encode_scalar(src + consumed, srclen - consumed, dst + written);
+}
+
+/* 24 bytes to 32 characters per step */
+__attribute__((target("avx2")))
+static size_t b64_encode_avx2 (const unsigned char *src, size_t srclen, char *dst)
+{
+    const __m256i lut_shift = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,      'A',        0,        0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63,      'A',        0,        0);
+    size_t consumed = 0, written = 0;
+    __m256i str, idx, hi, lo;
+
+    /* two overlapping 16 byte loads, of which 12 are used each */
+    while (srclen - consumed >= 28) {
+        str = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                _mm_loadu_si128((const __m128i *)(src + consumed))),
+                _mm_loadu_si128((const __m128i *)(src + consumed + 12)), 1);
+
+        /* spread each group of three bytes over a 32 bit lane as b1 b0 b2 b1 */
+        str = _mm256_shuffle_epi8(str, _mm256_setr_epi8(
+             1,  0,  2,  1,  4,  3,  5,  4,  7,  6,  8,  7, 10,  9, 11, 10,
+             1,  0,  2,  1,  4,  3,  5,  4,  7,  6,  8,  7, 10,  9, 11, 10));
+
+        /* shift the four 6 bit fields into the low bits of each byte */
+        hi = _mm256_mulhi_epu16(_mm256_and_si256(str, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        lo = _mm256_mullo_epi16(_mm256_and_si256(str, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        idx = _mm256_or_si256(hi, lo);
+
+        /* 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12 */
+        str = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+        str = _mm256_or_si256(str, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx), _mm256_set1_epi8(13)));
+        str = _mm256_add_epi8(idx, _mm256_shuffle_epi8(lut_shift, str));
+        _mm256_storeu_si256((__m256i *)(dst + written), str);
+
+        consumed += 24;
+        written  += 32;
+    }
+    /* the ssse3 kernel is not vex encoded and would stall on dirty upper halves */
+    _mm256_zeroupper();
+    return consumed + b64_encode_ssse3(src + consumed, srclen - consumed, dst + written);
+}
+
+/* 48 bytes to 64 characters per step */
+__attribute__((target("avx512f,avx512bw,avx512vbmi,avx2")))
+static size_t b64_encode_avx512vbmi (const unsigned char *src, size_t srclen, char *dst)
+{
+    const __m512i alphabet = _mm512_load_si512((const void *)b64_encode_table);
+    /* b1 b0 b2 b1 for each group of three bytes */
+    const __m512i spread = _mm512_setr_epi32(
+        0x01020001, 0x04050304, 0x07080607, 0x0a0b090a, 0x0d0e0c0d, 0x10110f10, 0x13141213, 0x16171516,
+        0x191a1819, 0x1c1d1b1c, 0x1f201e1f, 0x22232122, 0x25262425, 0x28292728, 0x2b2c2a2b, 0x2e2f2d2e);
+    /* bit offsets of the four 6 bit fields within each 32 bit lane */
+    const __m512i shifts = _mm512_set1_epi64(0x3036242a1016040aULL);
+    size_t consumed = 0, written = 0;
+    __m512i str;
+
+    /* masked loads read exactly 48 bytes */
+    while (srclen - consumed >= 48) {
+        str = _mm512_maskz_loadu_epi8(0x0000ffffffffffffULL, src + consumed);
+        str = _mm512_permutexvar_epi8(spread, str);
+        str = _mm512_multishift_epi64_epi8(shifts, str);
+        str = _mm512_permutexvar_epi8(str, alphabet);
+        _mm512_storeu_si512((void *)(dst + written), str);
+
+        consumed += 48;
+        written  += 64;
+    }
+    return consumed + b64_encode_avx2(src + consumed, srclen - consumed, dst + written);
+}
+
+#endif /* B64_X86_KERNELS */
+
+
+/* +----------+ */
+/* | dispatch | */
+/* +----------+ */
+
+/* all kernels, widest first, with the cpu features each one uses including its tail */
+static const struct {
+    const char *name;
+    unsigned int features;
+    b64_decode_fn decode;
+    b64_encode_fn encode;
+} b64_kernels[] = {
+#ifdef B64_X86_KERNELS
+    { "avx512vbmi", CPU_MASK(CPU_AVX512VBMI) | CPU_MASK(CPU_AVX512BW) | CPU_MASK(CPU_AVX2) | CPU_MASK(CPU_SSSE3),
+                    b64_decode_avx512vbmi, b64_encode_avx512vbmi },
+    { "avx2",       CPU_MASK(CPU_AVX2) | CPU_MASK(CPU_SSSE3),
+                    b64_decode_avx2,       b64_encode_avx2       },
+    { "ssse3",      CPU_MASK(CPU_SSSE3),
+                    b64_decode_ssse3,      b64_encode_ssse3      },
+#endif
+    { "scalar",     0,
+                    b64_decode_scalar,     b64_encode_scalar     },
+};
+#define n_b64_kernels (sizeof b64_kernels / sizeof *b64_kernels)
+
+static void b64_kernels_install (size_t i)
+{
+    b64_kernel_label = b64_kernels[i].name;
+    b64_decode_kernel = b64_kernels[i].decode;
+    b64_encode_kernel = b64_kernels[i].encode;
+}
+
+/* pick the widest kernels the enabled cpu features allow, scalar needs none */
+void b64_kernels_resolve ()
+{
+    size_t i = 0;
+    while ((b64_kernels[i].features & ~cpu_features()) != 0)
+        i++;
+    b64_kernels_install(i);
+}
+
+/* install kernels by name, if the enabled cpu features allow them */
+int b64_kernels_select (const char *name)
+{
+    for (size_t i = 0; i < n_b64_kernels; i++)
+        if (strcmp(b64_kernels[i].name, name) == 0) {
+            if ((b64_kernels[i].features & ~cpu_features()) != 0)
+                return -1;
+            b64_kernels_install(i);
+            return 0;
+        }
+    return -1;
+}
+
+const char *b64_kernels_list (size_t i)
+{
+    return i < n_b64_kernels ? b64_kernels[i].name : NULL;
+}
+
+size_t b64_decode_blocks (const char *src, size_t srclen, unsigned char *dst, size_t dstlen)
+{
+    if (b64_decode_kernel == NULL)
+        b64_kernels_resolve();
+    return b64_decode_kernel(src, srclen, dst, dstlen);
+}
+
+size_t b64_encode_blocks (const unsigned char *src, size_t srclen, char *dst)
+{
+    if (b64_encode_kernel == NULL)
+        b64_kernels_resolve();
+    return b64_encode_kernel(src, srclen, dst);
+}
+
+const char *b64_kernel_name ()
+{
+    if (b64_kernel_label == NULL)
+        b64_kernels_resolve();
+    return b64_kernel_label;
+}
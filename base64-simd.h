@@ -0,0 +1,55 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * For additional notices see the file base64-simd.c
+ */
+
+#ifndef _headerguard_base64_simd_h_
+#define _headerguard_base64_simd_h_
+
+#include <stddef.h>
+
+/****************************************************************************************/
+
+/* classes in the decoding table besides the 6 bit values */
+#define B64_SPACE   0xfd  /* whitespace, skipped anywhere */
+#define B64_PAD     0xfe  /* padding character '=' */
+#define B64_INVALID 0xff  /* anything else */
+
+/* decoding table, indexed by character */
+extern const unsigned char b64_decode_table[256];
+
+/* the alphabet, indexed by 6 bit value */
+extern const char b64_encode_table[64];
+
+/* characters needed to encode len bytes, including padding */
+#define b64_encoded_len(len) (((len) + 2) / 3 * 4)
+
+/****************************************************************************************/
+
+/* decode whole blocks of base64 characters and stop in front of the first block which
+   holds anything else, i.e. whitespace, padding or invalid characters. returns the
+   number of characters consumed, always a multiple of four, which were decoded to
+   consumed / 4 * 3 bytes in dst. dst may be the same memory as src. */
+size_t b64_decode_blocks (const char *src, size_t srclen, unsigned char *dst, size_t dstlen);
+
+/* encode whole groups of three bytes and leave the remainder to the caller. returns
+   the number of bytes consumed, which were encoded to consumed / 3 * 4 characters in
+   dst. nothing is written beyond that and no terminating zero is added. */
+size_t b64_encode_blocks (const unsigned char *src, size_t srclen, char *dst);
+
+/* select the kernels for the enabled cpu features, which otherwise happens on first use */
+void b64_kernels_resolve ();
+
+/* force the named kernels, returns -1 if unknown or not allowed on this cpu */
+int b64_kernels_select (const char *name);
+
+/* name of the i-th kernel built in, widest first, NULL after the last */
+const char *b64_kernels_list (size_t i);
+
+/* name of the kernels selected for this cpu */
+const char *b64_kernel_name ();
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * The accepted input follows b64_pton in base64.c exactly, the
+ * difference is that partial quanta are carried between calls.
+ */
+
+#include "base64-stream.h"
+#include "base64-simd.h"
+
+/* start decoding a new string */
+void b64_stream_init (struct b64_stream *st)
+{
+    st->phase = B64_STREAM_DATA;
+    st->state = 0;
+    st->quantum[0] = st->quantum[1] = st->quantum[2] = st->quantum[3] = 0;
+}
+
+/* decode a chunk, dst may also trail src in the same memory */
+int b64_stream_decode (struct b64_stream *st, const char *src, size_t srclen, unsigned char *dst)
+{
+    const unsigned char *in = (const unsigned char *)src;
+    unsigned char *q = st->quantum;
+    size_t i = 0, written = 0, consumed;
+    unsigned char val;
+
+    if (st->phase == B64_STREAM_ERROR)
+        return -1;
+
+    while (i < srclen) {
+
+        /* on a quantum boundary, hand whole blocks to the vectorised kernel */
+        if (st->phase == B64_STREAM_DATA && st->state == 0 && srclen - i >= 4) {
+            consumed = b64_decode_blocks(src + i, srclen - i, dst + written, b64_stream_maxout(srclen) - written);
+            i += consumed;
+            written += consumed / 4 * 3;
+            if (i == srclen)
+                break;
+        }
+
+        /* skip whitespace anywhere */
+        if ((val = b64_decode_table[in[i++]]) == B64_SPACE)
+            continue;
+
+        switch (st->phase) {
+
+            case B64_STREAM_DATA:
+                if (val == B64_INVALID)
+                    goto fail;
+
+                /* collect another character, emit three bytes per quantum */
+                if (val != B64_PAD) {
+                    q[st->state++] = val;
+                    if (st->state == 4) {
+                        dst[written++] = q[0] << 2 | q[1] >> 4;
+                        dst[written++] = q[1] << 4 | q[2] >> 2;
+                        dst[written++] = q[2] << 6 | q[3];
+                        st->state = 0;
+                    }
+                    break;
+                }
+
+                /* padding is only valid after two or three characters */
+                if (st->state == 2) {
+                    st->phase = B64_STREAM_PAD;
+                    break;
+                }
+                if (st->state != 3 || (q[2] & 0x03) != 0)
+                    goto fail;
+                dst[written++] = q[0] << 2 | q[1] >> 4;
+                dst[written++] = q[1] << 4 | q[2] >> 2;
+                st->phase = B64_STREAM_TAIL;
+                break;
+
+            case B64_STREAM_PAD:
+                /* need the second padding character and no leftover bits */
+                if (val != B64_PAD || (q[1] & 0x0f) != 0)
+                    goto fail;
+                dst[written++] = q[0] << 2 | q[1] >> 4;
+                st->phase = B64_STREAM_TAIL;
+                break;
+
+            case B64_STREAM_TAIL:
+            default:
+                /* nothing but whitespace after padding */
+                goto fail;
+        }
+    }
+    return written;
+
+    fail:
+        st->phase = B64_STREAM_ERROR;
+        return -1;
+}
+
+/* check that the input ended on a complete quantum */
+int b64_stream_final (struct b64_stream *st)
+{
+    switch (st->phase) {
+        case B64_STREAM_DATA:
+            return st->state == 0 ? 0 : -1;
+        case B64_STREAM_TAIL:
+            return 0;
+        default:
+            return -1;
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_base64_stream_h_
+#define _headerguard_base64_stream_h_
+
+#include <stddef.h>
+
+/****************************************************************************************/
+
+/* phases of the streaming decoder */
+enum b64_stream_phases {
+    B64_STREAM_DATA,    /* collecting characters of the alphabet */
+    B64_STREAM_PAD,     /* saw one '=' after two characters, need another */
+    B64_STREAM_TAIL,    /* padding complete, only whitespace may follow */
+    B64_STREAM_ERROR,   /* invalid input, sticky until reinitialised */
+};
+
+/* decoder state carried across chunks */
+struct b64_stream {
+    int phase;                  /* one of b64_stream_phases */
+    unsigned int state;         /* characters collected in the current quantum */
+    unsigned char quantum[4];   /* their 6 bit values */
+};
+
+/* output never exceeds this for a chunk of given length */
+#define b64_stream_maxout(len) (((len) / 4 + 1) * 3)
+
+/****************************************************************************************/
+
+/* start decoding a new string */
+void b64_stream_init (struct b64_stream *st);
+
+/* decode a chunk of any length into dst, which must hold b64_stream_maxout(srclen)
+   bytes. whitespace is skipped anywhere, like b64_pton. returns bytes written or -1. */
+int b64_stream_decode (struct b64_stream *st, const char *src, size_t srclen, unsigned char *dst);
+
+/* check that the input ended on a complete quantum, returns 0 or -1 */
+int b64_stream_final (struct b64_stream *st);
+
+#endif
@@ -44,11 +44,11 @@
 
 #if (!defined(HAVE_B64_NTOP) && !defined(HAVE___B64_NTOP)) || (!defined(HAVE_B64_PTON) && !defined(HAVE___B64_PTON))
 
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "base64.h"
+#include "base64-simd.h"
 
 static const char Base64[] =
 	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -125,25 +125,17 @@ b64_ntop(u_char const *src, size_t srclength, char *target, size_t targsize)
 	u_char input[3];
 	u_char output[4];
 	u_int i;
+	size_t consumed;
 
-	while (2 < srclength) {
-		input[0] = *src++;
-		input[1] = *src++;
-		input[2] = *src++;
-		srclength -= 3;
-
-		output[0] = input[0] >> 2;
-		output[1] = ((input[0] & 0x03) << 4) + (input[1] >> 4);
-		output[2] = ((input[1] & 0x0f) << 2) + (input[2] >> 6);
-		output[3] = input[2] & 0x3f;
+	/* the whole output and its terminating zero must fit */
+	if (b64_encoded_len(srclength) >= targsize)
+		return (-1);
 
-		if (datalength + 4 > targsize)
-			return (-1);
-		target[datalength++] = Base64[output[0]];
-		target[datalength++] = Base64[output[1]];
-		target[datalength++] = Base64[output[2]];
-		target[datalength++] = Base64[output[3]];
-	}
+	/* whole groups of three go through the vectorised kernels */
+	consumed = b64_encode_blocks(src, srclength, target);
+	datalength = consumed / 3 * 4;
+	src += consumed;
+	srclength -= consumed;
     
 	/* Now we worry about padding. */
 	if (0 != srclength) {
@@ -179,6 +171,8 @@ b64_ntop(u_char const *src, size_t srclength, char *target, size_t targsize)
    converts characters, four at a time, starting at (or after)
    src from base - 64 numbers into three 8 bit bytes in the target area.
    it returns the number of data bytes stored at the target, or -1 on error.
+   runs of whole quanta are handed to the vectorised kernels in base64-simd.c,
+   everything else is classified through b64_decode_table.
  */
 
 int
@@ -186,20 +180,33 @@ b64_pton(char const *src, u_char *target, size_t targsize)
 {
 	u_int tarindex, state;
 	int ch;
-	char *pos;
+	u_char val;
+	const char *srcend = src + strlen(src);
+	size_t consumed;
 
 	state = 0;
 	tarindex = 0;
 
-	while ((ch = *src++) != '\0') {
-		if (isspace(ch))	/* Skip whitespace anywhere. */
+	for (;;) {
+		/* Decode runs of whole quanta in bulk. */
+		if (state == 0 && target && srcend - src >= 4) {
+			consumed = b64_decode_blocks(src, srcend - src,
+			    target + tarindex, targsize - tarindex);
+			src += consumed;
+			tarindex += consumed / 4 * 3;
+		}
+
+		if ((ch = *src++) == '\0')
+			break;
+
+		val = b64_decode_table[(u_char)ch];
+		if (val == B64_SPACE)	/* Skip whitespace anywhere. */
 			continue;
 
-		if (ch == Pad64)
+		if (val == B64_PAD)
 			break;
 
-		pos = strchr(Base64, ch);
-		if (pos == 0) 		/* A non-base64 character. */
+		if (val == B64_INVALID)	/* A non-base64 character. */
 			return (-1);
 
 		switch (state) {
@@ -207,7 +214,7 @@ b64_pton(char const *src, u_char *target, size_t targsize)
 			if (target) {
 				if (tarindex >= targsize)
 					return (-1);
-				target[tarindex] = (pos - Base64) << 2;
+				target[tarindex] = val << 2;
 			}
 			state = 1;
 			break;
@@ -215,8 +222,8 @@ b64_pton(char const *src, u_char *target, size_t targsize)
 			if (target) {
 				if (tarindex + 1 >= targsize)
 					return (-1);
-				target[tarindex]   |=  (pos - Base64) >> 4;
-				target[tarindex+1]  = ((pos - Base64) & 0x0f)
+				target[tarindex]   |=  val >> 4;
+				target[tarindex+1]  = (val & 0x0f)
 							<< 4 ;
 			}
 			tarindex++;
@@ -226,8 +233,8 @@ b64_pton(char const *src, u_char *target, size_t targsize)
 			if (target) {
 				if (tarindex + 1 >= targsize)
 					return (-1);
-				target[tarindex]   |=  (pos - Base64) >> 2;
-				target[tarindex+1]  = ((pos - Base64) & 0x03)
+				target[tarindex]   |=  val >> 2;
+				target[tarindex+1]  = (val & 0x03)
 							<< 6;
 			}
 			tarindex++;
@@ -237,7 +244,7 @@ b64_pton(char const *src, u_char *target, size_t targsize)
 			if (target) {
 				if (tarindex >= targsize)
 					return (-1);
-				target[tarindex] |= (pos - Base64);
+				target[tarindex] |= val;
 			}
 			tarindex++;
 			state = 0;
@@ -260,7 +267,7 @@ b64_pton(char const *src, u_char *target, size_t targsize)
 		case 2:		/* Valid, means one byte of info */
 			/* Skip any number of spaces. */
 			for (; ch != '\0'; ch = *src++)
-				if (!isspace(ch))
+				if (b64_decode_table[(u_char)ch] != B64_SPACE)
 					break;
 			/* Make sure there is another trailing = sign. */
 			if (ch != Pad64)
@@ -275,7 +282,7 @@ b64_pton(char const *src, u_char *target, size_t targsize)
 			 * whitespace after it?
 			 */
 			for (; ch != '\0'; ch = *src++)
-				if (!isspace(ch))
+				if (b64_decode_table[(u_char)ch] != B64_SPACE)
 					return (-1);
 
 			/*
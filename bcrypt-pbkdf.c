@@ -0,0 +1,266 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * Some concepts and original work is derived from this file:
+ *  - $OpenBSD: bcrypt_pbkdf.c,v 1.13 2015/01/12 03:20:04 tedu Exp $
+ *
+ * Copyright (c) 2013 Ted Unangst <tedu@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include "bcrypt-pbkdf.h"
+#include "blowfish.h"
+#include "sha512.h"
+#include "utilities.h"
+
+/* 32 bit words of a bcrypt hash */
+#define BCRYPT_WORDS ( BCRYPT_PBKDF_HASHSIZE / 4 )
+
+/* threads as set by bcrypt_pbkdf_set_threads, 0 for one per cpu */
+static unsigned int bcrypt_pbkdf_threads = 0;
+
+/* one block of output. the block with number count only depends on
+   the passphrase, salt and rounds, so all of them can run at once */
+struct bcrypt_pbkdf_block {
+    const unsigned char *sha2pass;
+    const unsigned char *salt;
+    size_t saltlen;
+    unsigned int rounds;
+    uint32_t count;
+    unsigned char out[BCRYPT_PBKDF_HASHSIZE];
+};
+
+/* the blocks of all jobs of a batch as one queue, which the threads take
+   items from in turn. item i is block i - first[j] of the job order[j] */
+struct bcrypt_pbkdf_queue {
+    struct bcrypt_pbkdf_job *jobs;
+    size_t order[BCRYPT_PBKDF_MAXBATCH], first[BCRYPT_PBKDF_MAXBATCH + 1];
+    size_t njobs, nitems, next;
+};
+
+
+/* +-------------+ */
+/* | bcrypt hash | */
+/* +-------------+ */
+
+/* eksblowfish keyed with both hashes encrypts a fixed string 64 times */
+static void bcrypt_hash (const unsigned char *sha2pass, const unsigned char *sha2salt, unsigned char *out)
+{
+    static const unsigned char ciphertext[BCRYPT_PBKDF_HASHSIZE] = "OxychromaticBlowfishSwatDynamite";
+    struct blowfish_ctx state;
+    uint32_t cdata[BCRYPT_WORDS];
+
+    /* key expansion */
+    blowfish_initstate(&state);
+    blowfish_expandstate(&state, sha2salt, SHA512_DIGEST_SIZE, sha2pass, SHA512_DIGEST_SIZE);
+    for (int i = 0; i < 64; i++) {
+        blowfish_expand0state(&state, sha2salt, SHA512_DIGEST_SIZE);
+        blowfish_expand0state(&state, sha2pass, SHA512_DIGEST_SIZE);
+    }
+
+    /* encryption of the big endian words of the magic string */
+    for (int i = 0; i < BCRYPT_WORDS; i++)
+        cdata[i] = (uint32_t)ciphertext[4 * i] << 24 | (uint32_t)ciphertext[4 * i + 1] << 16 |
+                   (uint32_t)ciphertext[4 * i + 2] << 8 | ciphertext[4 * i + 3];
+    for (int i = 0; i < 64; i++)
+        blowfish_enc(&state, cdata, BCRYPT_WORDS / 2);
+
+    /* output in little endian, unlike the input */
+    for (int i = 0; i < BCRYPT_WORDS; i++) {
+        out[4 * i]     = cdata[i];
+        out[4 * i + 1] = cdata[i] >> 8;
+        out[4 * i + 2] = cdata[i] >> 16;
+        out[4 * i + 3] = cdata[i] >> 24;
+    }
+
+    memzero(cdata, sizeof cdata);
+    memzero(&state, sizeof state);
+}
+
+/* the xor of all rounds for one block */
+static void bcrypt_pbkdf_compute (struct bcrypt_pbkdf_block *block)
+{
+    struct sha512_ctx ctx;
+    unsigned char countsalt[4], sha2salt[SHA512_DIGEST_SIZE], tmpout[BCRYPT_PBKDF_HASHSIZE];
+
+    countsalt[0] = block->count >> 24;
+    countsalt[1] = block->count >> 16;
+    countsalt[2] = block->count >> 8;
+    countsalt[3] = block->count;
+
+    /* first round is salted with salt || count */
+    sha512_init(&ctx);
+    sha512_update(&ctx, block->salt, block->saltlen);
+    sha512_update(&ctx, countsalt, sizeof countsalt);
+    sha512_final(&ctx, sha2salt);
+    bcrypt_hash(block->sha2pass, sha2salt, tmpout);
+    memcpy(block->out, tmpout, sizeof tmpout);
+
+    /* subsequent rounds with the previous output */
+    for (unsigned int round = 1; round < block->rounds; round++) {
+        sha512(tmpout, sizeof tmpout, sha2salt);
+        bcrypt_hash(block->sha2pass, sha2salt, tmpout);
+        for (int i = 0; i < BCRYPT_PBKDF_HASHSIZE; i++)
+            block->out[i] ^= tmpout[i];
+    }
+
+    memzero(sha2salt, sizeof sha2salt);
+    memzero(tmpout, sizeof tmpout);
+}
+
+/* key bytes are spread over stride blocks, amt bytes from each */
+static size_t bcrypt_pbkdf_stride (size_t keylen)
+{
+    return (keylen + BCRYPT_PBKDF_HASHSIZE - 1) / BCRYPT_PBKDF_HASHSIZE;
+}
+
+/* compute the queue items until none are left. the blocks of a job are
+   interleaved into its key, so every block contributes to every part of it
+   and no two blocks write the same byte */
+static void *bcrypt_pbkdf_work (void *arg)
+{
+    struct bcrypt_pbkdf_queue *queue = arg;
+    struct bcrypt_pbkdf_job *job;
+    struct bcrypt_pbkdf_block block;
+    unsigned char sha2pass[SHA512_DIGEST_SIZE];
+    size_t item, j, i, stride, amt, dest;
+
+    while ((item = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) < queue->nitems) {
+        for (j = 0; queue->first[j + 1] <= item; j++)
+            ;
+        job = &queue->jobs[queue->order[j]];
+        i = item - queue->first[j];
+
+        sha512((const unsigned char *)job->pass, job->passlen, sha2pass);
+        block.sha2pass = sha2pass;
+        block.salt = job->salt;
+        block.saltlen = job->saltlen;
+        block.rounds = job->rounds;
+        block.count = i + 1;
+        bcrypt_pbkdf_compute(&block);
+
+        stride = bcrypt_pbkdf_stride(job->keylen);
+        amt = (job->keylen + stride - 1) / stride;
+        for (size_t k = 0; k < amt; k++)
+            if ((dest = k * stride + i) < job->keylen)
+                job->key[dest] = block.out[k];
+    }
+
+    memzero(&block, sizeof block);
+    memzero(sha2pass, sizeof sha2pass);
+    return NULL;
+}
+
+
+/* +----------------+ */
+/* | key derivation | */
+/* +----------------+ */
+
+void bcrypt_pbkdf_set_threads (unsigned int threads)
+{
+    bcrypt_pbkdf_threads = threads;
+}
+
+/* threads for nitems blocks */
+static size_t bcrypt_pbkdf_nthreads (size_t nitems)
+{
+#ifdef HAVE_PTHREAD
+    long cpus = bcrypt_pbkdf_threads > 0 ? (long)bcrypt_pbkdf_threads : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cpus < 1)
+        return 1;
+    if (cpus > BCRYPT_PBKDF_MAXTHREADS)
+        cpus = BCRYPT_PBKDF_MAXTHREADS;
+    return (size_t)cpus < nitems ? (size_t)cpus : nitems;
+#else
+    (void)nitems;
+    return 1;
+#endif
+}
+
+int bcrypt_pbkdf_batch (struct bcrypt_pbkdf_job *jobs, size_t njobs)
+{
+    struct bcrypt_pbkdf_queue queue;
+    size_t nthreads, t;
+#ifdef HAVE_PTHREAD
+    pthread_t threads[BCRYPT_PBKDF_MAXTHREADS];
+    int started[BCRYPT_PBKDF_MAXTHREADS];
+#endif
+
+    if (njobs > BCRYPT_PBKDF_MAXBATCH)
+        return -1;
+
+    /* nothing crazy, invalid jobs fail on their own */
+    queue.jobs = jobs;
+    queue.njobs = 0;
+    for (size_t j = 0; j < njobs; j++) {
+        jobs[j].result = -1;
+        if (jobs[j].rounds < 1 || jobs[j].passlen == 0 ||
+            jobs[j].saltlen == 0 || jobs[j].saltlen > BCRYPT_PBKDF_MAXSALTLEN ||
+            jobs[j].keylen == 0 || jobs[j].keylen > BCRYPT_PBKDF_MAXKEYLEN)
+                continue;
+        jobs[j].result = 0;
+
+        /* most rounds first, so that the longest blocks do not start last
+           and leave the other threads idle at the end */
+        for (t = queue.njobs++; t > 0 && jobs[queue.order[t - 1]].rounds < jobs[j].rounds; t--)
+            queue.order[t] = queue.order[t - 1];
+        queue.order[t] = j;
+    }
+
+    queue.first[0] = 0;
+    for (size_t j = 0; j < queue.njobs; j++)
+        queue.first[j + 1] = queue.first[j] + bcrypt_pbkdf_stride(jobs[queue.order[j]].keylen);
+    queue.nitems = queue.first[queue.njobs];
+    queue.next = 0;
+
+    nthreads = bcrypt_pbkdf_nthreads(queue.nitems);
+#ifdef HAVE_PTHREAD
+    /* this thread works on the queue as well, so a thread which failed
+       to start only means fewer helpers */
+    for (t = 1; t < nthreads; t++)
+        started[t] = pthread_create(&threads[t], NULL, bcrypt_pbkdf_work, &queue) == 0;
+    bcrypt_pbkdf_work(&queue);
+    for (t = 1; t < nthreads; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+#else
+    (void)nthreads;
+    (void)t;
+    bcrypt_pbkdf_work(&queue);
+#endif
+
+    return 0;
+}
+
+int bcrypt_pbkdf (const char *pass, size_t passlen, const unsigned char *salt, size_t saltlen,
+                  unsigned char *key, size_t keylen, unsigned int rounds)
+{
+    struct bcrypt_pbkdf_job job = {
+        .pass = pass, .passlen = passlen, .salt = salt, .saltlen = saltlen,
+        .key = key, .keylen = keylen, .rounds = rounds,
+    };
+
+    bcrypt_pbkdf_batch(&job, 1);
+    return job.result;
+}
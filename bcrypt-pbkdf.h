@@ -0,0 +1,59 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * For additional notices see the file bcrypt-pbkdf.c
+ */
+
+#ifndef _headerguard_bcrypt_pbkdf_h_
+#define _headerguard_bcrypt_pbkdf_h_
+
+#include <stddef.h>
+
+/****************************************************************************************/
+
+/* output of one bcrypt hash, the key is spread over blocks of this size */
+#define BCRYPT_PBKDF_HASHSIZE  32
+#define BCRYPT_PBKDF_MAXKEYLEN ( BCRYPT_PBKDF_HASHSIZE * BCRYPT_PBKDF_HASHSIZE )
+
+/* longest salt accepted, openssh uses 16 bytes */
+#define BCRYPT_PBKDF_MAXSALTLEN ( 1 << 20 )
+
+/* most derivations in one batch, and threads working on it */
+#define BCRYPT_PBKDF_MAXBATCH   64
+#define BCRYPT_PBKDF_MAXTHREADS 64
+
+/* one derivation of a batch */
+struct bcrypt_pbkdf_job {
+    const char *pass;
+    size_t passlen;
+    const unsigned char *salt;
+    size_t saltlen;
+    unsigned char *key;
+    size_t keylen;
+    unsigned int rounds;
+    int result;             /* 0, or -1 on invalid arguments */
+};
+
+/****************************************************************************************/
+
+/* derive keylen bytes from a passphrase as openssh does for encrypted keys.
+   every block of output is computed in a thread of its own, so that the
+   latency is that of a single block. returns 0, or -1 on invalid arguments */
+int bcrypt_pbkdf (const char *pass, size_t passlen, const unsigned char *salt, size_t saltlen,
+                  unsigned char *key, size_t keylen, unsigned int rounds);
+
+/* derive the keys of up to BCRYPT_PBKDF_MAXBATCH jobs. the output blocks of
+   all of them form one queue, jobs with the most rounds first, which the
+   threads work through until it is empty. so there is no serial tail with a
+   few keys left over, and a batch is done when the cpus together have
+   computed all blocks. returns -1 for too many jobs, else the results are
+   in each job */
+int bcrypt_pbkdf_batch (struct bcrypt_pbkdf_job *jobs, size_t njobs);
+
+/* threads to use at most, 1 computes all blocks in turn and 0 restores
+   the default of one per online cpu */
+void bcrypt_pbkdf_set_threads (unsigned int threads);
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_blowfish_h_
+#define _headerguard_blowfish_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/****************************************************************************************/
+
+#define BLOWFISH_ROUNDS 16
+
+/* expanded key */
+struct blowfish_ctx {
+    uint32_t S[4][256];
+    uint32_t P[BLOWFISH_ROUNDS + 2];
+};
+
+/****************************************************************************************/
+
+/* reset to the initial state, the digits of pi */
+void blowfish_initstate (struct blowfish_ctx *ctx);
+
+/* the expensive key schedule of eksblowfish, salted by data. key and data are
+   used cyclically as a stream of big endian words */
+void blowfish_expandstate  (struct blowfish_ctx *ctx, const unsigned char *data, size_t databytes,
+                            const unsigned char *key, size_t keybytes);
+void blowfish_expand0state (struct blowfish_ctx *ctx, const unsigned char *key, size_t keybytes);
+
+/* encrypt a single block, or nblocks consecutive blocks in ecb mode */
+void blowfish_encipher (const struct blowfish_ctx *ctx, uint32_t *xl, uint32_t *xr);
+void blowfish_enc      (const struct blowfish_ctx *ctx, uint32_t *data, size_t nblocks);
+
+#endif
@@ -32,6 +32,8 @@ struct buffer {
     size_t size;          /* length of data stored */
     size_t offset;        /* offset to first available byte */
     size_t allocation;    /* length of allocated memory */
+    size_t written;       /* high-water mark of bytes ever written, wipes cover this range */
+    unsigned char small[BUFFER_INLINE_SIZE]; /* inline storage until data outgrows it */
 
 /* ASCIIFLow Structure
                                    +--A-L-L-O-C--+
@@ -53,6 +55,108 @@ struct buffer {
                                    +-------------+      */
 };
 
+/* data still lives in the inline storage */
+#define buffer_is_inline(buf) ((buf)->data == (buf)->small)
+
+#ifdef STATIC_STORAGE
+/* fixed set of buffers with bounded storage, nothing is ever allocated */
+static struct buffer buffer_slots[BUFFER_STATIC_SLOTS];
+static unsigned char buffer_storage[BUFFER_STATIC_SLOTS][BUFFER_STATIC_CAPACITY];
+static int buffer_slot_used[BUFFER_STATIC_SLOTS];
+#else
+/* wiped buffers kept for reuse, one pool per thread so no locking is needed */
+struct buffer_pool {
+    struct buffer *cached[BUFFER_POOL_CLASSES][BUFFER_POOL_DEPTH];
+    size_t count[BUFFER_POOL_CLASSES];
+    struct buffer_pool_stats stats;
+};
+static _Thread_local struct buffer_pool pool;
+#endif
+
+
+/* +-----------------------+ */
+/* | recycle wiped buffers | */
+/* +-----------------------+ */
+
+#ifndef STATIC_STORAGE
+/* size class of an allocation, -1 if too large to be pooled */
+static int buffer_pool_class (size_t allocation)
+{
+    size_t classsize = BUFFER_ALLOCATION_INCREMENT;
+
+    /* class 0 holds buffers with inline storage only */
+    if (allocation < classsize)
+        return 0;
+
+    for (int c = 1; c < BUFFER_POOL_CLASSES; c++, classsize <<= 1)
+        if (allocation < classsize << 1)
+            return c;
+    return -1;
+}
+
+/* take the smallest cached buffer, NULL if pool is empty */
+static struct buffer *buffer_pool_take ()
+{
+    struct buffer *buf;
+
+    for (int c = 0; c < BUFFER_POOL_CLASSES; c++) {
+        if (pool.count[c] == 0)
+            continue;
+        buf = pool.cached[c][--pool.count[c]];
+        pool.cached[c][pool.count[c]] = NULL;
+        pool.stats.pooled_bytes -= buf->allocation;
+        pool.stats.hits++;
+        return buf;
+    }
+    return NULL;
+}
+
+/* give a wiped buffer to the pool, returns 0 if the class is full */
+static int buffer_pool_give (struct buffer *buf)
+{
+    int c;
+
+    if ((c = buffer_pool_class(buf->allocation)) < 0 || pool.count[c] >= BUFFER_POOL_DEPTH)
+        return 0;
+
+    pool.cached[c][pool.count[c]++] = buf;
+    pool.stats.pooled_bytes += buf->allocation;
+    if (pool.stats.pooled_bytes > pool.stats.peak_bytes)
+        pool.stats.peak_bytes = pool.stats.pooled_bytes;
+    return 1;
+}
+
+#endif
+
+/* copy statistics of this thread's pool, which the slots do without */
+void buffer_pool_get_stats (struct buffer_pool_stats *stats)
+{
+    if (stats == NULL)
+        return;
+#ifdef STATIC_STORAGE
+    memset(stats, 0, sizeof *stats);
+#else
+    *stats = pool.stats;
+#endif
+}
+
+/* free all cached buffers, e.g. before a thread exits */
+void buffer_pool_drain ()
+{
+#ifndef STATIC_STORAGE
+    struct buffer *buf;
+
+    while ((buf = buffer_pool_take()) != NULL) {
+        pool.stats.hits--;
+        if (!buffer_is_inline(buf))
+            free(buf->data);
+        memzero(buf, sizeof *buf);
+        free(buf);
+    }
+#endif
+}
+
+
 /* +-------------------+ */
 /* | allocate and free | */
 /* +-------------------+ */
@@ -62,19 +166,35 @@ struct buffer *newbuffer ()
 {
     struct buffer *new;
 
+#ifdef STATIC_STORAGE
+    /* hand out the first unused slot */
+    for (int i = 0; i < BUFFER_STATIC_SLOTS; i++) {
+        if (buffer_slot_used[i])
+            continue;
+        buffer_slot_used[i] = 1;
+        new = &buffer_slots[i];
+        new->data = buffer_storage[i];
+        new->allocation = BUFFER_STATIC_CAPACITY;
+        return new;
+    }
+    return NULL;
+#else
+    /* reuse a wiped buffer if there is one */
+    if ((new = buffer_pool_take()) != NULL)
+        return new;
+    pool.stats.misses++;
+
     /* zero-allocate struct */
     if ( (new = zalloc(sizeof *new)) == NULL )
         return NULL;
     
-    /* set initial allocation size & allocate data */
-    new->allocation = BUFFER_ALLOCATION_INCREMENT;
-    if ( (new->data = zalloc(new->allocation)) == NULL ) {
-        free(new);
-        return NULL;
-    }
+    /* start out with the inline storage */
+    new->data = new->small;
+    new->allocation = BUFFER_INLINE_SIZE;
 
     /* return pointer to allocated struct */
     return new;
+#endif
 }
 
 /* free a buffer by filling with zeroes */
@@ -82,36 +202,34 @@ void freebuffer (struct buffer *buf)
 {
     if (buf == NULL) return;
 
-    /* clean and free data */
-    if (buf->data != NULL) {
-        memzero(buf->data, buf->allocation);
-        free(buf->data);
-    }
+    /* clean data, only the written range can hold anything */
+    resetbuffer(buf);
 
-    /* clean and free struct */
+#ifdef STATIC_STORAGE
+    /* return the slot */
+    buffer_slot_used[buf - buffer_slots] = 0;
+#else
+    /* keep it for the next newbuffer if the pool has room */
+    if (buf->data != NULL && buffer_pool_give(buf))
+        return;
+
+    /* free data, clean and free struct */
+    if (!buffer_is_inline(buf))
+        free(buf->data);
     memzero(buf, sizeof *buf);
     free(buf);
+#endif
 }
 
-/* reset data in buffer */ 
+/* reset data in buffer, keeping the allocation for reuse */ 
 void resetbuffer (struct buffer *buf)
 {
     if (buf == NULL) return;
-    unsigned char *newdata;
 
-    /* zero the data */
+    /* zero the written range */
     if (buf->data != NULL)
-        memzero(buf->data, buf->allocation);
-    buf->offset = buf->size = 0;
-
-    /* realloc if larger than initial */
-    if (buf->allocation != BUFFER_ALLOCATION_INCREMENT) {
-        if ((newdata = realloc(buf->data, BUFFER_ALLOCATION_INCREMENT)) != NULL) {
-            buf->data = newdata;
-            buf->allocation = BUFFER_ALLOCATION_INCREMENT;
-        }
-    }
-
+        memzero(buf->data, buf->written);
+    buf->offset = buf->size = buf->written = 0;
 }
 
 /* TODO, maybe? */
@@ -148,9 +266,8 @@ int buffer_reserve (struct buffer *buf, size_t request_size, unsigned char **req
     if (request_ptr != NULL)
         *request_ptr = NULL;
 
-    /* calculate next largest increment of the needed new size */
-    needed_size = roundup(request_size + buf->size, BUFFER_ALLOCATION_INCREMENT);
     /* TODO implement 'packing', i.e. remove the offset data */
+    needed_size = request_size + buf->size;
 
     /* is this a reasonable request? */
     if (needed_size > BUFFER_ALLOCATION_MAXIMUM)
@@ -158,13 +275,34 @@ int buffer_reserve (struct buffer *buf, size_t request_size, unsigned char **req
 
     /* do we need more allocation? */
     if (needed_size > buf->allocation) {
-        /* reallocate with more mem */
-        if ((newdata = realloc(buf->data, needed_size)) == NULL)
+#ifdef STATIC_STORAGE
+        /* storage is fixed */
+        return BUFFER_LENGTH_OVER_MAXIMUM;
+#else
+        /* calculate next largest increment of the needed new size,
+           but at least double so that repeated growth stays linear */
+        needed_size = roundup(needed_size, BUFFER_ALLOCATION_INCREMENT);
+        if (needed_size < 2 * buf->allocation)
+            needed_size = 2 * buf->allocation;
+        if (needed_size > BUFFER_ALLOCATION_MAXIMUM)
+            needed_size = BUFFER_ALLOCATION_MAXIMUM;
+
+        /* allocate more mem, a plain realloc would leave the old copy unwiped */
+        if ((newdata = zalloc(needed_size)) == NULL)
             return BUFFER_REALLOC_FAILED;
+
+        /* move written data over and wipe the old location */
+        if (buf->data != NULL) {
+            memcpy(newdata, buf->data, buf->written);
+            memzero(buf->data, buf->written);
+            if (!buffer_is_inline(buf))
+                free(buf->data);
+        }
         
         /* set new data values in buffer */
         buf->allocation = needed_size;
         buf->data = newdata;
+#endif
     }
 
     /* adjust 'used' size of buffer and return pointer if request_ptr given */
@@ -172,6 +310,8 @@ int buffer_reserve (struct buffer *buf, size_t request_size, unsigned char **req
     if (request_ptr != NULL) {
         newdata = buf->data + buf->size;
         buf->size += request_size;
+        if (buf->size > buf->written)
+            buf->written = buf->size;
         *request_ptr = newdata;
     }
     return SUCCESS;
@@ -235,29 +375,80 @@ int buffer_put_decoded_base64 (struct buffer *buf, const char *base64string)
     
     unsigned char *decoded;
     size_t encoded_len = strlen(base64string);
-    size_t decoded_len;
+    int decoded_len;
 
     if (encoded_len == 0)
         return SUCCESS;
 
-    /* allocate memory for decoded data */
-    if ((decoded = malloc(encoded_len)) == NULL)
-        return BUFFER_MALLOC_FAILED;
+    /* reserve space for decoded data, it is always shorter than the encoding */
+    if ((e = buffer_reserve(buf, encoded_len, &decoded)) != SUCCESS)
+        return e;
 
-    /* try to decode string */
+    /* try to decode string directly into the buffer */
     if ((decoded_len = base64_decode(base64string, decoded, encoded_len)) < 0) {
+        memzero(decoded, encoded_len);
+        decoded_len = 0;
         e = BUFFER_INVALID_FORMAT;
-    } else { /* if successful */
-        /* put decoded data into buffer */
-        e = buffer_put(buf, decoded, decoded_len);
     }
 
-    memzero(decoded, encoded_len);
-    free(decoded);
+    /* give back the unused part of the reservation */
+    buf->size -= encoded_len - decoded_len;
+    return e;
+}
+
+/* decode one chunk of a longer base64 string, partial quanta are carried in st */
+int buffer_put_decoded_base64_chunk (struct buffer *buf, struct b64_stream *st, const char *chunk, size_t length)
+{
+    int e = FAILURE;
+
+    unsigned char *decoded;
+    size_t reserved = b64_stream_maxout(length);
+    int decoded_len;
+
+    if (buf == NULL || st == NULL || chunk == NULL)
+        return ERR_NULLPTR;
 
+    /* reserve the most this chunk can decode to */
+    if ((e = buffer_reserve(buf, reserved, &decoded)) != SUCCESS)
+        return e;
+
+    /* decode directly into the buffer */
+    if ((decoded_len = b64_stream_decode(st, chunk, length, decoded)) < 0) {
+        memzero(decoded, reserved);
+        decoded_len = 0;
+        e = BUFFER_INVALID_FORMAT;
+    }
+
+    /* give back the unused part of the reservation */
+    buf->size -= reserved - decoded_len;
     return e;
 }
 
+/* decode the terminated base64 string at the offset in place, buf then holds only the decoded data */
+int buffer_decode_base64_inplace (struct buffer *buf)
+{
+    int decoded_len;
+
+    if (buf == NULL)
+        return ERR_NULLPTR;
+
+    /* the string must be terminated within the buffer */
+    unsigned char *data = buf->data + buf->offset;
+    if (memchr(data, '\0', buf->size - buf->offset) == NULL)
+        return BUFFER_INVALID_FORMAT;
+
+    /* decoding never writes ahead of the character being read */
+    if ((decoded_len = base64_decode((char *)data, data, buf->size - buf->offset)) < 0)
+        return BUFFER_INVALID_FORMAT;
+
+    /* move decoded data to the front if there was an offset */
+    if (buf->offset != 0)
+        memmove(buf->data, data, decoded_len);
+    buf->offset = 0;
+    buf->size = decoded_len;
+    return SUCCESS;
+}
+
 /* put a string of data with prefixed u32 length */
 int buffer_put_data (struct buffer *buf, void *data, size_t length)
 {
@@ -383,6 +574,7 @@ static inline int buffer_nullcharcheck (const unsigned char *data, size_t length
     return ( length > 0 && (find = memchr(data, *nullchar, length)) != NULL && find < data + length - 1);
 }
 
+#ifndef STATIC_STORAGE
 /* read string and optionally check for continuity in respect to given nullchar */
 int buffer_read_string (struct buffer *buf, unsigned char **stringptr, size_t *lengthptr, char *nullchar)
 {
@@ -427,6 +619,33 @@ int buffer_read_string (struct buffer *buf, unsigned char **stringptr, size_t *l
 
     return SUCCESS;
 }
+#endif
+
+/* read string without copying, pointer is valid as long as the buffer is unchanged */
+int buffer_read_stringptr (struct buffer *buf, const unsigned char **stringptr, size_t *lengthptr)
+{
+    const unsigned char *string;
+    size_t length;
+    int e = FAILURE;
+
+    /* reset targets */
+    if (stringptr != NULL) *stringptr = NULL;
+    if (lengthptr != NULL) *lengthptr = 0;
+
+    /* get pointer and length of string in buffer */
+    if ((e = buffer_get_stringptr(buf, &string, &length)) != SUCCESS)
+        return e;
+
+    /* advance offset */
+    if (buffer_add_offset(buf, length + 4))
+        return BUFFER_INTERNAL_ERROR;
+
+    /* output pointer and length */
+    if (stringptr != NULL) *stringptr = string;
+    if (lengthptr != NULL) *lengthptr = length;
+
+    return SUCCESS;
+}
 
 /*
     Compatability with sshbuf_get_c?string:
@@ -589,6 +808,20 @@ size_t buffer_get_remaining (const struct buffer *buf)
     return 0;
 }
 
+/* shrink the size of present data, e.g. after working in place */
+int buffer_set_datasize (struct buffer *buf, size_t size)
+{
+    if (buf == NULL)
+        return ERR_NULLPTR;
+    if (size > buf->size)
+        return BUFFER_OFFSET_TOO_LARGE;
+
+    buf->size = size;
+    if (buf->offset > size)
+        buf->offset = size;
+    return SUCCESS;
+}
+
 /* zeroes the offset in a buffer */
 int buffer_reset_offset (struct buffer *buf)
 {
@@ -609,9 +842,10 @@ void buffer_dump (const struct buffer *buf) {
     if (buf != NULL) { 
         debugbuf("STRUCT", (unsigned char *)buf, sizeof(struct buffer));
         #include <stdio.h> /* TODO some these function shall be removed sometime */ 
-        printf("%s%p\n%s%lu bytes\n%s%lu bytes\n%s+%lu = %p\n",
+        printf("%s%p\n%s%lu bytes\n%s%lu bytes\n%s%lu bytes\n%s+%lu = %p\n",
                 "data address:   ", buf->data,
                 "allocation:     ", buf->allocation,
+                "high-water mark:", buf->written,
                 "data length:    ", buf->size,
                 "offset:         ", buf->offset, buf->data + buf->offset);
         if (buf->data != NULL) debugbuf("BUFFER DATA", buf->data, buf->size);
@@ -15,18 +15,36 @@
 #include "errors.h"
 #include "utilities.h"
 #include "base64.h"
+#include "base64-stream.h"
 
 /****************************************************************************************/
 
 /* size constraints */
+#define BUFFER_INLINE_SIZE                       128  /* inline storage in struct */
 #define BUFFER_ALLOCATION_INCREMENT           2*1024  /*   2 KiB */
 #define BUFFER_ALLOCATION_MAXIMUM       64*1024*1024  /*  64 MiB */
 
+/* fixed storage for the malloc-free profile, see --enable-static-storage */
+#define BUFFER_STATIC_SLOTS                        1  /* buffers in use at once */
+#define BUFFER_STATIC_CAPACITY                4*1024  /* data bytes per buffer */
+
+/* recycling pool, size classes are inline, 2, 4, 8 .. KiB */
+#define BUFFER_POOL_CLASSES                        7  /* up to 64 KiB */
+#define BUFFER_POOL_DEPTH                          8  /* cached buffers per class */
+
 /* statuscodes are defined in statuscodes.h */
 
 /* opaque struct */
 struct buffer;
 
+/* statistics of the per-thread buffer pool */
+struct buffer_pool_stats {
+    unsigned long hits;     /* newbuffer calls served from the pool */
+    unsigned long misses;   /* newbuffer calls which had to allocate */
+    size_t pooled_bytes;    /* data bytes currently held in the pool */
+    size_t peak_bytes;      /* maximum of pooled_bytes */
+};
+
 /****************************************************************************************/
 
 /* allocate and free buffers */
@@ -34,6 +52,13 @@ struct buffer * newbuffer   ();
            void freebuffer  (struct buffer *buf);
            void resetbuffer (struct buffer *buf);
 
+/* inspect and empty the buffer pool of the calling thread. freed buffers stay
+   cached in it, so every thread which calls newbuffer must drain its pool
+   before it exits or they leak. the malloc-free profile has no pool but one
+   set of slots without locking, so it uses buffers from a single thread only */
+void buffer_pool_get_stats (struct buffer_pool_stats *stats);
+void buffer_pool_drain     ();
+
 /* put data into buffer */
 int buffer_reserve      (struct buffer *buf, size_t request_size, unsigned char **request_ptr);
 int buffer_put          (struct buffer *buf, const void *data, size_t datalength);
@@ -44,14 +69,20 @@ int buffer_put_data     (struct buffer *buf, void *data, size_t length);
 int buffer_put_string   (struct buffer *buf, unsigned char *string);
 
 /* convert from other formats */
-int buffer_put_decoded_base64 (struct buffer *buf, const char *base64string);
+int buffer_put_decoded_base64    (struct buffer *buf, const char *base64string);
+int buffer_decode_base64_inplace (struct buffer *buf);
+int buffer_put_decoded_base64_chunk (struct buffer *buf, struct b64_stream *st, const char *chunk, size_t length);
 
 /* read data from buffer */
 int buffer_add_offset       (struct buffer *buf, size_t length);
 int buffer_read_u32         (struct buffer *buf, unsigned long *read);
 int buffer_read_u8          (struct buffer *buf, unsigned char *read);
 int buffer_get_stringptr    (const struct buffer *buf, const unsigned char **stringptr, size_t *stringlen);
+#ifndef STATIC_STORAGE
+/* a malloc'ed copy, which the malloc-free build has no use for */
 int buffer_read_string      (struct buffer *buf, unsigned char **stringptr, size_t *lengthptr, char *nullchar);
+#endif
+int buffer_read_stringptr   (struct buffer *buf, const unsigned char **stringptr, size_t *lengthptr);
 
 /* create new from some other data */
 int buffer_new_from_data        (struct buffer **newbuf, const char *data, size_t datalen);
@@ -66,9 +97,10 @@ unsigned char * buffer_get_offsetptr    (const struct buffer *buf);
          size_t buffer_get_allocation   (const struct buffer *buf);
          size_t buffer_get_remaining    (const struct buffer *buf);
             int buffer_reset_offsetptr  (struct buffer *buf);
+            int buffer_set_datasize     (struct buffer *buf, size_t size);
 
 /* debugging */
-void buffer_dump (const struct buffer *buf);
+void buffer_dump      (const struct buffer *buf);
 
 /* Macros for decoding/encoding integers */
 #define decode_uint32(addr) \
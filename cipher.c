@@ -0,0 +1,55 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#include <string.h>
+
+#include "cipher.h"
+#include "aes.h"
+#include "utilities.h"
+
+/* the ciphers ssh-keygen offers for private keys, aes256-ctr being its default */
+static const struct cipher ciphers[] = {
+    /* name             mode                keylen  ivlen   blocksize */
+    { "none",           CIPHER_MODE_NONE,   0,      0,      8  },
+    { "aes128-ctr",     CIPHER_MODE_CTR,    16,     16,     16 },
+    { "aes192-ctr",     CIPHER_MODE_CTR,    24,     16,     16 },
+    { "aes256-ctr",     CIPHER_MODE_CTR,    32,     16,     16 },
+    { "aes128-cbc",     CIPHER_MODE_CBC,    16,     16,     16 },
+    { "aes192-cbc",     CIPHER_MODE_CBC,    24,     16,     16 },
+    { "aes256-cbc",     CIPHER_MODE_CBC,    32,     16,     16 },
+};
+#define n_ciphers (sizeof ciphers / sizeof *ciphers)
+
+const struct cipher * cipher_by_name (const unsigned char *name, size_t len)
+{
+    for (size_t i = 0; i < n_ciphers; i++)
+        if (memeqstr(name, len, ciphers[i].name))
+            return &ciphers[i];
+    return NULL;
+}
+
+int cipher_decrypt (const struct cipher *cipher, const unsigned char *keyiv, unsigned char *data, size_t len)
+{
+    struct aes_key key;
+    unsigned char iv[AES_BLOCK_SIZE];
+
+    if (cipher->mode == CIPHER_MODE_NONE)
+        return SUCCESS;
+    if (len % cipher->blocksize != 0 || cipher->ivlen != AES_BLOCK_SIZE ||
+        aes_setkey(&key, keyiv, cipher->keylen) != 0)
+            return ERR_BAD_ARGUMENT;
+
+    /* the modes advance the iv, so it is worked on in a copy */
+    memcpy(iv, keyiv + cipher->keylen, sizeof iv);
+    if (cipher->mode == CIPHER_MODE_CTR)
+        aes_ctr(&key, iv, data, len);
+    else
+        aes_cbc_decrypt(&key, iv, data, len / AES_BLOCK_SIZE);
+
+    aes_clearkey(&key);
+    memzero(iv, sizeof iv);
+    return SUCCESS;
+}
@@ -0,0 +1,41 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_cipher_h_
+#define _headerguard_cipher_h_
+
+#include <stddef.h>
+
+#include "errors.h"
+
+/****************************************************************************************/
+
+/* largest key and iv of all ciphers, to size buffers for the derived key material */
+#define CIPHER_MAXKEYLEN 32
+#define CIPHER_MAXIVLEN  16
+
+/* block cipher modes */
+enum cipher_modes { CIPHER_MODE_NONE, CIPHER_MODE_CTR, CIPHER_MODE_CBC };
+
+/* a cipher which openssh may use for the private section */
+struct cipher {
+    const char *name;
+    int mode;                   /* one of cipher_modes */
+    unsigned int keylen;        /* 0 for none */
+    unsigned int ivlen;
+    unsigned int blocksize;     /* the private section is padded to this */
+};
+
+/****************************************************************************************/
+
+/* find a cipher by its name in the key file, NULL if unknown */
+const struct cipher * cipher_by_name (const unsigned char *name, size_t len);
+
+/* decrypt len bytes in place, with the key followed by the iv in keyiv.
+   len must be a multiple of the blocksize */
+int cipher_decrypt (const struct cipher *cipher, const unsigned char *keyiv, unsigned char *data, size_t len);
+
+#endif
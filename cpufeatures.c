@@ -0,0 +1,154 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpufeatures.h"
+#include "aes.h"
+#include "base64-simd.h"
+#include "sha256.h"
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+# include <sys/auxv.h>
+# ifndef HWCAP_SHA2
+#  define HWCAP_SHA2 (1 << 6)
+# endif
+#endif
+
+/* labels, indexable by feature */
+#define CPU_AS_LABEL(feature, label) label
+static const char *const cpu_feature_labels[] = { CPU_FEATURES(CPU_AS_LABEL) };
+#undef CPU_AS_LABEL
+
+/* probed and allowed features, valid once probed is set */
+static int cpu_probed = 0;
+static unsigned int cpu_detected = 0, cpu_allowed = 0;
+
+/* +---------+ */
+/* | probing | */
+/* +---------+ */
+
+static unsigned int cpu_probe ()
+{
+    unsigned int found = 0;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    /* the builtins also check that the os saves the wide registers */
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))        found |= CPU_MASK(CPU_SSSE3);
+    if (__builtin_cpu_supports("sse4.1"))       found |= CPU_MASK(CPU_SSE41);
+    if (__builtin_cpu_supports("avx2"))         found |= CPU_MASK(CPU_AVX2);
+    if (__builtin_cpu_supports("avx512bw"))     found |= CPU_MASK(CPU_AVX512BW);
+    if (__builtin_cpu_supports("avx512vbmi"))   found |= CPU_MASK(CPU_AVX512VBMI);
+    if (__builtin_cpu_supports("sha"))          found |= CPU_MASK(CPU_SHA);
+    if (__builtin_cpu_supports("aes"))          found |= CPU_MASK(CPU_AES);
+    if (__builtin_cpu_supports("vaes"))         found |= CPU_MASK(CPU_VAES);
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    if (hwcap & HWCAP_SHA2)                     found |= CPU_MASK(CPU_ARM_SHA2);
+#endif
+
+    return found;
+}
+
+/* apply the override, unknown labels are reported and ignored */
+static unsigned int cpu_override (unsigned int found, const char *spec)
+{
+    unsigned int allowed = found, listed = 0;
+    int restrict_to_listed = 0, negate, feature;
+    size_t len;
+
+    while (*spec != '\0') {
+        len = strcspn(spec, ",");
+        negate = *spec == '-';
+
+        if (len == 4 && memcmp(spec, "none", 4) == 0) {
+            restrict_to_listed = 1;
+        } else if (len > (size_t)negate) {
+            for (feature = 0; feature < CPU_FEATURES_MAX; feature++)
+                if (strlen(cpu_feature_labels[feature]) == len - negate &&
+                    memcmp(cpu_feature_labels[feature], spec + negate, len - negate) == 0)
+                        break;
+            if (feature == CPU_FEATURES_MAX)
+                eprintf("%s: unknown cpu feature '%.*s' ignored\n", CPU_FEATURES_ENV, (int)len, spec);
+            else if (negate)
+                allowed &= ~CPU_MASK(feature);
+            else {
+                listed |= CPU_MASK(feature);
+                restrict_to_listed = 1;
+            }
+        }
+
+        spec += len;
+        if (*spec == ',')
+            spec++;
+    }
+
+    /* features can be taken away, but never added */
+    if (restrict_to_listed)
+        allowed &= listed;
+    return allowed & found;
+}
+
+unsigned int cpu_features_detected ()
+{
+    const char *spec;
+
+    if (!cpu_probed) {
+        cpu_detected = cpu_allowed = cpu_probe();
+        if ((spec = getenv(CPU_FEATURES_ENV)) != NULL)
+            cpu_allowed = cpu_override(cpu_detected, spec);
+        cpu_probed = 1;
+    }
+    return cpu_detected;
+}
+
+unsigned int cpu_features ()
+{
+    if (!cpu_probed)
+        cpu_features_detected();
+    return cpu_allowed;
+}
+
+
+/* +----------+ */
+/* | dispatch | */
+/* +----------+ */
+
+void cpu_dispatch ()
+{
+    cpu_features();
+    aes_kernels_resolve();
+    b64_kernels_resolve();
+    sha256_kernels_resolve();
+}
+
+static void cpu_features_print (FILE *out, const char *title, unsigned int mask)
+{
+    fprintf(out, "%-10s", title);
+    for (int feature = 0; feature < CPU_FEATURES_MAX; feature++)
+        if (mask & CPU_MASK(feature))
+            fprintf(out, " %s", cpu_feature_labels[feature]);
+    fprintf(out, mask == 0 ? " none\n" : "\n");
+}
+
+void cpu_features_dump (FILE *out)
+{
+    const char *spec = getenv(CPU_FEATURES_ENV);
+
+    cpu_dispatch();
+    cpu_features_print(out, "detected:", cpu_features_detected());
+    if (spec != NULL) {
+        fprintf(out, "%-10s %s=%s\n", "override:", CPU_FEATURES_ENV, spec);
+        cpu_features_print(out, "enabled:", cpu_features());
+    }
+    fprintf(out, "%-10s %s\n", "aes:", aes_kernel_name());
+    fprintf(out, "%-10s %s\n", "base64:", b64_kernel_name());
+    fprintf(out, "%-10s %s\n", "sha256:", sha256_kernel_name());
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_cpufeatures_h_
+#define _headerguard_cpufeatures_h_
+
+#include <stdio.h>
+
+#include "errors.h"
+
+/****************************************************************************************/
+
+/* every cpu feature a kernel may depend on, with its label in output and overrides */
+#define CPU_FEATURES(fn) \
+    fn( CPU_SSSE3,          "ssse3"         ),\
+    fn( CPU_SSE41,          "sse4.1"        ),\
+    fn( CPU_AVX2,           "avx2"          ),\
+    fn( CPU_AVX512BW,       "avx512bw"      ),\
+    fn( CPU_AVX512VBMI,     "avx512vbmi"    ),\
+    fn( CPU_SHA,            "sha"           ),\
+    fn( CPU_AES,            "aes"           ),\
+    fn( CPU_VAES,           "vaes"          ),\
+    fn( CPU_ARM_SHA2,       "arm-sha2"      )
+
+/* feature numbers, which are bit positions in the feature mask */
+enum cpu_feature { CPU_FEATURES(AS_ENUM), CPU_FEATURES_MAX };
+
+/* environment variable to restrict the features kernels may use, e.g.
+   "none", "ssse3,sha" to allow only those or "-avx512vbmi,-sha" to mask some */
+#define CPU_FEATURES_ENV "TINYSSH_CONVERT_CPU"
+
+/****************************************************************************************/
+
+/* features of this cpu after the override, probed on first use */
+unsigned int cpu_features ();
+
+/* features of this cpu as probed, without the override */
+unsigned int cpu_features_detected ();
+
+/* check a single feature */
+#define cpu_has(feature) ((cpu_features() >> (feature)) & 1U)
+
+/* bit of a feature, to build sets of required features */
+#define CPU_MASK(feature) (1U << (feature))
+
+/* probe now and install the kernels of all modules */
+void cpu_dispatch ();
+
+/* print features and selected kernels for --cpu-features */
+void cpu_features_dump (FILE *out);
+
+#endif
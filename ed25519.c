@@ -0,0 +1,497 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * Fixed-base scalar multiplication on edwards25519 as in the ref10
+ * implementation of ed25519 by Bernstein, Duif, Lange, Schwabe and Yang:
+ * signed radix 16 digits of the scalar, a table of their multiples of the
+ * base point at every other digit position and the unified addition in
+ * extended coordinates of Hisil, Wong, Carter and Dawson. Field elements
+ * are five limbs of 51 bits. The table is computed at startup instead of
+ * being compiled in, which takes a single field inversion for all of it.
+ */
+
+#include <string.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include "ed25519.h"
+#include "sha512.h"
+#include "utilities.h"
+
+/* +---------------------+ */
+/* | field arithmetic    | */
+/* +---------------------+ */
+
+/* an element of GF(2^255 - 19), limbs are kept below 2^52 between operations */
+typedef uint64_t fe[5];
+
+#define FE_MASK51 ((((uint64_t)1) << 51) - 1)
+
+/* products of two limbs and sums of them */
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 u128;
+# define u128_mul(a, b)  ((u128)(a) * (b))
+# define u128_add(x, y)  ((x) + (y))
+# define u128_wide(a)    ((u128)(a))
+# define u128_low51(x)   ((uint64_t)(x) & FE_MASK51)
+# define u128_shr51(x)   ((uint64_t)((x) >> 51))
+#else
+typedef struct { uint64_t lo, hi; } u128;
+static u128 u128_mul (uint64_t a, uint64_t b)
+{
+    uint64_t al = (uint32_t)a, ah = a >> 32, bl = (uint32_t)b, bh = b >> 32;
+    uint64_t ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+    uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+    u128 r = { (mid << 32) | (uint32_t)ll, hh + (lh >> 32) + (hl >> 32) + (mid >> 32) };
+    return r;
+}
+static u128 u128_add (u128 x, u128 y)
+{
+    u128 r = { x.lo + y.lo, x.hi + y.hi };
+    r.hi += r.lo < x.lo;
+    return r;
+}
+static u128 u128_wide (uint64_t a)
+{
+    u128 r = { a, 0 };
+    return r;
+}
+# define u128_low51(x)   ((x).lo & FE_MASK51)
+# define u128_shr51(x)   (((x).lo >> 51) | ((x).hi << 13))
+#endif
+
+static const fe fe_d2 = { 0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052, 0x6738cc7407977, 0x2406d9dc56dff };
+static const fe fe_base_x = { 0x62d608f25d51a, 0x412a4b4f6592a, 0x75b7171a4b31d, 0x1ff60527118fe, 0x216936d3cd6e5 };
+static const fe fe_base_y = { 0x6666666666658, 0x4cccccccccccc, 0x1999999999999, 0x3333333333333, 0x6666666666666 };
+
+static void fe_copy (fe h, const fe f)
+{
+    memcpy(h, f, sizeof(fe));
+}
+
+static void fe_set (fe h, uint64_t v)
+{
+    h[0] = v; h[1] = h[2] = h[3] = h[4] = 0;
+}
+
+/* bring every limb back to 51 bits, plus a little in the lowest */
+static void fe_carry (fe h)
+{
+    uint64_t c;
+
+    c = h[0] >> 51; h[0] &= FE_MASK51; h[1] += c;
+    c = h[1] >> 51; h[1] &= FE_MASK51; h[2] += c;
+    c = h[2] >> 51; h[2] &= FE_MASK51; h[3] += c;
+    c = h[3] >> 51; h[3] &= FE_MASK51; h[4] += c;
+    c = h[4] >> 51; h[4] &= FE_MASK51; h[0] += 19 * c;
+}
+
+static void fe_add (fe h, const fe f, const fe g)
+{
+    for (int i = 0; i < 5; i++)
+        h[i] = f[i] + g[i];
+    fe_carry(h);
+}
+
+/* f - g + 2p, which stays positive for limbs of g below 2^52 */
+static void fe_sub (fe h, const fe f, const fe g)
+{
+    h[0] = f[0] + 0xfffffffffffdaULL - g[0];
+    for (int i = 1; i < 5; i++)
+        h[i] = f[i] + 0xffffffffffffeULL - g[i];
+    fe_carry(h);
+}
+
+static void fe_neg (fe h, const fe f)
+{
+    static const fe zero = { 0 };
+    fe_sub(h, zero, f);
+}
+
+static void fe_mul (fe h, const fe f, const fe g)
+{
+    const uint64_t g1 = 19 * g[1], g2 = 19 * g[2], g3 = 19 * g[3], g4 = 19 * g[4];
+    u128 r0, r1, r2, r3, r4;
+    uint64_t c;
+
+    r0 = u128_add(u128_add(u128_add(u128_add(u128_mul(f[0], g[0]), u128_mul(f[1], g4)),
+            u128_mul(f[2], g3)), u128_mul(f[3], g2)), u128_mul(f[4], g1));
+    r1 = u128_add(u128_add(u128_add(u128_add(u128_mul(f[0], g[1]), u128_mul(f[1], g[0])),
+            u128_mul(f[2], g4)), u128_mul(f[3], g3)), u128_mul(f[4], g2));
+    r2 = u128_add(u128_add(u128_add(u128_add(u128_mul(f[0], g[2]), u128_mul(f[1], g[1])),
+            u128_mul(f[2], g[0])), u128_mul(f[3], g4)), u128_mul(f[4], g3));
+    r3 = u128_add(u128_add(u128_add(u128_add(u128_mul(f[0], g[3]), u128_mul(f[1], g[2])),
+            u128_mul(f[2], g[1])), u128_mul(f[3], g[0])), u128_mul(f[4], g4));
+    r4 = u128_add(u128_add(u128_add(u128_add(u128_mul(f[0], g[4]), u128_mul(f[1], g[3])),
+            u128_mul(f[2], g[2])), u128_mul(f[3], g[1])), u128_mul(f[4], g[0]));
+
+    r1 = u128_add(r1, u128_wide(u128_shr51(r0)));
+    r2 = u128_add(r2, u128_wide(u128_shr51(r1)));
+    r3 = u128_add(r3, u128_wide(u128_shr51(r2)));
+    r4 = u128_add(r4, u128_wide(u128_shr51(r3)));
+    h[0] = u128_low51(r0) + 19 * u128_shr51(r4);
+    h[1] = u128_low51(r1);
+    h[2] = u128_low51(r2);
+    h[3] = u128_low51(r3);
+    h[4] = u128_low51(r4);
+    c = h[0] >> 51; h[0] &= FE_MASK51; h[1] += c;
+}
+
+/* h = f^(2^n) */
+static void fe_sqn (fe h, const fe f, int n)
+{
+    fe_mul(h, f, f);
+    while (--n > 0)
+        fe_mul(h, h, h);
+}
+
+/* z^(p-2), with the addition chain of ref10 */
+static void fe_invert (fe out, const fe z)
+{
+    fe z2, z9, z11, z5, z10, z20, z50, z100, t;
+
+    fe_mul(z2, z, z);
+    fe_sqn(t, z2, 2);
+    fe_mul(z9, t, z);
+    fe_mul(z11, z9, z2);
+    fe_mul(t, z11, z11);
+    fe_mul(z5, t, z9);                  /* 2^5 - 1 */
+    fe_sqn(t, z5, 5);
+    fe_mul(z10, t, z5);                 /* 2^10 - 1 */
+    fe_sqn(t, z10, 10);
+    fe_mul(z20, t, z10);                /* 2^20 - 1 */
+    fe_sqn(t, z20, 20);
+    fe_mul(t, t, z20);                  /* 2^40 - 1 */
+    fe_sqn(t, t, 10);
+    fe_mul(z50, t, z10);                /* 2^50 - 1 */
+    fe_sqn(t, z50, 50);
+    fe_mul(z100, t, z50);               /* 2^100 - 1 */
+    fe_sqn(t, z100, 100);
+    fe_mul(t, t, z100);                 /* 2^200 - 1 */
+    fe_sqn(t, t, 50);
+    fe_mul(t, t, z50);                  /* 2^250 - 1 */
+    fe_sqn(t, t, 5);
+    fe_mul(out, t, z11);                /* 2^255 - 21 */
+}
+
+/* the unique representative below p, little endian */
+static void fe_tobytes (unsigned char *s, const fe f)
+{
+    fe h;
+    uint64_t q, w[4];
+
+    fe_copy(h, f);
+    fe_carry(h);
+    fe_carry(h);
+
+    /* h < 2p now, subtract p once if h + 19 reaches 2^255 */
+    q = (h[0] + 19) >> 51;
+    q = (h[1] + q) >> 51;
+    q = (h[2] + q) >> 51;
+    q = (h[3] + q) >> 51;
+    q = (h[4] + q) >> 51;
+    h[0] += 19 * q;
+    h[1] += h[0] >> 51; h[0] &= FE_MASK51;
+    h[2] += h[1] >> 51; h[1] &= FE_MASK51;
+    h[3] += h[2] >> 51; h[2] &= FE_MASK51;
+    h[4] += h[3] >> 51; h[3] &= FE_MASK51;
+    h[4] &= FE_MASK51;
+
+    w[0] = h[0]       | h[1] << 51;
+    w[1] = h[1] >> 13 | h[2] << 38;
+    w[2] = h[2] >> 26 | h[3] << 25;
+    w[3] = h[3] >> 39 | h[4] << 12;
+    for (int i = 0; i < 32; i++)
+        s[i] = w[i / 8] >> (8 * (i % 8));
+}
+
+/* f = g if b is 1, unchanged if 0, without branching on b */
+static void fe_cmov (fe f, const fe g, unsigned int b)
+{
+    const uint64_t mask = -(uint64_t)b;
+    for (int i = 0; i < 5; i++)
+        f[i] ^= mask & (f[i] ^ g[i]);
+}
+
+/* +---------------------+ */
+/* | group operations    | */
+/* +---------------------+ */
+
+/* extended coordinates, x = X/Z, y = Y/Z and xy = T/Z */
+struct ge_ext { fe X, Y, Z, T; };
+
+/* an affine point prepared for additions: y + x, y - x and 2dxy */
+struct ge_niels { fe yp, ym, xy2d; };
+
+static void ge_identity (struct ge_ext *h)
+{
+    fe_set(h->X, 0);
+    fe_set(h->Y, 1);
+    fe_set(h->Z, 1);
+    fe_set(h->T, 0);
+}
+
+/* r = p + q, unified and complete for a = -1 and d not a square */
+static void ge_add (struct ge_ext *r, const struct ge_ext *p, const struct ge_ext *q)
+{
+    fe a, b, c, d, e, f, g, h;
+
+    fe_sub(a, p->Y, p->X);
+    fe_sub(e, q->Y, q->X);
+    fe_mul(a, a, e);
+    fe_add(b, p->Y, p->X);
+    fe_add(e, q->Y, q->X);
+    fe_mul(b, b, e);
+    fe_mul(c, p->T, q->T);
+    fe_mul(c, c, fe_d2);
+    fe_mul(d, p->Z, q->Z);
+    fe_add(d, d, d);
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+    fe_mul(r->X, e, f);
+    fe_mul(r->Y, g, h);
+    fe_mul(r->T, e, h);
+    fe_mul(r->Z, f, g);
+}
+
+/* r = p + q for q in the table, which saves a multiplication */
+static void ge_madd (struct ge_ext *r, const struct ge_ext *p, const struct ge_niels *q)
+{
+    fe a, b, c, d, e, f, g, h;
+
+    fe_sub(a, p->Y, p->X);
+    fe_mul(a, a, q->ym);
+    fe_add(b, p->Y, p->X);
+    fe_mul(b, b, q->yp);
+    fe_mul(c, p->T, q->xy2d);
+    fe_add(d, p->Z, p->Z);
+    fe_sub(e, b, a);
+    fe_sub(f, d, c);
+    fe_add(g, d, c);
+    fe_add(h, b, a);
+    fe_mul(r->X, e, f);
+    fe_mul(r->Y, g, h);
+    fe_mul(r->T, e, h);
+    fe_mul(r->Z, f, g);
+}
+
+/* r = 2p */
+static void ge_double (struct ge_ext *r, const struct ge_ext *p)
+{
+    fe a, b, c, e, f, g, h;
+
+    fe_mul(a, p->X, p->X);
+    fe_mul(b, p->Y, p->Y);
+    fe_mul(c, p->Z, p->Z);
+    fe_add(c, c, c);
+    fe_add(e, p->X, p->Y);
+    fe_mul(e, e, e);
+    fe_sub(e, e, a);
+    fe_sub(e, e, b);
+    fe_sub(g, b, a);        /* -A + B */
+    fe_sub(f, g, c);
+    fe_add(h, a, b);
+    fe_neg(h, h);           /* -A - B */
+    fe_mul(r->X, e, f);
+    fe_mul(r->Y, g, h);
+    fe_mul(r->T, e, h);
+    fe_mul(r->Z, f, g);
+}
+
+/* 1/z of each element with a single inversion, scratch holds n elements */
+static void fe_invert_batch (fe *out, const fe *z, fe *scratch, size_t n)
+{
+    fe inv, t;
+
+    if (n == 0)
+        return;
+    fe_copy(scratch[0], z[0]);
+    for (size_t i = 1; i < n; i++)
+        fe_mul(scratch[i], scratch[i - 1], z[i]);
+    fe_invert(inv, scratch[n - 1]);
+    for (size_t i = n - 1; i > 0; i--) {
+        fe_mul(t, inv, scratch[i - 1]);
+        fe_mul(inv, inv, z[i]);
+        fe_copy(out[i], t);
+    }
+    fe_copy(out[0], inv);
+}
+
+/* +---------------------+ */
+/* | base point table    | */
+/* +---------------------+ */
+
+/* j * 256^i * B for i < 32 and j = 1 .. 8 */
+static struct ge_niels ed25519_table[32][8];
+
+static void ed25519_table_build ()
+{
+    static struct ge_ext points[32][8];
+    static fe zs[32 * 8], zinv[32 * 8], scratch[32 * 8];
+    struct ge_ext base;
+    fe x, y;
+
+    /* the base point, then 256 times the previous one */
+    fe_copy(base.X, fe_base_x);
+    fe_copy(base.Y, fe_base_y);
+    fe_set(base.Z, 1);
+    fe_mul(base.T, fe_base_x, fe_base_y);
+    for (int i = 0; i < 32; i++) {
+        points[i][0] = base;
+        for (int j = 1; j < 8; j++)
+            ge_add(&points[i][j], &points[i][j - 1], &base);
+        for (int k = 0; k < 8; k++)
+            ge_double(&base, &base);
+    }
+
+    /* all of them affine at once */
+    for (int i = 0; i < 32 * 8; i++)
+        fe_copy(zs[i], points[i / 8][i % 8].Z);
+    fe_invert_batch(zinv, zs, scratch, 32 * 8);
+    for (int i = 0; i < 32 * 8; i++) {
+        struct ge_niels *t = &ed25519_table[i / 8][i % 8];
+        fe_mul(x, points[i / 8][i % 8].X, zinv[i]);
+        fe_mul(y, points[i / 8][i % 8].Y, zinv[i]);
+        fe_add(t->yp, y, x);
+        fe_sub(t->ym, y, x);
+        fe_mul(t->xy2d, x, y);
+        fe_mul(t->xy2d, t->xy2d, fe_d2);
+    }
+}
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t ed25519_table_once = PTHREAD_ONCE_INIT;
+#else
+static int ed25519_table_built = 0;
+#endif
+
+void ed25519_init ()
+{
+#ifdef HAVE_PTHREAD
+    pthread_once(&ed25519_table_once, ed25519_table_build);
+#else
+    if (!ed25519_table_built)
+        ed25519_table_build();
+    ed25519_table_built = 1;
+#endif
+}
+
+/* 1 if b == c, in constant time */
+static unsigned int ct_equal (unsigned char b, unsigned char c)
+{
+    uint32_t x = b ^ c;
+    return (x - 1) >> 31;
+}
+
+/* t = b * 256^pos * B for -8 <= b <= 8, reading every entry of the row */
+static void ed25519_select (struct ge_niels *t, int pos, signed char b)
+{
+    const unsigned int negative = (unsigned char)b >> 7;
+    const unsigned char babs = b - (((-negative) & b) << 1);
+    struct ge_niels minus;
+
+    fe_set(t->yp, 1);
+    fe_set(t->ym, 1);
+    fe_set(t->xy2d, 0);
+    for (int j = 0; j < 8; j++) {
+        unsigned int hit = ct_equal(babs, j + 1);
+        fe_cmov(t->yp, ed25519_table[pos][j].yp, hit);
+        fe_cmov(t->ym, ed25519_table[pos][j].ym, hit);
+        fe_cmov(t->xy2d, ed25519_table[pos][j].xy2d, hit);
+    }
+
+    /* -P swaps y + x and y - x and negates xy */
+    fe_copy(minus.yp, t->ym);
+    fe_copy(minus.ym, t->yp);
+    fe_neg(minus.xy2d, t->xy2d);
+    fe_cmov(t->yp, minus.yp, negative);
+    fe_cmov(t->ym, minus.ym, negative);
+    fe_cmov(t->xy2d, minus.xy2d, negative);
+}
+
+/* h = a * B for a scalar below 2^255 */
+static void ed25519_scalarmult_base (struct ge_ext *h, const unsigned char *a)
+{
+    signed char e[64];
+    signed char carry = 0;
+    struct ge_niels t;
+
+    /* signed digits: a = sum e[i] 16^i with -8 <= e[i] < 8 */
+    for (int i = 0; i < 32; i++) {
+        e[2 * i] = a[i] & 15;
+        e[2 * i + 1] = a[i] >> 4;
+    }
+    for (int i = 0; i < 63; i++) {
+        e[i] += carry;
+        carry = (e[i] + 8) >> 4;
+        e[i] -= carry << 4;
+    }
+    e[63] += carry;
+
+    /* odd digits, times 16, then the even ones */
+    ge_identity(h);
+    for (int i = 1; i < 64; i += 2) {
+        ed25519_select(&t, i / 2, e[i]);
+        ge_madd(h, h, &t);
+    }
+    for (int k = 0; k < 4; k++)
+        ge_double(h, h);
+    for (int i = 0; i < 64; i += 2) {
+        ed25519_select(&t, i / 2, e[i]);
+        ge_madd(h, h, &t);
+    }
+
+    memzero(e, sizeof e);
+    memzero(&t, sizeof t);
+}
+
+/* +---------------------+ */
+/* | public keys         | */
+/* +---------------------+ */
+
+void ed25519_public_batch (const unsigned char *const *seeds, size_t n,
+                           unsigned char (*pks)[ED25519_PUBLIC_SIZE])
+{
+    struct ge_ext points[ED25519_BATCH];
+    fe zs[ED25519_BATCH], zinv[ED25519_BATCH], scratch[ED25519_BATCH], x, y;
+    unsigned char digest[SHA512_DIGEST_SIZE], xbytes[32];
+    size_t m;
+
+    ed25519_init();
+
+    for (size_t done = 0; done < n; done += m) {
+        m = n - done < ED25519_BATCH ? n - done : ED25519_BATCH;
+
+        /* the secret scalar is the clamped first half of the hash of the seed */
+        for (size_t k = 0; k < m; k++) {
+            sha512(seeds[done + k], ED25519_SEED_SIZE, digest);
+            digest[0] &= 248;
+            digest[31] &= 127;
+            digest[31] |= 64;
+            ed25519_scalarmult_base(&points[k], digest);
+            fe_copy(zs[k], points[k].Z);
+        }
+
+        /* encoded as y with the sign of x in the top bit */
+        fe_invert_batch(zinv, zs, scratch, m);
+        for (size_t k = 0; k < m; k++) {
+            fe_mul(x, points[k].X, zinv[k]);
+            fe_mul(y, points[k].Y, zinv[k]);
+            fe_tobytes(pks[done + k], y);
+            fe_tobytes(xbytes, x);
+            pks[done + k][31] ^= (xbytes[0] & 1) << 7;
+        }
+    }
+
+    memzero(digest, sizeof digest);
+    memzero(points, sizeof points);
+    memzero(zs, sizeof zs);
+    memzero(zinv, sizeof zinv);
+    memzero(scratch, sizeof scratch);
+    memzero(x, sizeof x);
+}
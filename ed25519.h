@@ -0,0 +1,32 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_ed25519_h_
+#define _headerguard_ed25519_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/****************************************************************************************/
+
+#define ED25519_SEED_SIZE   32
+#define ED25519_PUBLIC_SIZE 32
+
+/* public keys derived together, which share a single field inversion */
+#define ED25519_BATCH 32
+
+/****************************************************************************************/
+
+/* derive the public key of each secret seed: the clamped first half of its sha512
+   times the base point. the multiples of the base point are tabulated once, on
+   first use, and every key is computed in constant time */
+void ed25519_public_batch (const unsigned char *const *seeds, size_t n,
+                           unsigned char (*pks)[ED25519_PUBLIC_SIZE]);
+
+/* build the table now, e.g. so that it is not measured later */
+void ed25519_init ();
+
+#endif
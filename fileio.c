@@ -38,6 +38,15 @@
 extern int openwriting (const char *file) {
     return open(file, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0644);
 }
+extern int openwriting_secret (const char *file) {
+    int fd = open(file, O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0600);
+    /* an existing file keeps its mode otherwise */
+    if (fd != -1 && fchmod(fd, 0600) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 extern int openreading (const char *file) {
     return open(file, O_RDONLY | O_CLOEXEC);
 }
@@ -92,6 +101,30 @@ extern int io (ssize_t (*rw) (int, void *, size_t), int fd, void *data, size_t d
 }
 
 
+/* a single read, so that a stream is handled as it arrives instead of
+   waiting for datalen bytes like io does */
+extern int readchunk (int fd, void *data, size_t datalen, size_t *readlen)
+{
+    ssize_t got;
+    struct pollfd polling = { .fd = fd, .events = POLLIN };
+
+    *readlen = 0;
+    for (;;) {
+        if ((got = read(fd, data, datalen)) >= 0)
+            break;
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            poll(&polling, 1, -1);
+            continue;
+        }
+        return FILEIO_IOERROR;
+    }
+
+    *readlen = (size_t)got;
+    return SUCCESS;
+}
+
 /* load a file to buffer */
 extern int loadfile (const char *file, struct buffer **filebuf)
 {
@@ -136,19 +169,84 @@ extern int loadfile (const char *file, struct buffer **filebuf)
     return e;
 }
 
-/* save a string as data to a file */
-extern int savestring (const char *file, unsigned char *string, size_t stringlen)
+/* read a passphrase, one byte at a time so that nothing after the newline is consumed */
+extern int loadpassphrase (int fd, char *pass, size_t passlen)
+{
+    int e = FAILURE;
+    size_t len = 0, readlen;
+    char ch;
+
+    if (pass == NULL || passlen == 0)
+        return ERR_NULLPTR;
+
+    for (;;) {
+        if ((e = io (read, fd, &ch, 1, &readlen)) != SUCCESS)
+            break;
+        if (readlen == 0 || ch == '\n')
+            break;
+        if (len + 1 >= passlen) {
+            e = FILEIO_PASSPHRASE_TOO_LONG;
+            break;
+        }
+        pass[len++] = ch;
+    }
+
+    /* strip a carriage return from files written elsewhere */
+    if (len > 0 && pass[len - 1] == '\r')
+        len--;
+    pass[len] = '\0';
+
+    if (e != SUCCESS)
+        memzero(pass, passlen);
+    return e;
+}
+
+/* read a small file whole into string, which must be larger than the file */
+extern int loadstring (const char *file, unsigned char *string, size_t stringlen, size_t *readlen)
 {
     int e = FAILURE;
     int fd;
+    size_t len;
 
-    /* check for nullpointers */
-    if (string == NULL || file == NULL)
+    if (string == NULL || file == NULL || readlen == NULL)
         return ERR_NULLPTR;
-    
-    /* open for writing */
-    if ((fd = openwriting(file)) == -1)
-        return FILEIO_CANNOT_OPEN_WRITING;
+    *readlen = 0;
+
+    if ((fd = openreading(file)) == -1)
+        return FILEIO_CANNOT_OPEN_READING;
+
+    /* a file which fills string completely may be longer still */
+    if ((e = io (read, fd, string, stringlen, &len)) == SUCCESS && len == stringlen)
+        e = BUFFER_LENGTH_OVER_MAXIMUM;
+    close(fd);
+
+    if (e != SUCCESS) {
+        memzero(string, stringlen);
+        return e;
+    }
+    *readlen = len;
+    return SUCCESS;
+}
+
+/* random bytes from the kernel */
+extern int loadrandom (void *data, size_t datalen)
+{
+    int e = FAILURE;
+    int fd;
+    size_t len;
+
+    if ((fd = openreading("/dev/urandom")) == -1)
+        return FILEIO_CANNOT_OPEN_READING;
+    if ((e = io (read, fd, data, datalen, &len)) == SUCCESS && len != datalen)
+        e = FILEIO_IOERROR;
+    close(fd);
+    return e;
+}
+
+/* write a string to a file that was just opened */
+static int writestring (int fd, const char *file, unsigned char *string, size_t stringlen)
+{
+    int e = FAILURE;
 
     /* variable to check written bytes */
     size_t writelen;
@@ -169,6 +267,35 @@ extern int savestring (const char *file, unsigned char *string, size_t stringlen
     return e;
 }
 
+/* save a string as data to a file */
+extern int savestring (const char *file, unsigned char *string, size_t stringlen)
+{
+    int fd;
+
+    /* check for nullpointers */
+    if (string == NULL || file == NULL)
+        return ERR_NULLPTR;
+
+    /* open for writing */
+    if ((fd = openwriting(file)) == -1)
+        return FILEIO_CANNOT_OPEN_WRITING;
+
+    return writestring(fd, file, string, stringlen);
+}
+
+/* the same for a secret, which only the owner may read */
+extern int savesecret (const char *file, unsigned char *string, size_t stringlen)
+{
+    int fd;
+
+    if (string == NULL || file == NULL)
+        return ERR_NULLPTR;
+    if ((fd = openwriting_secret(file)) == -1)
+        return FILEIO_CANNOT_OPEN_WRITING;
+
+    return writestring(fd, file, string, stringlen);
+}
+
 /* save a buffer to file */
 extern int savefile (const char *file, struct buffer *filebuf)
 {
@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <poll.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "errors.h"
 #include "buffer.h"
@@ -28,6 +29,7 @@
 
 /* open file descriptors */
 extern int openwriting (const char *file);
+extern int openwriting_secret (const char *file);
 extern int openreading (const char *file);
 
 /* functions passable to io function (casting the const on write)*/
@@ -37,9 +39,22 @@ extern int openreading (const char *file);
 /* lowlevel io */
 extern int io (ssize_t (*rw) (int, void *, size_t), int fd, void *data, size_t datalen, size_t *iolenptr);
 
+/* one read of whatever is available, at most datalen bytes. readlen is 0 at EOF */
+extern int readchunk (int fd, void *data, size_t datalen, size_t *readlen);
+
 /* load and save files to/from buffer */
 extern int loadfile   (const char *file, struct buffer **filebuf);
 extern int savefile   (const char *file, struct buffer  *filebuf);
 extern int savestring (const char *file, unsigned char *string, size_t stringlen);
+extern int savesecret (const char *file, unsigned char *string, size_t stringlen);
+
+/* read a small file whole, which must be shorter than stringlen */
+extern int loadstring (const char *file, unsigned char *string, size_t stringlen, size_t *readlen);
+
+/* fill data with random bytes of the kernel */
+extern int loadrandom (void *data, size_t datalen);
+
+/* read a passphrase up to the first newline or EOF from a file descriptor */
+extern int loadpassphrase (int fd, char *pass, size_t passlen);
 
 #endif /* _headerguard_fileio_h_ */
\ No newline at end of file
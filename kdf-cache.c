@@ -0,0 +1,167 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * Derived keys are kept in a static table which is locked into memory, so
+ * that it is never written to swap, and left out of core dumps where the
+ * system allows. If it cannot be locked there is no cache and every key is
+ * derived on its own. Entries are found by a hash over all inputs of the
+ * derivation, the passphrase itself is not kept.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "kdf-cache.h"
+#include "sha512.h"
+#include "utilities.h"
+
+struct kdf_cache_entry {
+    unsigned char tag[SHA512_DIGEST_SIZE];
+    unsigned char key[KDF_CACHE_MAXKEYLEN];
+    int valid;
+};
+
+/* page aligned for madvise */
+static struct kdf_cache_entry kdf_cache[KDF_CACHE_SLOTS] __attribute__((aligned(4096)));
+
+/* 0 before the first use, then 1 if locked or -1 if not */
+static int kdf_cache_state = 0;
+
+/* slot to replace next, round robin */
+static size_t kdf_cache_next = 0;
+
+/* lock the table on first use */
+static int kdf_cache_available ()
+{
+    if (kdf_cache_state == 0) {
+        kdf_cache_state = mlock(kdf_cache, sizeof kdf_cache) == 0 ? 1 : -1;
+#ifdef MADV_DONTDUMP
+        if (kdf_cache_state == 1)
+            madvise(kdf_cache, sizeof kdf_cache, MADV_DONTDUMP);
+#endif
+    }
+    return kdf_cache_state == 1;
+}
+
+/* hash of the length prefixed inputs */
+static void kdf_cache_tag (const char *pass, size_t passlen, const unsigned char *salt, size_t saltlen,
+                           size_t keylen, unsigned int rounds, unsigned char tag[SHA512_DIGEST_SIZE])
+{
+    struct sha512_ctx ctx;
+    unsigned char num[4];
+
+#define KDF_CACHE_NUM(x) \
+    num[0] = (x) >> 24; num[1] = (x) >> 16; num[2] = (x) >> 8; num[3] = (x); \
+    sha512_update(&ctx, num, sizeof num)
+
+    sha512_init(&ctx);
+    KDF_CACHE_NUM(passlen);
+    sha512_update(&ctx, (const unsigned char *)pass, passlen);
+    KDF_CACHE_NUM(saltlen);
+    sha512_update(&ctx, salt, saltlen);
+    KDF_CACHE_NUM(keylen);
+    KDF_CACHE_NUM(rounds);
+    sha512_final(&ctx, tag);
+
+#undef KDF_CACHE_NUM
+}
+
+static struct kdf_cache_entry *kdf_cache_find (const unsigned char tag[SHA512_DIGEST_SIZE])
+{
+    for (size_t i = 0; i < KDF_CACHE_SLOTS; i++)
+        if (kdf_cache[i].valid && memcmp(kdf_cache[i].tag, tag, SHA512_DIGEST_SIZE) == 0)
+            return &kdf_cache[i];
+    return NULL;
+}
+
+/* an empty entry for tag, replacing the oldest one */
+static struct kdf_cache_entry *kdf_cache_claim (const unsigned char tag[SHA512_DIGEST_SIZE])
+{
+    struct kdf_cache_entry *entry = &kdf_cache[kdf_cache_next];
+
+    kdf_cache_next = (kdf_cache_next + 1) % KDF_CACHE_SLOTS;
+    memzero(entry, sizeof *entry);
+    memcpy(entry->tag, tag, SHA512_DIGEST_SIZE);
+    return entry;
+}
+
+int kdf_cache_derive (const char *pass, size_t passlen, const unsigned char *salt, size_t saltlen,
+                      unsigned char *key, size_t keylen, unsigned int rounds)
+{
+    unsigned char tag[SHA512_DIGEST_SIZE];
+    struct kdf_cache_entry *entry;
+
+    if (keylen > KDF_CACHE_MAXKEYLEN || saltlen > KDF_CACHE_MAXSALTLEN || !kdf_cache_available())
+        return bcrypt_pbkdf(pass, passlen, salt, saltlen, key, keylen, rounds);
+
+    kdf_cache_tag(pass, passlen, salt, saltlen, keylen, rounds, tag);
+    if ((entry = kdf_cache_find(tag)) == NULL) {
+        entry = kdf_cache_claim(tag);
+        if (bcrypt_pbkdf(pass, passlen, salt, saltlen, entry->key, keylen, rounds) != 0) {
+            memzero(entry, sizeof *entry);
+            return -1;
+        }
+        entry->valid = 1;
+    }
+
+    memcpy(key, entry->key, keylen);
+    return 0;
+}
+
+void kdf_cache_prefetch (const char *pass, size_t passlen, const struct kdf_cache_job *jobs, size_t njobs)
+{
+    struct bcrypt_pbkdf_job batch[KDF_CACHE_BATCH];
+    struct kdf_cache_entry *entries[KDF_CACHE_BATCH];
+    unsigned char tags[KDF_CACHE_BATCH][SHA512_DIGEST_SIZE];
+    size_t nbatch = 0, i, j;
+
+    if (!kdf_cache_available())
+        return;
+    if (njobs > KDF_CACHE_BATCH)
+        njobs = KDF_CACHE_BATCH;
+
+    /* claim entries for what is neither cached nor already in this batch,
+       they become valid once derived */
+    for (i = 0; i < njobs; i++) {
+        if (jobs[i].keylen > KDF_CACHE_MAXKEYLEN || jobs[i].saltlen > KDF_CACHE_MAXSALTLEN)
+            continue;
+        kdf_cache_tag(pass, passlen, jobs[i].salt, jobs[i].saltlen, jobs[i].keylen, jobs[i].rounds, tags[nbatch]);
+        if (kdf_cache_find(tags[nbatch]) != NULL)
+            continue;
+        for (j = 0; j < nbatch && memcmp(tags[j], tags[nbatch], SHA512_DIGEST_SIZE) != 0; j++)
+            ;
+        if (j < nbatch)
+            continue;
+
+        entries[nbatch] = kdf_cache_claim(tags[nbatch]);
+        batch[nbatch] = (struct bcrypt_pbkdf_job) {
+            .pass = pass, .passlen = passlen,
+            .salt = jobs[i].salt, .saltlen = jobs[i].saltlen,
+            .key = entries[nbatch]->key, .keylen = jobs[i].keylen,
+            .rounds = jobs[i].rounds,
+        };
+        nbatch++;
+    }
+
+    if (nbatch == 0)
+        return;
+    bcrypt_pbkdf_batch(batch, nbatch);
+    for (i = 0; i < nbatch; i++) {
+        if (batch[i].result == 0)
+            entries[i]->valid = 1;
+        else
+            memzero(entries[i], sizeof *entries[i]);
+    }
+}
+
+void kdf_cache_clear ()
+{
+    memzero(kdf_cache, sizeof kdf_cache);
+    if (kdf_cache_state == 1)
+        munlock(kdf_cache, sizeof kdf_cache);
+    kdf_cache_state = 0;
+    kdf_cache_next = 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_kdf_cache_h_
+#define _headerguard_kdf_cache_h_
+
+#include <stddef.h>
+
+#include "bcrypt-pbkdf.h"
+#include "cipher.h"
+
+/****************************************************************************************/
+
+/* derived keys remembered, and the largest key and salt worth remembering.
+   a batch never evicts its own entries, as it is a fraction of the slots */
+#define KDF_CACHE_SLOTS      256
+#define KDF_CACHE_MAXKEYLEN  ( CIPHER_MAXKEYLEN + CIPHER_MAXIVLEN )
+#define KDF_CACHE_MAXSALTLEN 64
+#define KDF_CACHE_BATCH      BCRYPT_PBKDF_MAXBATCH
+
+/* a derivation to compute ahead of time */
+struct kdf_cache_job {
+    unsigned char salt[KDF_CACHE_MAXSALTLEN];
+    size_t saltlen;
+    unsigned int rounds;
+    size_t keylen;
+};
+
+/****************************************************************************************/
+
+/* bcrypt_pbkdf, but the key for a passphrase, salt, rounds and keylen seen
+   before is taken from the cache. returns 0, or -1 on invalid arguments */
+int kdf_cache_derive (const char *pass, size_t passlen, const unsigned char *salt, size_t saltlen,
+                      unsigned char *key, size_t keylen, unsigned int rounds);
+
+/* derive up to KDF_CACHE_BATCH keys into the cache at once, on all cpus,
+   so that kdf_cache_derive finds them. jobs already cached or repeated in
+   the batch are computed once */
+void kdf_cache_prefetch (const char *pass, size_t passlen, const struct kdf_cache_job *jobs, size_t njobs);
+
+/* wipe and unlock the cache */
+void kdf_cache_clear ();
+
+#endif
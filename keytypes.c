@@ -0,0 +1,134 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * The registry is the KEYTYPES list of keytypes.h. Names are found with a
+ * perfect hash: FNV-1a over the name, started from a seed which is searched
+ * on first use until no two names share a slot, so a lookup hashes the name
+ * and compares a single entry. Should no seed be found, every lookup scans
+ * the list instead, which the self test reports.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include "keytypes.h"
+#include "openssh-parse.h"
+
+/* operations of the families named in KEYTYPES */
+static const struct keytype_ops keytype_ops_ed25519 = {
+    .parse       = openssh_parse_ed25519,
+    .set         = opensshkey_ed25519_set,
+    .public_blob = opensshkey_ed25519_public_blob,
+    .save        = opensshkey_ed25519_save,
+    .batch_set   = opensshkey_ed25519_batch_set,
+    .batch_save  = opensshkey_ed25519_batch_save,
+};
+static const struct keytype_ops keytype_ops_nistp256 = {
+    .parse       = openssh_parse_nistp256,
+    .set         = opensshkey_nistp256_set,
+    .public_blob = opensshkey_nistp256_public_blob,
+    .save        = opensshkey_nistp256_save,
+    .batch_set   = opensshkey_nistp256_batch_set,
+    .batch_save  = opensshkey_nistp256_batch_save,
+};
+static const struct keytype_ops keytype_ops_none = { NULL };
+
+#define AS_KEYTYPE(id, name, shortname, type, nid, cert, fields, bits, ops) \
+    { name, sizeof name - 1, shortname, type, nid, cert, fields, bits, &keytype_ops_##ops }
+static const struct keytype keytypes[] = { KEYTYPES(AS_KEYTYPE) };
+
+/* slots hold the index of a keytype plus one, 0 is empty */
+static unsigned char keytype_slots[KEYTYPE_SLOTS];
+static uint32_t keytype_seed;
+static int keytype_perfect = 0;
+
+/* keytypes by type and curve, the curve is shifted by one for NID_NONE */
+static const struct keytype *keytype_classes[KEY_UNSPECIFIED + 1][NID_MAX + 1];
+
+/* FNV-1a, the seed mixed into the offset basis */
+static uint32_t keytype_hash (uint32_t seed, const unsigned char *name, size_t len)
+{
+    uint32_t h = 0x811c9dc5 ^ seed;
+
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ name[i]) * 0x01000193;
+    return h ^ h >> 16;
+}
+
+static void keytype_build ()
+{
+    for (uint32_t seed = 0; seed < 1 << 16 && !keytype_perfect; seed++) {
+        memset(keytype_slots, 0, sizeof keytype_slots);
+        keytype_perfect = 1;
+        for (size_t i = 0; i < KEYTYPE_COUNT && keytype_perfect; i++) {
+            uint32_t slot = keytype_hash(seed, (const unsigned char *)keytypes[i].name,
+                                         keytypes[i].namelen) % KEYTYPE_SLOTS;
+            if (keytype_slots[slot] != 0)
+                keytype_perfect = 0;
+            keytype_slots[slot] = i + 1;
+        }
+        keytype_seed = seed;
+    }
+
+    /* the first keytype of a type and curve names it */
+    for (size_t i = KEYTYPE_COUNT; i-- > 0; )
+        keytype_classes[keytypes[i].type][keytypes[i].nid + 1] = &keytypes[i];
+}
+
+#ifdef HAVE_PTHREAD
+static pthread_once_t keytype_once = PTHREAD_ONCE_INIT;
+#else
+static int keytype_built = 0;
+#endif
+
+int keytype_init ()
+{
+#ifdef HAVE_PTHREAD
+    pthread_once(&keytype_once, keytype_build);
+#else
+    if (!keytype_built)
+        keytype_build();
+    keytype_built = 1;
+#endif
+    return keytype_perfect ? 0 : -1;
+}
+
+const struct keytype *keytype_by_name (const unsigned char *name, size_t len)
+{
+    const struct keytype *kt;
+    unsigned char slot;
+
+    if (name == NULL)
+        return NULL;
+
+    if (keytype_init() == 0) {
+        if ((slot = keytype_slots[keytype_hash(keytype_seed, name, len) % KEYTYPE_SLOTS]) == 0)
+            return NULL;
+        kt = &keytypes[slot - 1];
+        return kt->namelen == len && memcmp(kt->name, name, len) == 0 ? kt : NULL;
+    }
+
+    for (size_t i = 0; i < KEYTYPE_COUNT; i++)
+        if (keytypes[i].namelen == len && memcmp(keytypes[i].name, name, len) == 0)
+            return &keytypes[i];
+    return NULL;
+}
+
+const struct keytype *keytype_of (int type, int nid)
+{
+    if (type < 0 || type > KEY_UNSPECIFIED || nid < NID_NONE || nid >= NID_MAX)
+        return NULL;
+
+    keytype_init();
+    return keytype_classes[type][nid + 1];
+}
+
+const struct keytype *keytype_list (size_t i)
+{
+    return i < KEYTYPE_COUNT ? &keytypes[i] : NULL;
+}
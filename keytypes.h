@@ -0,0 +1,101 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_keytypes_h_
+#define _headerguard_keytypes_h_
+
+#include <stddef.h>
+
+#include "openssh-key.h"
+
+/****************************************************************************************/
+
+/* collection of all keytype names of openssh-key-v1 files, from which the registry,
+   its lookup and the dispatch to the operations of each type are built. per name:
+   the short name shown with fingerprints, the type and curve of a key, whether it
+   is a certificate, the strings which follow the name in a private key, so that
+   unsupported keys can be skipped, the bits shown with fingerprints and the family
+   of operations, none for keys which are only skipped. "unknown" must come before
+   the other names of KEY_UNKNOWN, it names keys of that type */
+#define KEYTYPES(fn) \
+    fn( ED25519,            "ssh-ed25519",                              "ED25519",      KEY_ED25519,        NID_NONE,               0, 2, 256, ed25519 ),\
+    fn( ED25519_CERT,       "ssh-ed25519-cert-v01@openssh.com",         "ED25519-CERT", KEY_ED25519_CERT,   NID_NONE,               1, 3, 256, ed25519 ),\
+    fn( ECDSA_P256,         "ecdsa-sha2-nistp256",                      "ECDSA",        KEY_ECDSA,          NID_X9_62_prime256v1,   0, 3, 256, nistp256),\
+    fn( ECDSA_P256_CERT,    "ecdsa-sha2-nistp256-cert-v01@openssh.com", "ECDSA-CERT",   KEY_ECDSA_CERT,     NID_X9_62_prime256v1,   1, 2, 256, none    ),\
+    fn( ECDSA_P384,         "ecdsa-sha2-nistp384",                      "ECDSA",        KEY_ECDSA,          NID_secp384r1,          0, 3, 384, none    ),\
+    fn( ECDSA_P384_CERT,    "ecdsa-sha2-nistp384-cert-v01@openssh.com", "ECDSA-CERT",   KEY_ECDSA_CERT,     NID_secp384r1,          1, 2, 384, none    ),\
+    fn( ECDSA_P521,         "ecdsa-sha2-nistp521",                      "ECDSA",        KEY_ECDSA,          NID_secp521r1,          0, 3, 521, none    ),\
+    fn( ECDSA_P521_CERT,    "ecdsa-sha2-nistp521-cert-v01@openssh.com", "ECDSA-CERT",   KEY_ECDSA_CERT,     NID_secp521r1,          1, 2, 521, none    ),\
+    fn( UNKNOWN,            "unknown",                                  "UNKNOWN",      KEY_UNKNOWN,        NID_NONE,               0, 0,   0, none    ),\
+    fn( RSA,                "ssh-rsa",                                  "RSA",          KEY_UNKNOWN,        NID_NONE,               0, 6,   0, none    ),\
+    fn( RSA_CERT,           "ssh-rsa-cert-v01@openssh.com",             "RSA-CERT",     KEY_UNKNOWN,        NID_NONE,               1, 5,   0, none    ),\
+    fn( DSA,                "ssh-dss",                                  "DSA",          KEY_UNKNOWN,        NID_NONE,               0, 5,   0, none    ),\
+    fn( DSA_CERT,           "ssh-dss-cert-v01@openssh.com",             "DSA-CERT",     KEY_UNKNOWN,        NID_NONE,               1, 2,   0, none    )
+
+/* curves of ecdsa keys, named as in openssl */
+enum keytype_curves { NID_NONE = -1, NID_X9_62_prime256v1, NID_secp384r1, NID_secp521r1, NID_MAX };
+
+/* an enum with an id for every name, and their number */
+#define AS_KEYTYPE_ID(id, ...) KEYTYPE_##id
+enum keytype_ids { KEYTYPES(AS_KEYTYPE_ID), KEYTYPE_COUNT };
+
+/* slots of the lookup table, a power of two and several times KEYTYPE_COUNT
+   so that a seed without collisions is found after a few tries */
+#define KEYTYPE_SLOTS 64
+
+/* the key material of a private key, pointing into the data it was read from */
+struct keytype_material {
+    const unsigned char *pk, *sk;
+    size_t pklen, sklen;
+};
+
+struct keytype;
+
+/* what a family of keytypes can do, each may be NULL */
+struct keytype_ops {
+    /* read the strings after the name of a private key, data is advanced past them */
+    int (*parse)       (const struct keytype *kt, const unsigned char **data, size_t *datalen,
+                        struct keytype_material *material);
+    /* copy the material into a key initialized to the type */
+    int (*set)         (struct opensshkey *key, const struct keytype_material *material);
+    /* serialize the public key blob */
+    int (*public_blob) (const struct opensshkey *key, unsigned char *blob, size_t bloblen, size_t *len);
+    /* write a tinyssh keydir */
+    int (*save)        (const struct opensshkey *key, const unsigned char *dir);
+    /* the same for slot i of a batch, which set fills */
+    int (*batch_set)   (struct opensshkey_batch *batch, size_t i, const struct keytype_material *material);
+    int (*batch_save)  (const struct opensshkey_batch *batch, size_t i, const unsigned char *dir);
+};
+
+/* an entry of the registry */
+struct keytype {
+    const char *name;
+    size_t namelen;
+    const char *shortname;
+    int type;
+    int nid;
+    int iscert;
+    unsigned int fields;
+    int bits;
+    const struct keytype_ops *ops;
+};
+
+/****************************************************************************************/
+
+/* the keytype of a name which is not terminated, or NULL. a single slot of a
+   perfect hash table is compared, which is built on first use */
+const struct keytype *keytype_by_name (const unsigned char *name, size_t len);
+
+/* the keytype which names keys of this type and curve, or NULL */
+const struct keytype *keytype_of (int type, int nid);
+
+/* all keytypes in order, NULL after the last one */
+const struct keytype *keytype_list (size_t i);
+
+/* build the lookup tables now, 0 if the hash is perfect */
+int keytype_init ();
+
+#endif
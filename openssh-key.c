@@ -4,47 +4,21 @@
  * and redistributions of this project.
  */
 
+#include <sys/mman.h>
+
 #include "openssh-key.h"
+#include "keytypes.h"
+#include "base64.h"
+#include "base64-simd.h"
+#include "sha256.h"
+#include "ed25519.h"
+#include "p256.h"
 
-/* opaque EC_KEY + ECDSA NIDs to make it compile for now .. */
-typedef struct EC_KEY EC_KEY;
-enum ecdsa_nids { NID_X9_62_prime256v1, NID_secp384r1, NID_secp521r1 };
-
-/* +-------------------+ */
-/* | structs and types | */
-/* +-------------------+ */
-
-/* openssh key struct */
-struct opensshkey {
-    int	 type;
-	/* ecdsa nist curves */
-	int	    ecdsa_nid;
-	EC_KEY *ecdsa_key;
-    /* ed25519 curve */
-	unsigned char *ed25519_sk;
-	unsigned char *ed25519_pk;
-};
-
-/* supported key types */
-static const struct {
-	const char *name;
-	const char *shortname;
-	int type;
-    int nid;
-    int iscert;
-} supported_keytypes[] = {
-/*    name                                          shortname       type                ecdsa_nid             cert */
-	{ "ssh-ed25519",                                "ED25519",      KEY_ED25519,        -1,                     0 },
-	{ "ssh-ed25519-cert-v01@openssh.com",           "ED25519-CERT", KEY_ED25519_CERT,   -1,                     1 },
-    { "ecdsa-sha2-nistp256",                        "ECDSA",        KEY_ECDSA,          NID_X9_62_prime256v1,   0 },
-	{ "ecdsa-sha2-nistp256-cert-v01@openssh.com",   "ECDSA-CERT",   KEY_ECDSA_CERT,     NID_X9_62_prime256v1,   1 },
-	{ "ecdsa-sha2-nistp384",                        "ECDSA",        KEY_ECDSA,          NID_secp384r1,          0 },
-	{ "ecdsa-sha2-nistp384-cert-v01@openssh.com",   "ECDSA-CERT",   KEY_ECDSA_CERT,     NID_secp384r1,          1 },
-	{ "ecdsa-sha2-nistp521",                        "ECDSA",        KEY_ECDSA,          NID_secp521r1,          0 },
-	{ "ecdsa-sha2-nistp521-cert-v01@openssh.com",   "ECDSA-CERT",   KEY_ECDSA_CERT,     NID_secp521r1,          1 },
-    { "unknown",                                    "UNKNOWN",      KEY_UNKNOWN,        -1,                     0 },
-};
-#define n_supported_keytypes sizeof supported_keytypes / sizeof *supported_keytypes
+#ifdef STATIC_STORAGE
+/* fixed set of keys, nothing is ever allocated */
+static struct opensshkey opensshkey_slots[OPENSSHKEY_STATIC_SLOTS];
+static int opensshkey_slot_used[OPENSSHKEY_STATIC_SLOTS];
+#endif
 
 
 /* +--------------------------------+ */
@@ -59,50 +33,57 @@ struct opensshkey *newopensshkey (int type)
     if (type > KEY_UNKNOWN)
         return NULL;
 
-    if ((newkey = zalloc(sizeof *newkey)) == NULL)
+#ifdef STATIC_STORAGE
+    /* take the first unused slot */
+    newkey = NULL;
+    for (int i = 0; i < OPENSSHKEY_STATIC_SLOTS && newkey == NULL; i++)
+        if (!opensshkey_slot_used[i]) {
+            opensshkey_slot_used[i] = 1;
+            newkey = &opensshkey_slots[i];
+        }
+    if (newkey == NULL)
+        return NULL;
+#else
+    /* malloc does not know the alignment of the key material */
+    if (posix_memalign((void **)&newkey, OPENSSHKEY_ALIGN, sizeof *newkey) != 0)
         return NULL;
+    memset(newkey, 0, sizeof *newkey);
+#endif
     
-    newkey->type = type;
-    newkey->ecdsa_key = NULL;
-    newkey->ecdsa_nid = -1;
-    newkey->ed25519_sk = NULL;
-    newkey->ed25519_pk = NULL;
-
+    opensshkey_init(newkey, type);
     return newkey;
 }
 
+/* key in storage of the caller */
+void opensshkey_init (struct opensshkey *key, int type)
+{
+    key->type = type;
+    key->ecdsa_nid = -1;
+    key->commentlen = 0;
+    key->commentcut = 0;
+}
+
 /* free with explicit zeroing */
 void freeopensshkey (struct opensshkey *key)
 {
     if (key == NULL)
         return;
 
-    switch (key->type) {
-
-        case KEY_ED25519:
-        case KEY_ED25519_CERT:
-            /* memzero() pointers and free */
-            nullpointer(key->ed25519_pk, ED25519_PUBLICKEY_SIZE);
-            nullpointer(key->ed25519_sk, ED25519_SECRETKEY_SIZE);
-            break;
-
-        case KEY_ECDSA:
-        case KEY_ECDSA_CERT:
-        /* requires openssl or libressl ..
-            if (key->ecdsa_key != NULL)
-                EC_KEY_free(key->ecdsa_key);
-            key->ecdsa_key = NULL;
-            break; */
-        
-        case KEY_UNKNOWN:
-        default:
-            break;
-
-    }
+    opensshkey_wipe(key);
 
+#ifdef STATIC_STORAGE
+    /* return the slot */
+    opensshkey_slot_used[key - opensshkey_slots] = 0;
+#else
     /* free struct itself */
-    nullpointer(key, sizeof *key);
-    return;
+    free(key);
+#endif
+}
+
+/* wipe a key, all key material is inline. the storage itself is kept */
+void opensshkey_wipe (struct opensshkey *key)
+{
+    memzero(key, sizeof *key);
 }
 
 
@@ -113,17 +94,9 @@ void freeopensshkey (struct opensshkey *key)
 /* detect key type from given string */
 int opensshkey_detect_type (const unsigned char *name)
 {
-    for (int i = 0; i < n_supported_keytypes; i++) {
-        /* the supported keytype has invalid names */
-        if (supported_keytypes[i].name == NULL || supported_keytypes[i].shortname == NULL)
-            continue;
-        /* match long name */
-        if (strcmp(name, supported_keytypes[i].name) == 0 ||
-        /* or match short name */
-            strcasecmp(name, supported_keytypes[i].shortname) == 0)
-                return supported_keytypes[i].type;
-    }
-    return KEY_UNKNOWN;
+    const struct keytype *kt = keytype_by_name(name, name != NULL ? strlen((const char *)name) : 0);
+
+    return kt != NULL ? kt->type : KEY_UNKNOWN;
 }
 
 int opensshkey_get_type (const struct opensshkey *key)
@@ -136,29 +109,38 @@ int opensshkey_get_type (const struct opensshkey *key)
 
 const unsigned char *opensshkey_get_typename (const struct opensshkey *key)
 {
-    if (key == NULL)
+    const struct keytype *kt;
+
+    if (key == NULL || (kt = keytype_of(key->type, key->ecdsa_nid)) == NULL)
         return NULL;
+    return (const unsigned char *)kt->name;
+}
 
-    for (int i = 0; i < n_supported_keytypes; i++) {
-        /* the supported keytype has invalid names */
-        if (supported_keytypes[i].name == NULL || supported_keytypes[i].shortname == NULL)
-            continue;
-        /* match keytype */
-        if (key->type == supported_keytypes[i].type &&
-        /* and match nid */
-            key->ecdsa_nid == supported_keytypes[i].nid)
-                
-                return supported_keytypes[i].name;
-    }
-    return NULL;
+const unsigned char *opensshkey_get_shortname (const struct opensshkey *key)
+{
+    const struct keytype *kt;
+
+    if (key == NULL || (kt = keytype_of(key->type, key->ecdsa_nid)) == NULL)
+        return NULL;
+    return (const unsigned char *)kt->shortname;
+}
+
+/* key size as shown next to fingerprints */
+int opensshkey_get_bits (const struct opensshkey *key)
+{
+    const struct keytype *kt;
+
+    if (key == NULL || (kt = keytype_of(key->type, key->ecdsa_nid)) == NULL)
+        return 0;
+    return kt->bits;
 }
 
 /* +----------------------------+ */
 /* | operations on key material | */
 /* +----------------------------+ */
 
-/* set pk and sk on ed25519 key */
-int opensshkey_set_ed25519_keys (struct opensshkey *key, unsigned char *pk, unsigned char *sk)
+/* copy pk and sk into ed25519 key */
+int opensshkey_set_ed25519_keys (struct opensshkey *key, const unsigned char *pk, const unsigned char *sk)
 {
     if (key == NULL)
         return ERR_NULLPTR;
@@ -169,26 +151,456 @@ int opensshkey_set_ed25519_keys (struct opensshkey *key, unsigned char *pk, unsi
 
     /* set new public key */
     if (pk != NULL)
-        key->ed25519_pk = pk;
+        memcpy(key->ed25519_pk, pk, ED25519_PUBLICKEY_SIZE);
 
     /* set new privatekey */
     if (sk != NULL)
-        key->ed25519_sk = sk;
+        memcpy(key->ed25519_sk, sk, ED25519_SECRETKEY_SIZE);
     
     return SUCCESS;
 }
 
-/* return public and private part of elliptic curve keys */
-int opensshkey_save_to_tinyssh (const struct opensshkey *key, const unsigned char *dir)
+/* copy pk and sk into nistp256 key */
+int opensshkey_set_nistp256_keys (struct opensshkey *key, const unsigned char *pk, const unsigned char *sk)
 {
     if (key == NULL)
         return ERR_NULLPTR;
 
+    /* key must be ecdsa key on the nistp256 curve */
+    if ( !(key->type == KEY_ECDSA || key->type == KEY_ECDSA_CERT) || key->ecdsa_nid != NID_X9_62_prime256v1 )
+        return OPENSSH_KEY_INCOMPATIBLE;
+
+    if (pk != NULL)
+        memcpy(key->nistp256_pk, pk, NISTP256_PUBLICKEY_SIZE);
+    if (sk != NULL)
+        memcpy(key->nistp256_sk, sk, NISTP256_SECRETKEY_SIZE);
+
+    return SUCCESS;
+}
+
+/* the material read by the parse operation of ed25519 keys */
+int opensshkey_ed25519_set (struct opensshkey *key, const struct keytype_material *material)
+{
+    if (material->pklen != ED25519_PUBLICKEY_SIZE || material->sklen != ED25519_SECRETKEY_SIZE)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    return opensshkey_set_ed25519_keys(key, material->pk, material->sk);
+}
+
+/* the parse operation of nistp256 keys leaves the scalar without leading zeros,
+   it is padded to its full size and followed by the public key */
+static int opensshkey_nistp256_secret (const struct keytype_material *material, unsigned char *sk)
+{
+    if (material->pklen != NISTP256_PUBLICKEY_SIZE || material->sklen > NISTP256_SCALAR_SIZE)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+
+    memset(sk, 0, NISTP256_SCALAR_SIZE - material->sklen);
+    memcpy(sk + NISTP256_SCALAR_SIZE - material->sklen, material->sk, material->sklen);
+    memcpy(sk + NISTP256_SCALAR_SIZE, material->pk, NISTP256_PUBLICKEY_SIZE);
+    return SUCCESS;
+}
+
+int opensshkey_nistp256_set (struct opensshkey *key, const struct keytype_material *material)
+{
+    unsigned char sk[NISTP256_SECRETKEY_SIZE];
+    int e;
+
+    if ((e = opensshkey_nistp256_secret(material, sk)) == SUCCESS)
+        e = opensshkey_set_nistp256_keys(key, material->pk, sk);
+    memzero(sk, sizeof sk);
+
+    return e;
+}
+
+/* lock the secret keys of a batch, like the kdf cache, and leave them out of core
+   dumps. each array on its own, so that a low limit still covers the first */
+static int opensshkey_batch_lock (void *sk, size_t len)
+{
+    if (mlock(sk, len) != 0)
+        return 0;
+#ifdef MADV_DONTDUMP
+    madvise(sk, len, MADV_DONTDUMP);
+#endif
+    return 1;
+}
+
+void opensshkey_batch_init (struct opensshkey_batch *batch)
+{
+    batch->locked = opensshkey_batch_lock(batch->ed25519_sk, sizeof batch->ed25519_sk) |
+                    opensshkey_batch_lock(batch->nistp256_sk, sizeof batch->nistp256_sk) << 1;
+    for (size_t i = 0; i < OPENSSHKEY_BATCH_MAX; i++) {
+        batch->type[i] = KEY_UNSPECIFIED;
+        batch->ecdsa_nid[i] = NID_NONE;
+    }
+}
+
+void opensshkey_batch_wipe (struct opensshkey_batch *batch)
+{
+    memzero(batch->ed25519_sk, sizeof batch->ed25519_sk);
+    memzero(batch->nistp256_sk, sizeof batch->nistp256_sk);
+    memzero(batch->ed25519_pk, sizeof batch->ed25519_pk);
+    memzero(batch->nistp256_pk, sizeof batch->nistp256_pk);
+    for (size_t i = 0; i < OPENSSHKEY_BATCH_MAX; i++) {
+        batch->type[i] = KEY_UNSPECIFIED;
+        batch->ecdsa_nid[i] = NID_NONE;
+    }
+    if (batch->locked & 1)
+        munlock(batch->ed25519_sk, sizeof batch->ed25519_sk);
+    if (batch->locked & 2)
+        munlock(batch->nistp256_sk, sizeof batch->nistp256_sk);
+    batch->locked = 0;
+}
+
+/* copy pk and sk into slot i, which becomes an ed25519 key */
+int opensshkey_batch_set_ed25519_keys (struct opensshkey_batch *batch, size_t i,
+                                       const unsigned char *pk, const unsigned char *sk)
+{
+    if (batch == NULL || pk == NULL || sk == NULL)
+        return ERR_NULLPTR;
+    if (i >= OPENSSHKEY_BATCH_MAX)
+        return ERR_BAD_ARGUMENT;
+
+    memcpy(batch->ed25519_pk[i], pk, ED25519_PUBLICKEY_SIZE);
+    memcpy(batch->ed25519_sk[i], sk, ED25519_SECRETKEY_SIZE);
+    batch->type[i] = KEY_ED25519;
+    batch->ecdsa_nid[i] = NID_NONE;
+
+    return SUCCESS;
+}
+
+/* the set operations of both types for a slot of a batch */
+int opensshkey_ed25519_batch_set (struct opensshkey_batch *batch, size_t i, const struct keytype_material *material)
+{
+    if (material->pklen != ED25519_PUBLICKEY_SIZE || material->sklen != ED25519_SECRETKEY_SIZE)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    return opensshkey_batch_set_ed25519_keys(batch, i, material->pk, material->sk);
+}
+
+int opensshkey_nistp256_batch_set (struct opensshkey_batch *batch, size_t i, const struct keytype_material *material)
+{
+    int e;
+
+    if (batch == NULL)
+        return ERR_NULLPTR;
+    if (i >= OPENSSHKEY_BATCH_MAX)
+        return ERR_BAD_ARGUMENT;
+
+    /* the scalar is padded right in its slot */
+    if ((e = opensshkey_nistp256_secret(material, batch->nistp256_sk[i])) != SUCCESS)
+        return e;
+    memcpy(batch->nistp256_pk[i], material->pk, NISTP256_PUBLICKEY_SIZE);
+    batch->type[i] = KEY_ECDSA;
+    batch->ecdsa_nid[i] = NID_X9_62_prime256v1;
+
+    return SUCCESS;
+}
+
+/* copy comment into key, cut to the maximum length, which is remembered */
+int opensshkey_set_comment (struct opensshkey *key, const unsigned char *comment, size_t len)
+{
+    if (key == NULL || (comment == NULL && len > 0))
+        return ERR_NULLPTR;
+
+    key->commentcut = len > OPENSSHKEY_COMMENT_MAXLEN;
+    if (len > OPENSSHKEY_COMMENT_MAXLEN)
+        len = OPENSSHKEY_COMMENT_MAXLEN;
+    if (len > 0)
+        memcpy(key->comment, comment, len);
+    key->commentlen = len;
+
+    return SUCCESS;
+}
+
+const unsigned char *opensshkey_get_comment (const struct opensshkey *key, size_t *len)
+{
+    if (key == NULL)
+        return NULL;
+
+    if (len != NULL)
+        *len = key->commentlen;
+    return key->comment;
+}
+
+/* whether the comment is whole, for output which shows it */
+int opensshkey_check_comment (const struct opensshkey *key)
+{
+    if (key == NULL)
+        return ERR_NULLPTR;
+    return key->commentcut ? OPENSSH_KEY_COMMENT_TOO_LONG : SUCCESS;
+}
+
+/* characters of known_hosts patterns: names, addresses, [host]:port, the
+   wildcards, negation and hashed |1|salt|hash entries */
+static int opensshkey_hostchar (int c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+        (c != '\0' && strchr("-._:[]*?!|+/=%", c) != NULL);
+}
+
+/* whether hosts is a comma-separated list of such patterns, none of them empty */
+int opensshkey_check_hosts (const char *hosts)
+{
+    size_t patternlen = 0;
+
+    if (hosts == NULL)
+        return ERR_NULLPTR;
+
+    for (;; hosts++) {
+        if (*hosts == ',' || *hosts == '\0') {
+            if (patternlen == 0)
+                return OPENSSH_KEY_INVALID_HOSTS;
+            if (*hosts == '\0')
+                return SUCCESS;
+            patternlen = 0;
+        }
+        else if (!opensshkey_hostchar((unsigned char)*hosts))
+            return OPENSSH_KEY_INVALID_HOSTS;
+        else
+            patternlen++;
+    }
+}
+
+/* hosts from the host part of a user@host comment, or all of a comment without
+   an '@'. they are checked, so that a comment like "backup key" gives no line */
+int opensshkey_comment_hosts (const struct opensshkey *key, char *hosts, size_t size)
+{
+    int e = FAILURE;
+    size_t at;
+
+    if (key == NULL || hosts == NULL)
+        return ERR_NULLPTR;
+    if ((e = opensshkey_check_comment(key)) != SUCCESS)
+        return e;
+
+    for (at = key->commentlen; at > 0 && key->comment[at - 1] != '@'; at--)
+        ;
+    if (key->commentlen - at >= size)
+        return OPENSSH_KEY_INVALID_HOSTS;
+    memcpy(hosts, key->comment + at, key->commentlen - at);
+    hosts[key->commentlen - at] = '\0';
+
+    return opensshkey_check_hosts(hosts);
+}
+
+/* serialize public key as string keytype + string key */
+int opensshkey_get_public_blob (const struct opensshkey *key, unsigned char *blob, size_t bloblen, size_t *len)
+{
+    const struct keytype *kt;
+
+    if (key == NULL || blob == NULL)
+        return ERR_NULLPTR;
+    if ((kt = keytype_of(key->type, key->ecdsa_nid)) == NULL || kt->ops->public_blob == NULL)
+        return OPENSSH_KEY_UNKNOWN_KEYTYPE;
+
+    return kt->ops->public_blob(key, blob, bloblen, len);
+}
+
+/* certificates are written as their plain key */
+int opensshkey_ed25519_public_blob (const struct opensshkey *key, unsigned char *blob, size_t bloblen, size_t *len)
+{
+    if (bloblen < ED25519_PUBLIC_BLOB_SIZE)
+        return BUFFER_LENGTH_OVER_MAXIMUM;
+
+    /* uint32 lengths in network byte order */
+    const size_t namelen = sizeof ED25519_PUBLIC_BLOB_NAME - 1;
+    unsigned char *p = blob;
+    p[0] = 0; p[1] = 0; p[2] = 0; p[3] = namelen;
+    memcpy(p + 4, ED25519_PUBLIC_BLOB_NAME, namelen);
+    p += 4 + namelen;
+    p[0] = 0; p[1] = 0; p[2] = 0; p[3] = ED25519_PUBLICKEY_SIZE;
+    memcpy(p + 4, key->ed25519_pk, ED25519_PUBLICKEY_SIZE);
+
+    if (len != NULL)
+        *len = ED25519_PUBLIC_BLOB_SIZE;
+    return SUCCESS;
+}
+
+/* string keytype, string curve and the point, uncompressed */
+int opensshkey_nistp256_public_blob (const struct opensshkey *key, unsigned char *blob, size_t bloblen, size_t *len)
+{
+    if (bloblen < NISTP256_PUBLIC_BLOB_SIZE)
+        return BUFFER_LENGTH_OVER_MAXIMUM;
+
+    const size_t namelen = sizeof NISTP256_PUBLIC_BLOB_NAME - 1, curvelen = sizeof NISTP256_CURVE_NAME - 1;
+    unsigned char *p = blob;
+    encode_uint32(p, namelen);
+    memcpy(p + 4, NISTP256_PUBLIC_BLOB_NAME, namelen);
+    p += 4 + namelen;
+    encode_uint32(p, curvelen);
+    memcpy(p + 4, NISTP256_CURVE_NAME, curvelen);
+    p += 4 + curvelen;
+    encode_uint32(p, 1 + NISTP256_PUBLICKEY_SIZE);
+    p[4] = 0x04;
+    memcpy(p + 5, key->nistp256_pk, NISTP256_PUBLICKEY_SIZE);
+
+    if (len != NULL)
+        *len = NISTP256_PUBLIC_BLOB_SIZE;
+    return SUCCESS;
+}
+
+/* "SHA256:" and the digest in base64 without padding */
+int opensshkey_format_fingerprint (const unsigned char *digest, char *fp, size_t fplen)
+{
+    const size_t prefixlen = sizeof OPENSSHKEY_FINGERPRINT_PREFIX - 1;
+    int len;
+
+    if (digest == NULL || fp == NULL)
+        return ERR_NULLPTR;
+    if (fplen < OPENSSHKEY_FINGERPRINT_SIZE)
+        return BUFFER_LENGTH_OVER_MAXIMUM;
+
+    memcpy(fp, OPENSSHKEY_FINGERPRINT_PREFIX, prefixlen);
+    if ((len = b64_ntop(digest, SHA256_DIGEST_SIZE, fp + prefixlen, fplen - prefixlen)) < 0)
+        return BUFFER_INTERNAL_ERROR;
+    while (len > 0 && fp[prefixlen + len - 1] == '=')
+        fp[prefixlen + --len] = '\0';
+
+    return SUCCESS;
+}
+
+int opensshkey_fingerprint (const struct opensshkey *key, char *fp, size_t fplen)
+{
+    int e = FAILURE;
+    unsigned char blob[OPENSSHKEY_PUBLIC_BLOB_MAXLEN], digest[SHA256_DIGEST_SIZE];
+    size_t bloblen;
+
+    if ((e = opensshkey_get_public_blob(key, blob, sizeof blob, &bloblen)) != SUCCESS)
+        return e;
+
+    sha256(blob, bloblen, digest);
+    return opensshkey_format_fingerprint(digest, fp, fplen);
+}
+
+/* format "keytype base64" of a blob into line, which is not terminated */
+static int opensshkey_format_blob (const unsigned char *blob, size_t bloblen, char *line, size_t linelen, size_t *len)
+{
+    size_t namelen;
+
+    /* the keytype is the first string of the blob */
+    if (bloblen < 4 || (namelen = decode_uint32(blob)) > bloblen - 4)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+
+    /* keytype, space, encoded blob and the zero b64_ntop insists on */
+    if (linelen < namelen + 1 + b64_encoded_len(bloblen) + 1)
+        return BUFFER_LENGTH_OVER_MAXIMUM;
+
+    memcpy(line, blob + 4, namelen);
+    line[namelen] = ' ';
+    if (b64_ntop(blob, bloblen, line + namelen + 1, linelen - namelen - 1) < 0)
+        return BUFFER_INTERNAL_ERROR;
+
+    *len = namelen + 1 + b64_encoded_len(bloblen);
+    return SUCCESS;
+}
+
+static int opensshkey_format_public (const struct opensshkey *key, char *line, size_t linelen, size_t *len)
+{
+    int e = FAILURE;
+    unsigned char blob[OPENSSHKEY_PUBLIC_BLOB_MAXLEN];
+    size_t bloblen;
+
+    if ((e = opensshkey_get_public_blob(key, blob, sizeof blob, &bloblen)) != SUCCESS)
+        return e;
+    return opensshkey_format_blob(blob, bloblen, line, linelen, len);
+}
+
+/* keytype, space and the encoded blob of any supported key */
+#define OPENSSHKEY_PUBLIC_LINE_MAXLEN ( 64 + b64_encoded_len(OPENSSHKEY_PUBLIC_BLOB_MAXLEN) + 1 )
+
+/* "keytype base64 comment" */
+int opensshkey_write_authorized_keys (const struct opensshkey *key, FILE *out)
+{
+    if (key == NULL || out == NULL)
+        return ERR_NULLPTR;
+
+    int e = FAILURE;
+    char line[OPENSSHKEY_PUBLIC_LINE_MAXLEN];
+    size_t linelen;
+
+    if ((e = opensshkey_check_comment(key)) != SUCCESS ||
+        (e = opensshkey_format_public(key, line, sizeof line, &linelen)) != SUCCESS)
+            return e;
+
+    /* the comment is optional */
+    fwrite(line, 1, linelen, out);
+    if (key->commentlen > 0) {
+        putc(' ', out);
+        fwrite(key->comment, 1, key->commentlen, out);
+    }
+    putc('\n', out);
+
+    return ferror(out) ? FILEIO_IOERROR : SUCCESS;
+}
+
+/* "hosts keytype base64", where hosts is a comma-separated list of names */
+int opensshkey_write_known_hosts (const struct opensshkey *key, const char *hosts, FILE *out)
+{
+    if (key == NULL || out == NULL)
+        return ERR_NULLPTR;
+
     int e = FAILURE;
+    char line[OPENSSHKEY_PUBLIC_LINE_MAXLEN];
+    size_t linelen;
+
+    if ((e = opensshkey_check_hosts(hosts)) != SUCCESS ||
+        (e = opensshkey_format_public(key, line, sizeof line, &linelen)) != SUCCESS)
+            return e;
+
+    fputs(hosts, out);
+    putc(' ', out);
+    fwrite(line, 1, linelen, out);
+    putc('\n', out);
+
+    return ferror(out) ? FILEIO_IOERROR : SUCCESS;
+}
+
+/* a public blob from the header of a key file, of a supported type which is
+   not a certificate. its name and length are checked, the key is taken as is */
+const struct keytype *opensshkey_blob_keytype (const unsigned char *blob, size_t bloblen)
+{
+    const struct keytype *kt;
+    size_t namelen;
 
-    /* pointers to data to be written */
-    unsigned char *seckey = NULL, *pubkey = NULL;
-    size_t seckey_len = 0, pubkey_len = 0;
+    if (blob == NULL || bloblen < 4 || bloblen > OPENSSHKEY_PUBLIC_BLOB_MAXLEN ||
+        (namelen = decode_uint32(blob)) > bloblen - 4)
+            return NULL;
+    if ((kt = keytype_by_name(blob + 4, namelen)) == NULL || kt->iscert || kt->ops->public_blob == NULL)
+        return NULL;
+    return kt;
+}
+
+/* the same lines from such a blob, which has no comment */
+int opensshkey_write_blob_line (const unsigned char *blob, size_t bloblen, const char *hosts, FILE *out)
+{
+    if (blob == NULL || out == NULL)
+        return ERR_NULLPTR;
+
+    int e = FAILURE;
+    char line[OPENSSHKEY_PUBLIC_LINE_MAXLEN];
+    size_t linelen;
+
+    if (hosts != NULL && (e = opensshkey_check_hosts(hosts)) != SUCCESS)
+        return e;
+    if (opensshkey_blob_keytype(blob, bloblen) == NULL)
+        return OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE;
+    if ((e = opensshkey_format_blob(blob, bloblen, line, sizeof line, &linelen)) != SUCCESS)
+        return e;
+
+    if (hosts != NULL) {
+        fputs(hosts, out);
+        putc(' ', out);
+    }
+    fwrite(line, 1, linelen, out);
+    putc('\n', out);
+
+    return ferror(out) ? FILEIO_IOERROR : SUCCESS;
+}
+
+/* both files of a keydir from the key material */
+static int opensshkey_save_keydir (const unsigned char *pk, size_t pklen, const char *pkname,
+                                   const unsigned char *sk, size_t sklen, const char *skname,
+                                   const unsigned char *dir)
+{
+    int e = FAILURE;
 
     /* strings to construct the filenames in */
     unsigned char pubkey_file[1024 + 64] = "", seckey_file[1024 + 64] = "";
@@ -199,58 +611,245 @@ int opensshkey_save_to_tinyssh (const struct opensshkey *key, const unsigned cha
         strncat(pubkey_file, "/", 1);
         strncat(seckey_file, "/", 1);
     }
+    strncat(pubkey_file, pkname, 63);
+    strncat(seckey_file, skname, 63);
+
+    /* secret key, which holds the public key at its end */
+    printf("writing seckey to: %s ...\n", seckey_file);
+    if ((e = savesecret(seckey_file, (unsigned char *)sk, sklen)) != SUCCESS)
+        return e;
+    /* public key */
+    printf("writing pubkey to: %s ...\n", pubkey_file);
+    return savestring(pubkey_file, (unsigned char *)pk, pklen);
+}
 
-    /* decide by key type */
-    switch (key->type) {
+static int opensshkey_save_ed25519 (const unsigned char *pk, const unsigned char *sk, const unsigned char *dir)
+{
+    return opensshkey_save_keydir(pk, ED25519_PUBLICKEY_SIZE, ED25519_PUBLIC_TINYSSH_NAME,
+                                  sk, ED25519_SECRETKEY_SIZE, ED25519_SECRET_TINYSSH_NAME, dir);
+}
 
-        case KEY_ED25519:
-        case KEY_ED25519_CERT:
+/* return public and private part of elliptic curve keys */
+int opensshkey_save_to_tinyssh (const struct opensshkey *key, const unsigned char *dir)
+{
+    const struct keytype *kt;
 
-            /* we need a private key but could use
-               the embedded public key there. use public
-               key anyway, as it is easier pointer math */
-            if (key->ed25519_sk == NULL || key->ed25519_pk == NULL)
-                cleanreturn(ERR_NULLPTR);
-            
-            /* set pointers and lengths */
-            seckey = key->ed25519_sk;
-            seckey_len = ED25519_SECRETKEY_SIZE;
-            pubkey = key->ed25519_pk;
-            pubkey_len = ED25519_PUBLICKEY_SIZE;
-
-            /* construct the filenames */
-            strncat(pubkey_file, ED25519_PUBLIC_TINYSSH_NAME, sizeof ED25519_PUBLIC_TINYSSH_NAME);
-            strncat(seckey_file, ED25519_SECRET_TINYSSH_NAME, sizeof ED25519_SECRET_TINYSSH_NAME);
+    if (key == NULL)
+        return ERR_NULLPTR;
+    if ((kt = keytype_of(key->type, key->ecdsa_nid)) == NULL || kt->ops->save == NULL)
+        return OPENSSH_KEY_UNKNOWN_KEYTYPE;
 
-            break;
-        
-        case KEY_ECDSA:
-        case KEY_ECDSA_CERT:
-            /* not supported yet, requires ssl library */
-        
-        case KEY_UNKNOWN:
-        case KEY_UNSPECIFIED:
-        default:
+    return kt->ops->save(key, dir);
+}
+
+int opensshkey_ed25519_save (const struct opensshkey *key, const unsigned char *dir)
+{
+    return opensshkey_save_ed25519(key->ed25519_pk, key->ed25519_sk, dir);
+}
+
+int opensshkey_nistp256_save (const struct opensshkey *key, const unsigned char *dir)
+{
+    return opensshkey_save_keydir(key->nistp256_pk, NISTP256_PUBLICKEY_SIZE, NISTP256_PUBLIC_TINYSSH_NAME,
+                                  key->nistp256_sk, NISTP256_SECRETKEY_SIZE, NISTP256_SECRET_TINYSSH_NAME, dir);
+}
+
+/* a key of a batch, by the type of its slot */
+int opensshkey_batch_save_to_tinyssh (const struct opensshkey_batch *batch, size_t i, const unsigned char *dir)
+{
+    const struct keytype *kt;
+
+    if (batch == NULL || dir == NULL)
+        return ERR_NULLPTR;
+    if (i >= OPENSSHKEY_BATCH_MAX || (kt = keytype_of(batch->type[i], batch->ecdsa_nid[i])) == NULL ||
+        kt->ops->batch_save == NULL)
             return OPENSSH_KEY_UNKNOWN_KEYTYPE;
-    }
 
-    /* write keys */
-    if (seckey != NULL && pubkey != NULL) {
-        /* secret key */
-        printf("writing seckey to: %s ...\n", seckey_file);
-        if ((e = savestring(seckey_file, seckey, seckey_len)) != SUCCESS)
-            cleanreturn(e);
-        /* public key */
-        printf("writing pubkey to: %s ...\n", pubkey_file);
-        if ((e = savestring(pubkey_file, pubkey, pubkey_len)) != SUCCESS)
+    return kt->ops->batch_save(batch, i, dir);
+}
+
+int opensshkey_ed25519_batch_save (const struct opensshkey_batch *batch, size_t i, const unsigned char *dir)
+{
+    return opensshkey_save_ed25519(batch->ed25519_pk[i], batch->ed25519_sk[i], dir);
+}
+
+int opensshkey_nistp256_batch_save (const struct opensshkey_batch *batch, size_t i, const unsigned char *dir)
+{
+    return opensshkey_save_keydir(batch->nistp256_pk[i], NISTP256_PUBLICKEY_SIZE, NISTP256_PUBLIC_TINYSSH_NAME,
+                                  batch->nistp256_sk[i], NISTP256_SECRETKEY_SIZE, NISTP256_SECRET_TINYSSH_NAME, dir);
+}
+
+/* the public key file alone, quietly since it is written for many keydirs at once */
+int opensshkey_save_public_to_tinyssh (const unsigned char *pk, const unsigned char *dir)
+{
+    unsigned char pubkey_file[1024 + 64];
+    size_t dirlen = strlen((const char *)dir);
+
+    if (pk == NULL)
+        return ERR_NULLPTR;
+    if (dirlen > 1023)
+        dirlen = 1023;
+    snprintf((char *)pubkey_file, sizeof pubkey_file, "%.*s%s%s", (int)dirlen, dir,
+        dirlen > 0 && dir[dirlen - 1] == '/' ? "" : "/", ED25519_PUBLIC_TINYSSH_NAME);
+
+    return savestring((const char *)pubkey_file, (unsigned char *)pk, ED25519_PUBLICKEY_SIZE);
+}
+
+/* both files of a keydir, the secret key holds the public key as its second half */
+int opensshkey_load_from_tinyssh (struct opensshkey *key, const unsigned char *dir)
+{
+    int e = FAILURE;
+    unsigned char pubkey_file[1024 + 64], seckey_file[1024 + 64];
+    unsigned char seckey[ED25519_SECRETKEY_SIZE + 1], pubkey[ED25519_PUBLICKEY_SIZE + 1];
+    size_t dirlen = strlen((const char *)dir), seckey_len, pubkey_len;
+    const char *slash;
+
+    if (key == NULL)
+        return ERR_NULLPTR;
+    if (dirlen > 1023)
+        dirlen = 1023;
+    slash = dirlen > 0 && dir[dirlen - 1] == '/' ? "" : "/";
+    snprintf((char *)seckey_file, sizeof seckey_file, "%.*s%s%s", (int)dirlen, dir, slash, ED25519_SECRET_TINYSSH_NAME);
+    snprintf((char *)pubkey_file, sizeof pubkey_file, "%.*s%s%s", (int)dirlen, dir, slash, ED25519_PUBLIC_TINYSSH_NAME);
+
+    if ((e = loadstring((const char *)seckey_file, seckey, sizeof seckey, &seckey_len)) != SUCCESS ||
+        (e = loadstring((const char *)pubkey_file, pubkey, sizeof pubkey, &pubkey_len)) != SUCCESS)
             cleanreturn(e);
-    }
-    
-    /* housekeeping .. */
+
+    /* the public key must be the one of the secret key */
+    if (seckey_len != ED25519_SECRETKEY_SIZE || pubkey_len != ED25519_PUBLICKEY_SIZE ||
+        memcmp(seckey + ED25519_SECRETKEY_SIZE - ED25519_PUBLICKEY_SIZE, pubkey, ED25519_PUBLICKEY_SIZE) != 0)
+            cleanreturn(OPENSSH_PARSE_INVALID_FORMAT);
+
+    opensshkey_init(key, KEY_ED25519);
+    e = opensshkey_set_ed25519_keys(key, pubkey, seckey);
+
     cleanup:
-        seckey = NULL;
-        pubkey = NULL;
-    
+        memzero(seckey, sizeof seckey);
+
+    return e;
+}
+
+/* +--------------+ */
+/* | verification | */
+/* +--------------+ */
+
+/* derive the public key of n ed25519 seeds, the first halves of the secret keys,
+   and compare it to the stored public key and the second half of the secret key */
+static void opensshkey_verify_ed25519 (const unsigned char *const *sks, const unsigned char *const *pks,
+                                       size_t n, int *results)
+{
+    unsigned char derived[ED25519_BATCH][ED25519_PUBLIC_SIZE];
+    size_t m;
+
+    for (size_t done = 0; done < n; done += m) {
+        m = n - done < ED25519_BATCH ? n - done : ED25519_BATCH;
+        ed25519_public_batch(sks + done, m, derived);
+        for (size_t k = 0; k < m; k++)
+            results[done + k] = memcmp(derived[k], pks[done + k], ED25519_PUBLICKEY_SIZE) == 0 &&
+                memcmp(derived[k], sks[done + k] + ED25519_SECRETKEY_SIZE - ED25519_PUBLICKEY_SIZE,
+                       ED25519_PUBLICKEY_SIZE) == 0 ? SUCCESS : OPENSSH_KEY_INCONSISTENT;
+    }
+}
+
+/* nistp256 keys one at a time, the ladder has no batched form */
+static int opensshkey_verify_nistp256 (const unsigned char *sk, const unsigned char *pk)
+{
+    unsigned char derived[NISTP256_PUBLICKEY_SIZE];
+    int e = OPENSSH_KEY_INCONSISTENT;
+
+    if (p256_scalar_valid(sk)) {
+        p256_public(sk, derived);
+        if (memcmp(derived, pk, NISTP256_PUBLICKEY_SIZE) == 0 &&
+            memcmp(derived, sk + NISTP256_SCALAR_SIZE, NISTP256_PUBLICKEY_SIZE) == 0)
+                e = SUCCESS;
+    }
+    memzero(derived, sizeof derived);
+
+    return e;
+}
+
+int opensshkey_verify_batch (const struct opensshkey *const *keys, size_t n, int *results)
+{
+    const unsigned char *sks[ED25519_BATCH], *pks[ED25519_BATCH];
+    int verified[ED25519_BATCH];
+    size_t index[ED25519_BATCH], m, done = 0;
+    int first = SUCCESS;
+
+    if (keys == NULL || results == NULL)
+        return ERR_NULLPTR;
+
+    while (done < n) {
+
+        /* the next batch of ed25519 keys, nistp256 keys are checked on the way
+           and others cannot be checked */
+        for (m = 0; done < n && m < ED25519_BATCH; done++) {
+            if (keys[done] == NULL)
+                results[done] = ERR_NULLPTR;
+            else if ((keys[done]->type == KEY_ECDSA || keys[done]->type == KEY_ECDSA_CERT) &&
+                     keys[done]->ecdsa_nid == NID_X9_62_prime256v1)
+                results[done] = opensshkey_verify_nistp256(keys[done]->nistp256_sk, keys[done]->nistp256_pk);
+            else if (keys[done]->type != KEY_ED25519 && keys[done]->type != KEY_ED25519_CERT)
+                results[done] = OPENSSH_KEY_UNKNOWN_KEYTYPE;
+            else {
+                sks[m] = keys[done]->ed25519_sk;
+                pks[m] = keys[done]->ed25519_pk;
+                index[m++] = done;
+                continue;
+            }
+            if (first == SUCCESS)
+                first = results[done];
+        }
+
+        opensshkey_verify_ed25519(sks, pks, m, verified);
+        for (size_t k = 0; k < m; k++) {
+            results[index[k]] = verified[k];
+            if (first == SUCCESS)
+                first = verified[k];
+        }
+    }
+
+    return first;
+}
+
+/* the keys of a batch are in place already, they only need pointers. the
+   ed25519 keys among them are checked together, nistp256 keys on the way */
+int opensshkey_batch_verify (const struct opensshkey_batch *batch, size_t first, size_t n, int *results)
+{
+    const unsigned char *sks[ED25519_BATCH], *pks[ED25519_BATCH];
+    int verified[ED25519_BATCH];
+    size_t index[ED25519_BATCH], m, done = 0, i;
+    int e = SUCCESS;
+
+    if (batch == NULL || results == NULL)
+        return ERR_NULLPTR;
+    if (first > OPENSSHKEY_BATCH_MAX || n > OPENSSHKEY_BATCH_MAX - first)
+        return ERR_BAD_ARGUMENT;
+
+    while (done < n) {
+        for (m = 0; done < n && m < ED25519_BATCH; done++) {
+            i = first + done;
+            if (batch->type[i] == KEY_ED25519 || batch->type[i] == KEY_ED25519_CERT) {
+                sks[m] = batch->ed25519_sk[i];
+                pks[m] = batch->ed25519_pk[i];
+                index[m++] = done;
+                continue;
+            }
+            if (batch->type[i] == KEY_ECDSA && batch->ecdsa_nid[i] == NID_X9_62_prime256v1)
+                results[done] = opensshkey_verify_nistp256(batch->nistp256_sk[i], batch->nistp256_pk[i]);
+            else
+                results[done] = OPENSSH_KEY_UNKNOWN_KEYTYPE;
+            if (e == SUCCESS)
+                e = results[done];
+        }
+
+        opensshkey_verify_ed25519(sks, pks, m, verified);
+        for (size_t k = 0; k < m; k++) {
+            results[index[k]] = verified[k];
+            if (e == SUCCESS)
+                e = verified[k];
+        }
+    }
+
     return e;
 }
 
@@ -271,7 +870,13 @@ void opensshkey_dump (const struct opensshkey *key)
     switch (key->type) {
         case KEY_ECDSA:
         case KEY_ECDSA_CERT:
-            printf("Keytype is: ECDSA (unsupported)\n");
+            if (key->ecdsa_nid != NID_X9_62_prime256v1) {
+                printf("Keytype is: ECDSA (unsupported curve)\n");
+                break;
+            }
+            printf("Keytype is: ECDSA nistp256\n");
+            debugbuf("nistp256 public key", key->nistp256_pk, NISTP256_PUBLICKEY_SIZE);
+            debugbuf("nistp256 secret key", key->nistp256_sk, NISTP256_SECRETKEY_SIZE);
             break;
         case KEY_ED25519:
         case KEY_ED25519_CERT:
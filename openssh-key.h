@@ -19,9 +19,6 @@
 
 /****************************************************************************************/
 
-/* opaque sshkey struct */
-struct opensshkey;
-
 /* openssh key types */
 enum openssh_keytypes {
     KEY_ED25519,
@@ -38,6 +35,79 @@ enum openssh_keytypes {
 #define ED25519_SECRET_TINYSSH_NAME ".ed25519.sk"
 #define ED25519_PUBLIC_TINYSSH_NAME "ed25519.pk"
 
+/* ecdsa nistp256 key constants. the public key is X || Y, the secret key the
+   scalar followed by the public key, as ed25519 keeps its public key */
+#define NISTP256_SCALAR_SIZE    32U
+#define NISTP256_PUBLICKEY_SIZE 64U
+#define NISTP256_SECRETKEY_SIZE ( NISTP256_SCALAR_SIZE + NISTP256_PUBLICKEY_SIZE )
+#define NISTP256_SECRET_TINYSSH_NAME ".nistp256ecdsa.sk"
+#define NISTP256_PUBLIC_TINYSSH_NAME "nistp256ecdsa.pk"
+
+/* keys in use at once in the malloc-free profile */
+#define OPENSSHKEY_STATIC_SLOTS 1
+
+/* key comments are kept up to this length. longer ones are cut, which is fine for
+   converting the key, but lines which show the comment refuse such keys */
+#define OPENSSHKEY_COMMENT_MAXLEN 1024
+
+/* fingerprints as printed by ssh-keygen, the unpadded base64 sha256 of the public blob.
+   the size has room for the padding, which is encoded and then cut off */
+#define OPENSSHKEY_FINGERPRINT_PREFIX "SHA256:"
+#define OPENSSHKEY_FINGERPRINT_SIZE   ( sizeof(OPENSSHKEY_FINGERPRINT_PREFIX) - 1 + 44 + 1 )
+
+/* public key blob as in the ssh wire format, string keytype + string key */
+#define ED25519_PUBLIC_BLOB_NAME "ssh-ed25519"
+#define ED25519_PUBLIC_BLOB_SIZE ( 4 + sizeof(ED25519_PUBLIC_BLOB_NAME) - 1 + 4 + ED25519_PUBLICKEY_SIZE )
+
+/* string keytype + string curve + string point, uncompressed with its 0x04 prefix */
+#define NISTP256_PUBLIC_BLOB_NAME "ecdsa-sha2-nistp256"
+#define NISTP256_CURVE_NAME       "nistp256"
+#define NISTP256_PUBLIC_BLOB_SIZE ( 4 + sizeof(NISTP256_PUBLIC_BLOB_NAME) - 1 + \
+                                    4 + sizeof(NISTP256_CURVE_NAME) - 1 + 4 + 1 + NISTP256_PUBLICKEY_SIZE )
+
+/* room for the public blob of any supported key */
+#define OPENSSHKEY_PUBLIC_BLOB_MAXLEN NISTP256_PUBLIC_BLOB_SIZE
+
+/* key material starts on a cache line, secret key arrays of a batch on a page */
+#define OPENSSHKEY_ALIGN      64
+#define OPENSSHKEY_PAGE_ALIGN 4096
+
+/* keys in a batch, as many as a bundle may hold */
+#define OPENSSHKEY_BATCH_MAX  1024
+
+/* openssh key struct, complete so that keys can live in storage of the caller.
+   each secret key starts a cache line of its own and its public key follows */
+struct opensshkey {
+    /* ed25519 curve */
+	unsigned char ed25519_sk[ED25519_SECRETKEY_SIZE] __attribute__((aligned(OPENSSHKEY_ALIGN)));
+	unsigned char ed25519_pk[ED25519_PUBLICKEY_SIZE];
+    /* ecdsa nistp256 curve */
+	unsigned char nistp256_sk[NISTP256_SECRETKEY_SIZE] __attribute__((aligned(OPENSSHKEY_ALIGN)));
+	unsigned char nistp256_pk[NISTP256_PUBLICKEY_SIZE];
+    int	 type;
+	/* curve of ecdsa keys */
+	int	 ecdsa_nid;
+    /* comment, kept inline as well */
+    size_t commentlen;
+    unsigned char comment[OPENSSHKEY_COMMENT_MAXLEN];
+    int commentcut;
+};
+
+/* many keys as a structure of arrays, so that verification and output stream
+   over them: the public keys of a type are contiguous, the secret keys are locked
+   into memory where the system allows. a slot holds the key of its type in the
+   arrays of that type, comments are not kept */
+struct opensshkey_batch {
+    unsigned char ed25519_sk[OPENSSHKEY_BATCH_MAX][ED25519_SECRETKEY_SIZE] __attribute__((aligned(OPENSSHKEY_PAGE_ALIGN)));
+    unsigned char nistp256_sk[OPENSSHKEY_BATCH_MAX][NISTP256_SECRETKEY_SIZE] __attribute__((aligned(OPENSSHKEY_PAGE_ALIGN)));
+    unsigned char ed25519_pk[OPENSSHKEY_BATCH_MAX][ED25519_PUBLICKEY_SIZE] __attribute__((aligned(OPENSSHKEY_ALIGN)));
+    unsigned char nistp256_pk[OPENSSHKEY_BATCH_MAX][NISTP256_PUBLICKEY_SIZE] __attribute__((aligned(OPENSSHKEY_ALIGN)));
+    int type[OPENSSHKEY_BATCH_MAX];
+    int ecdsa_nid[OPENSSHKEY_BATCH_MAX];
+    /* bit 0 for the ed25519 secret keys, bit 1 for the nistp256 ones */
+    int locked;
+};
+
 /* statuscodes are in statuscodes.h */
 
 /****************************************************************************************/
@@ -46,16 +116,90 @@ enum openssh_keytypes {
 struct opensshkey * newopensshkey  (int type);
                void freeopensshkey (struct opensshkey *key);
 
+/* or use storage of the caller, which is wiped afterwards */
+void opensshkey_init (struct opensshkey *key, int type);
+void opensshkey_wipe (struct opensshkey *key);
+
 /* parsing or showing keytype */
                   int opensshkey_detect_type  (const unsigned char *keytype);
                   int opensshkey_get_type     (const struct opensshkey *key);
 const unsigned char * opensshkey_get_typename (const struct opensshkey *key);
+const unsigned char * opensshkey_get_shortname (const struct opensshkey *key);
+                  int opensshkey_get_bits     (const struct opensshkey *key);
 
 /* handle key material */
-int opensshkey_set_ed25519_keys (struct opensshkey *key, unsigned char *pk, unsigned char *sk);
+int opensshkey_set_ed25519_keys  (struct opensshkey *key, const unsigned char *pk, const unsigned char *sk);
+int opensshkey_set_nistp256_keys (struct opensshkey *key, const unsigned char *pk, const unsigned char *sk);
+
+/* a batch, usually in static storage as it is large. init locks the secret keys
+   and marks every slot empty, wipe clears and unlocks them again. the slots are
+   filled by openssh_deserialize_private_batch, by the type of each key */
+void opensshkey_batch_init (struct opensshkey_batch *batch);
+void opensshkey_batch_wipe (struct opensshkey_batch *batch);
+ int opensshkey_batch_set_ed25519_keys (struct opensshkey_batch *batch, size_t i,
+                                        const unsigned char *pk, const unsigned char *sk);
+
+/* handle key comment, which is not terminated */
+                int opensshkey_set_comment (struct opensshkey *key, const unsigned char *comment, size_t len);
+const unsigned char * opensshkey_get_comment (const struct opensshkey *key, size_t *len);
+                  int opensshkey_check_comment (const struct opensshkey *key);
+
+/* check a comma-separated list of known_hosts patterns, or derive one from the
+   comment of a key, into hosts of size bytes. both fail with OPENSSH_KEY_INVALID_HOSTS
+   for an empty list, an empty pattern or characters like whitespace */
+int opensshkey_check_hosts   (const char *hosts);
+int opensshkey_comment_hosts (const struct opensshkey *key, char *hosts, size_t size);
+
+/* serialize the public key blob to blob, which must hold bloblen bytes */
+int opensshkey_get_public_blob (const struct opensshkey *key, unsigned char *blob, size_t bloblen, size_t *len);
+
+/* fingerprint of a key, or of a public blob digest computed elsewhere */
+int opensshkey_fingerprint        (const struct opensshkey *key, char *fp, size_t fplen);
+int opensshkey_format_fingerprint (const unsigned char *digest, char *fp, size_t fplen);
+
+/* derive the public key of each ed25519 key from its secret seed, or of each
+   nistp256 key from its scalar, and compare it to both stored copies, in the key
+   and at the end of the secret key. results get a status per key, the first
+   failure is returned */
+int opensshkey_verify_batch (const struct opensshkey *const *keys, size_t n, int *results);
+
+/* the same for the keys first .. first + n - 1 of a batch, results[k] is for key first + k */
+int opensshkey_batch_verify (const struct opensshkey_batch *batch, size_t first, size_t n, int *results);
+
+/* export to file, or just the public half of an ed25519 key without the key around it.
+   ed25519 and nistp256 keys have files of their own, so both go to one keydir */
+int opensshkey_save_to_tinyssh        (const struct opensshkey *key, const unsigned char *dir);
+int opensshkey_save_public_to_tinyssh (const unsigned char *pk, const unsigned char *dir);
+int opensshkey_batch_save_to_tinyssh  (const struct opensshkey_batch *batch, size_t i, const unsigned char *dir);
+
+/* read an ed25519 key back from a tinyssh keydir, into a key of the caller */
+int opensshkey_load_from_tinyssh (struct opensshkey *key, const unsigned char *dir);
+
+/* append one line for authorized_keys or known_hosts to an output stream */
+int opensshkey_write_authorized_keys (const struct opensshkey *key, FILE *out);
+int opensshkey_write_known_hosts     (const struct opensshkey *key, const char *hosts, FILE *out);
+
+/* the keytype of a public blob from the header of a key file, NULL unless it is
+   a supported key. and a line of it for authorized_keys, or for known_hosts if
+   hosts is given. there is no comment without the private section */
+struct keytype;
+const struct keytype *opensshkey_blob_keytype (const unsigned char *blob, size_t bloblen);
+                  int opensshkey_write_blob_line (const unsigned char *blob, size_t bloblen, const char *hosts, FILE *out);
+
+/* operations of ed25519 keys, which keytypes.h dispatches to */
+struct keytype_material;
+int opensshkey_ed25519_set         (struct opensshkey *key, const struct keytype_material *material);
+int opensshkey_ed25519_public_blob (const struct opensshkey *key, unsigned char *blob, size_t bloblen, size_t *len);
+int opensshkey_ed25519_save        (const struct opensshkey *key, const unsigned char *dir);
+int opensshkey_ed25519_batch_set   (struct opensshkey_batch *batch, size_t i, const struct keytype_material *material);
+int opensshkey_ed25519_batch_save  (const struct opensshkey_batch *batch, size_t i, const unsigned char *dir);
 
-/* export to file */
-int opensshkey_save_to_tinyssh (const struct opensshkey *key, const unsigned char *dir);
+/* and of ecdsa nistp256 keys */
+int opensshkey_nistp256_set         (struct opensshkey *key, const struct keytype_material *material);
+int opensshkey_nistp256_public_blob (const struct opensshkey *key, unsigned char *blob, size_t bloblen, size_t *len);
+int opensshkey_nistp256_save        (const struct opensshkey *key, const unsigned char *dir);
+int opensshkey_nistp256_batch_set   (struct opensshkey_batch *batch, size_t i, const struct keytype_material *material);
+int opensshkey_nistp256_batch_save  (const struct opensshkey_batch *batch, size_t i, const unsigned char *dir);
 
 /* debugging */
 void opensshkey_dump (const struct opensshkey *key);
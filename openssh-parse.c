@@ -31,165 +31,646 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <ctype.h>
+
 #include "openssh-parse.h"
+#include "base64-simd.h"
+#include "p256.h"
 
-/* parse key from a openssh-key-v1 formatted filebuffer */
-int openssh_key_v1_parse (struct buffer *filebuf, struct opensshkey **keyptr)
+/* salt and rounds from the kdf options of bcrypt */
+static int openssh_kdf_options (const unsigned char *kdfoptions, size_t kdfoptlen,
+                                const unsigned char **salt, size_t *saltlen, unsigned int *rounds)
 {
-    int e = FAILURE;
-    struct buffer *encoded = NULL, *decoded = NULL, *privatekeyblob = NULL;
-    
-    /* allocate temporary buffers for decoding */
-    if ((encoded = newbuffer()) == NULL || (decoded = newbuffer()) == NULL)
-        cleanreturn(BUFFER_ALLOCATION_FAILED);
+    /*  bcrypt kdf options, nothing may follow
+
+            string  salt
+            uint32  rounds
+    */
+    if (kdfoptlen < 8 || (*saltlen = decode_uint32(kdfoptions)) != kdfoptlen - 8)
+        return OPENSSH_PARSE_INVALID_KDF_OPTIONS;
+    *salt = kdfoptions + 4;
+    *rounds = decode_uint32(kdfoptions + 4 + *saltlen);
+    return SUCCESS;
+}
+
+/* derive keylen bytes of key material with the salt and rounds in kdfoptions,
+   which may have been derived before and be cached */
+static int openssh_kdf_bcrypt (const unsigned char *kdfoptions, size_t kdfoptlen, const char *passphrase,
+                               unsigned char *key, size_t keylen)
+{
+    const unsigned char *salt;
+    size_t saltlen;
+    unsigned int rounds;
+    int e;
+
+    if ((e = openssh_kdf_options(kdfoptions, kdfoptlen, &salt, &saltlen, &rounds)) != SUCCESS)
+        return e;
+    if (kdf_cache_derive(passphrase, strlen(passphrase), salt, saltlen, key, keylen, rounds) != 0)
+        return OPENSSH_PARSE_INVALID_KDF_OPTIONS;
+
+    return SUCCESS;
+}
+
+/* +---------------+ */
+/* | memory spans  | */
+/* +---------------+ */
+
+/* read a string from a span of memory, which is advanced past it */
+static int openssh_span_string (const unsigned char **data, size_t *datalen, const unsigned char **str, size_t *len)
+{
+    size_t length;
+
+    if (*datalen < 4)
+        return *datalen == 0 ? BUFFER_END_OF_BUF : BUFFER_INCOMPLETE_MESSAGE;
+    if ((length = decode_uint32(*data)) > *datalen - 4)
+        return BUFFER_INCOMPLETE_MESSAGE;
+
+    *str = *data + 4;
+    *len = length;
+    *data += 4 + length;
+    *datalen -= 4 + length;
+    return SUCCESS;
+}
+
+/* read an uint32 from a span of memory, which is advanced past it */
+static int openssh_span_u32 (const unsigned char **data, size_t *datalen, unsigned long *value)
+{
+    if (*datalen < 4)
+        return BUFFER_OFFSET_TOO_LARGE;
 
-    /* check the existence of starting mark (aka. preamble) */
-    const unsigned char *rawptr = buffer_get_dataptr(filebuf);
-                  size_t rawlen = buffer_get_remaining(filebuf);
+    *value = decode_uint32(*data);
+    *data += 4;
+    *datalen -= 4;
+    return SUCCESS;
+}
+
+/* +-----------------------+ */
+/* | openssh-key-v1 files  | */
+/* +-----------------------+ */
+
+/* strip the markers of an openssh-key-v1 file and decode it in place */
+int openssh_key_v1_unarmor (unsigned char *text, size_t textlen, size_t *decodedlen)
+{
+    int e = FAILURE;
 
     /* length greater than MARKs and preamble matches */
-    if (rawlen < (OPENSSH_KEY_V1_MARK_BEGIN_LEN + OPENSSH_KEY_V1_MARK_END_LEN) ||
-        memcmp(rawptr, OPENSSH_KEY_V1_MARK_BEGIN, OPENSSH_KEY_V1_MARK_BEGIN_LEN) != 0)
+    if (textlen < (OPENSSH_KEY_V1_MARK_BEGIN_LEN + OPENSSH_KEY_V1_MARK_END_LEN) ||
+        memcmp(text, OPENSSH_KEY_V1_MARK_BEGIN, OPENSSH_KEY_V1_MARK_BEGIN_LEN) != 0)
             return OPENSSH_PARSE_INVALID_FORMAT;
 
-    /* increment pointer, decrement rem. length */
-    rawptr += OPENSSH_KEY_V1_MARK_BEGIN_LEN;
-    rawlen -= OPENSSH_KEY_V1_MARK_BEGIN_LEN;
-
-    /* collect encoded data in buffer, looking for end marker */
-    unsigned char lastchar;
-    while (rawlen > 0) {
-        /* skip whitespace, put into buffer otherwise */
-        if (*rawptr != '\n' && *rawptr != '\r')
-            if ((e = buffer_put_char(encoded, *rawptr)) != SUCCESS)
-                cleanreturn(e);
+    /* skip the preamble */
+    const unsigned char *rawptr = text + OPENSSH_KEY_V1_MARK_BEGIN_LEN;
+                  size_t rawlen = textlen - OPENSSH_KEY_V1_MARK_BEGIN_LEN;
 
-        lastchar = *rawptr;
-        rawlen--;
-        rawptr++;
+    /* decode line by line into the front of the same memory, looking for end marker.
+       the write position always trails the read position by at least the preamble */
+    unsigned char *putptr = text;
+    const unsigned char *eol;
+    struct b64_stream b64;
+    size_t linelen;
+    int decoded, ended = 0;
 
-        /* if newline, the next line might be the end marker */
-        if (lastchar == '\n') {
+    b64_stream_init(&b64);
+    e = SUCCESS;
+    while (rawlen > 0) {
 
-            if (rawlen >= OPENSSH_KEY_V1_MARK_END_LEN &&
-                memcmp(rawptr, OPENSSH_KEY_V1_MARK_END, OPENSSH_KEY_V1_MARK_END_LEN) == 0) {
-                    
-                    /* end marker matched, terminate with a nullchar */
-                    if ((e = buffer_put_char(encoded, '\0')) != SUCCESS)
-                        cleanreturn(e);
-                    break;
-                }
-        }
+        /* every line might be the end marker */
+        if (rawlen >= OPENSSH_KEY_V1_MARK_END_LEN &&
+            memcmp(rawptr, OPENSSH_KEY_V1_MARK_END, OPENSSH_KEY_V1_MARK_END_LEN) == 0) {
+                ended = 1;
+                break;
+            }
+
+        /* find the end of this line, the newline itself is skipped as whitespace */
+        eol = memchr(rawptr, '\n', rawlen);
+        linelen = eol != NULL ? (size_t)(eol - rawptr) + 1 : rawlen;
+
+        /* decode it, but keep looking for the end marker after an error */
+        if ((decoded = b64_stream_decode(&b64, (const char *)rawptr, linelen, putptr)) < 0)
+            e = BUFFER_INVALID_FORMAT;
+        else
+            putptr += decoded;
+
+        rawptr += linelen;
+        rawlen -= linelen;
     }
     /* we may have reached the end without an end marker */
-    if (rawlen == 0)
-        cleanreturn(OPENSSH_PARSE_INVALID_FORMAT);
+    if (!ended)
+        return OPENSSH_PARSE_INVALID_FORMAT;
 
-    /* base64 decode the buffer */
-    if ((e = buffer_put_decoded_base64(decoded, (char *)buffer_get_dataptr(encoded)) ) != SUCCESS)
-        cleanreturn(e);
+    /* the encoding must have been valid and complete */
+    if (e != SUCCESS || b64_stream_final(&b64) != 0)
+        return BUFFER_INVALID_FORMAT;
+
+    *decodedlen = putptr - text;
+    return SUCCESS;
+}
+
+/* unarmor the contents of a filebuffer, everything after the decoded data is dropped */
+static int openssh_key_v1_decode (struct buffer *filebuf, unsigned char **data, size_t *len)
+{
+    int e;
+
+    *data = buffer_get_offsetptr(filebuf);
+    if ((e = openssh_key_v1_unarmor(*data, buffer_get_remaining(filebuf), len)) != SUCCESS)
+        return e;
+    return buffer_set_datasize(filebuf, (*data + *len) - buffer_get_dataptr(filebuf));
+}
+
+/* the plaintext parts of a decoded file, pointing into it */
+struct openssh_key_v1_header {
+    const struct cipher *cipher;
+    const unsigned char *kdfoptions;
+    size_t kdfoptlen;
+    unsigned long nkeys;
+    const unsigned char *publickeys;    /* nkeys strings */
+    unsigned char *private;             /* still encrypted */
+    size_t privatelen;
+};
+
+/* read the header of a decoded file up to the private section, in order and
+   without copying. the private section must fill the rest of the file */
+static int openssh_key_v1_header (unsigned char *data, size_t len, struct openssh_key_v1_header *hdr)
+{
+    int e;
+    const unsigned char *cursor = data, *ciphername, *kdfname, *skipped;
+    size_t cipherlen, kdflen, skippedlen;
+    unsigned long privatelen;
 
     /* check magic bytes */
-    if (buffer_get_remaining(decoded) < OPENSSH_KEY_V1_MAGICBYTES_LEN ||
-        memcmp(buffer_get_dataptr(decoded), OPENSSH_KEY_V1_MAGICBYTES, OPENSSH_KEY_V1_MAGICBYTES_LEN) ||
-        buffer_add_offset(decoded, OPENSSH_KEY_V1_MAGICBYTES_LEN) != SUCCESS)
-            cleanreturn(OPENSSH_PARSE_INVALID_FORMAT);
-
-    /* 
-     *  begin parsing of the actual key format.
-     *  see header for details of format.
-     */
-
-    unsigned char *ciphername, *kdfname;
-    unsigned long nkeys, privatelen;
-    
-    if (/*   reading function     buffer   target        len   nullchar   expected status */
-        
+    if (len < OPENSSH_KEY_V1_MAGICBYTES_LEN ||
+        memcmp(cursor, OPENSSH_KEY_V1_MAGICBYTES, OPENSSH_KEY_V1_MAGICBYTES_LEN) != 0)
+            return OPENSSH_PARSE_INVALID_FORMAT;
+    cursor += OPENSSH_KEY_V1_MAGICBYTES_LEN;
+    len -= OPENSSH_KEY_V1_MAGICBYTES_LEN;
+
+    if (/*   reading function                         target           len              expected status */
+
         /* cipher name */
-        (e = buffer_read_string ( decoded, &ciphername,  NULL, '\0' )) != SUCCESS ||
+        (e = openssh_span_string ( &cursor, &len, &ciphername,     &cipherlen      )) != SUCCESS ||
         /* kdf name */
-        (e = buffer_read_string ( decoded, &kdfname,     NULL, '\0' )) != SUCCESS ||
-        /* skip kdf options */
-        (e = buffer_read_string ( decoded, NULL,         NULL, NULL )) != SUCCESS ||
+        (e = openssh_span_string ( &cursor, &len, &kdfname,        &kdflen         )) != SUCCESS ||
+        /* kdf options */
+        (e = openssh_span_string ( &cursor, &len, &hdr->kdfoptions, &hdr->kdfoptlen )) != SUCCESS ||
         /* number of keys */
-        (e = buffer_read_u32    ( decoded, &nkeys                   )) != SUCCESS ||
-        /* skip public key */
-        (e = buffer_read_string ( decoded, NULL,         NULL, NULL )) != SUCCESS ||
-        /* privatekey blob length */
-        (e = buffer_read_u32    ( decoded, &privatelen              )) != SUCCESS
-    
-    ) cleanreturn(e);
-
-    /* don't support encryption yet, cipher and kdf need to be 'none' */
-    if (strncmp(ciphername, "none", 4) != 0)
-        cleanreturn(OPENSSH_PARSE_UNSUPPORTED_CIPHER);
-    if (strncmp(kdfname, "none", 4) != 0)
-        cleanreturn(OPENSSH_PARSE_UNSUPPORTED_KDF);
-
-    /* need exactly one key */
-    if (nkeys != 1)
-        cleanreturn(OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS);
-
-    /* privatekey length must correspond to blocksize and remaining buffer */
-    if ( privatelen < OPENSSH_PARSE_NOCIPHER_BLOCKSIZE       ||
-        (privatelen % OPENSSH_PARSE_NOCIPHER_BLOCKSIZE) != 0 ||
-        buffer_get_remaining(decoded) != privatelen )
-            cleanreturn(OPENSSH_PARSE_INVALID_PRIVATE_FORMAT);
-    
-    /*
-     *  usually, decryption would need to be performed at this point.
-     *  since I assume most hostkeys will be unencrypted anyway this
-     *  is not supported here. openssh's decryption with no cipher
-     *  degrades to a simple memcpy into a new buffer.
-     */
-    if ((e = buffer_new_from_buffer(&privatekeyblob, decoded)) != SUCCESS)
-        cleanreturn(BUFFER_ALLOCATION_FAILED);
-
-    /* verify that both checkint fields hold the same value */
+        (e = openssh_span_u32    ( &cursor, &len, &hdr->nkeys                       )) != SUCCESS
+
+    ) return e;
+
+    /* an unencrypted key has neither cipher nor kdf, an encrypted one uses bcrypt */
+    if ((hdr->cipher = cipher_by_name(ciphername, cipherlen)) == NULL)
+        return OPENSSH_PARSE_UNSUPPORTED_CIPHER;
+    if (!memeqstr(kdfname, kdflen, hdr->cipher->keylen == 0 ? "none" : "bcrypt"))
+        return OPENSSH_PARSE_UNSUPPORTED_KDF;
+
+    /* at least one key, the public keys are only stepped over */
+    if (hdr->nkeys == 0)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    hdr->publickeys = cursor;
+    for (unsigned long i = 0; i < hdr->nkeys; i++)
+        if ((e = openssh_span_string(&cursor, &len, &skipped, &skippedlen)) != SUCCESS)
+            return e;
+
+    /* privatekey length must correspond to blocksize and remaining data */
+    if ((e = openssh_span_u32(&cursor, &len, &privatelen)) != SUCCESS)
+        return e;
+    if ( privatelen < hdr->cipher->blocksize       ||
+        (privatelen % hdr->cipher->blocksize) != 0 ||
+        len != privatelen )
+            return OPENSSH_PARSE_INVALID_PRIVATE_FORMAT;
+
+    hdr->private = data + (cursor - data);
+    hdr->privatelen = privatelen;
+    return SUCCESS;
+}
+
+/* decrypt the private section in place and verify its checkints, afterwards
+   the span points to the first private key */
+static int openssh_key_v1_unlock (const struct openssh_key_v1_header *hdr, const char *passphrase,
+                                  const unsigned char **data, size_t *len)
+{
+    int e = FAILURE;
+    unsigned char keyiv[CIPHER_MAXKEYLEN + CIPHER_MAXIVLEN];
+    const struct cipher *cipher = hdr->cipher;
+
+    /* derive key and iv from the passphrase and decrypt with them */
+    if (cipher->keylen > 0) {
+        if (passphrase == NULL || *passphrase == '\0')
+            cleanreturn(OPENSSH_PARSE_PASSPHRASE_REQUIRED);
+        if ((e = openssh_kdf_bcrypt(hdr->kdfoptions, hdr->kdfoptlen, passphrase,
+                keyiv, cipher->keylen + cipher->ivlen)) != SUCCESS)
+            cleanreturn(e);
+        if ((e = cipher_decrypt(cipher, keyiv, hdr->private, hdr->privatelen)) != SUCCESS)
+            cleanreturn(e);
+    }
+
+    /* verify that both checkint fields hold the same value, after
+       decryption they only do so with the right passphrase */
     unsigned long check1, check2;
-    if ((e = buffer_read_u32(privatekeyblob, &check1)) != SUCCESS ||
-        (e = buffer_read_u32(privatekeyblob, &check2)) != SUCCESS)
-            cleanreturn(e); 
+    *data = hdr->private;
+    *len = hdr->privatelen;
+    if ((e = openssh_span_u32(data, len, &check1)) != SUCCESS ||
+        (e = openssh_span_u32(data, len, &check2)) != SUCCESS)
+            cleanreturn(e);
     if (check1 != check2)
-        cleanreturn(OPENSSH_PARSE_INVALID_PRIVATE_FORMAT);
+        cleanreturn(cipher->keylen > 0 ? OPENSSH_PARSE_WRONG_PASSPHRASE : OPENSSH_PARSE_INVALID_PRIVATE_FORMAT);
+
+    e = SUCCESS;
+
+    cleanup:
+        memzero(keyiv, sizeof keyiv);
+
+    return e;
+}
+
+/* the private keys are followed by the bytes 1, 2, 3, ... up to the blocksize */
+static int openssh_key_v1_padding (const unsigned char *pad, size_t padlen)
+{
+    for (size_t i = 0; i < padlen; i++)
+        if (pad[i] != (unsigned char)(i + 1))
+            return OPENSSH_PARSE_INVALID_PRIVATE_FORMAT;
+    return SUCCESS;
+}
+
+/* decodes the text after the begin marker into its front on demand, so that
+   nothing is decoded beyond the bytes which are asked for */
+/* longer lines are decoded only as far as needed */
+#define OPENSSH_KEY_V1_LINE_MAX 76
+
+struct openssh_unarmor {
+    unsigned char *text;
+    const unsigned char *rawptr;
+    size_t rawlen, decoded;
+    struct b64_stream b64;
+    int linestart, ended;
+};
+
+/* decode whole quanta until at least want bytes are there or the text ends */
+static int openssh_unarmor_upto (struct openssh_unarmor *u, size_t want)
+{
+    const unsigned char *eol;
+    size_t chars, seen, i;
+    int decoded;
+
+    while (u->decoded < want && !u->ended && u->rawlen > 0) {
+
+        /* every line might be the end marker */
+        if (u->linestart) {
+            if (u->rawlen >= OPENSSH_KEY_V1_MARK_END_LEN &&
+                memcmp(u->rawptr, OPENSSH_KEY_V1_MARK_END, OPENSSH_KEY_V1_MARK_END_LEN) == 0) {
+                    u->ended = 1;
+                    break;
+                }
+            u->linestart = 0;
+        }
+
+        /* whole lines, a line of ssh-keygen holds 52 bytes so that decoding
+           overshoots by less than that, and only the last line is split */
+        chars = (want - u->decoded + 2) / 3 * 4;
+        eol = memchr(u->rawptr, '\n', u->rawlen);
+        i = eol != NULL ? (size_t)(eol - u->rawptr) : u->rawlen;
+        if (i > OPENSSH_KEY_V1_LINE_MAX)
+            for (i = 0, seen = 0; i < u->rawlen && seen < chars && u->rawptr[i] != '\n'; i++)
+                if (!isspace(u->rawptr[i]))
+                    seen++;
+        if (i < u->rawlen && u->rawptr[i] == '\n') {
+            i++;
+            u->linestart = 1;
+        }
 
-    /* deserialize key */
+        if ((decoded = b64_stream_decode(&u->b64, (const char *)u->rawptr, i, u->text + u->decoded)) < 0)
+            return BUFFER_INVALID_FORMAT;
+        u->decoded += decoded;
+        u->rawptr += i;
+        u->rawlen -= i;
+    }
+    return SUCCESS;
+}
+
+/* a string at offset parsed, decoding just as much as it needs */
+static int openssh_unarmor_string (struct openssh_unarmor *u, size_t *parsed, const unsigned char **str, size_t *len)
+{
+    const unsigned char *cursor;
+    size_t remaining;
+    int e;
+
+    if ((e = openssh_unarmor_upto(u, *parsed + 4)) != SUCCESS)
+        return e;
+    if (u->decoded >= *parsed + 4 &&
+        (e = openssh_unarmor_upto(u, *parsed + 4 + decode_uint32(u->text + *parsed))) != SUCCESS)
+            return e;
+
+    cursor = u->text + *parsed;
+    remaining = u->decoded - *parsed;
+    if ((e = openssh_span_string(&cursor, &remaining, str, len)) != SUCCESS)
+        return u->ended || u->rawlen > 0 ? e : OPENSSH_PARSE_INVALID_FORMAT;
+    *parsed = cursor - u->text;
+    return SUCCESS;
+}
+
+/* decode the front of a file up to its last public key */
+int openssh_key_v1_public (struct buffer *filebuf, struct openssh_key_v1_public *pub,
+                           struct openssh_key_entry *entries, size_t maxentries)
+{
+    int e;
+    struct openssh_unarmor u;
+    const unsigned char *kdfoptions, *salt;
+    size_t kdfoptlen, saltlen, nkeyslen, parsed = OPENSSH_KEY_V1_MAGICBYTES_LEN;
+    unsigned long nkeys;
+
+    memset(pub, 0, sizeof *pub);
+
+    /* length greater than MARKs and preamble matches */
+    u.text = buffer_get_offsetptr(filebuf);
+    u.rawlen = buffer_get_remaining(filebuf);
+    if (u.rawlen < (OPENSSH_KEY_V1_MARK_BEGIN_LEN + OPENSSH_KEY_V1_MARK_END_LEN) ||
+        memcmp(u.text, OPENSSH_KEY_V1_MARK_BEGIN, OPENSSH_KEY_V1_MARK_BEGIN_LEN) != 0)
+            return OPENSSH_PARSE_INVALID_FORMAT;
+    u.rawptr = u.text + OPENSSH_KEY_V1_MARK_BEGIN_LEN;
+    u.rawlen -= OPENSSH_KEY_V1_MARK_BEGIN_LEN;
+    u.decoded = 0;
+    u.linestart = 1;
+    u.ended = 0;
+    b64_stream_init(&u.b64);
+
+    /* check magic bytes */
+    if ((e = openssh_unarmor_upto(&u, OPENSSH_KEY_V1_MAGICBYTES_LEN)) != SUCCESS)
+        return e;
+    if (u.decoded < OPENSSH_KEY_V1_MAGICBYTES_LEN ||
+        memcmp(u.text, OPENSSH_KEY_V1_MAGICBYTES, OPENSSH_KEY_V1_MAGICBYTES_LEN) != 0)
+            return OPENSSH_PARSE_INVALID_FORMAT;
+
+    /* names are reported as they are, whether they are supported or not */
+    if ((e = openssh_unarmor_string(&u, &parsed, &pub->ciphername, &pub->cipherlen)) != SUCCESS ||
+        (e = openssh_unarmor_string(&u, &parsed, &pub->kdfname,    &pub->kdflen   )) != SUCCESS ||
+        (e = openssh_unarmor_string(&u, &parsed, &kdfoptions,      &kdfoptlen     )) != SUCCESS)
+            return e;
+    if (memeqstr(pub->kdfname, pub->kdflen, "bcrypt") &&
+        openssh_kdf_options(kdfoptions, kdfoptlen, &salt, &saltlen, &pub->rounds) != SUCCESS)
+            pub->rounds = 0;
+
+    /* number of keys, then the public keys */
+    if ((e = openssh_unarmor_upto(&u, parsed + 4)) != SUCCESS)
+        return e;
+    if ((nkeyslen = u.decoded - parsed) < 4)
+        return u.ended || u.rawlen > 0 ? BUFFER_OFFSET_TOO_LARGE : OPENSSH_PARSE_INVALID_FORMAT;
+    nkeys = decode_uint32(u.text + parsed);
+    parsed += 4;
+    if (nkeys == 0)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    if (nkeys > maxentries)
+        return OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS;
+    for (size_t i = 0; i < nkeys; i++) {
+        memset(&entries[i], 0, sizeof entries[i]);
+        if ((e = openssh_unarmor_string(&u, &parsed, &entries[i].publickey, &entries[i].publen)) != SUCCESS)
+            return e;
+    }
+
+    pub->nkeys = nkeys;
+    return SUCCESS;
+}
+
+/* decode, decrypt and index all keys of a openssh-key-v1 formatted filebuffer */
+int openssh_key_v1_index (struct buffer *filebuf, const char *passphrase,
+                          struct openssh_key_entry *entries, size_t maxentries, size_t *nentries)
+{
+    int e;
+    struct openssh_key_v1_header hdr;
+    unsigned char *data;
+    const unsigned char *cursor, *typeptr, *skipped;
+    const struct keytype *kt;
+    size_t len, typelen, skippedlen;
+
+    *nentries = 0;
+
+    /* decode and read the header */
+    if ((e = openssh_key_v1_decode(filebuf, &data, &len)) != SUCCESS ||
+        (e = openssh_key_v1_header(data, len, &hdr)) != SUCCESS)
+            return e;
+    if (hdr.nkeys > maxentries)
+        return OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS;
+
+    /* the public keys, which the header has checked already */
+    cursor = hdr.publickeys;
+    len = hdr.private - hdr.publickeys;
+    for (size_t i = 0; i < hdr.nkeys; i++)
+        openssh_span_string(&cursor, &len, &entries[i].publickey, &entries[i].publen);
+
+    /* the private keys and comments, which are only skipped over here */
+    if ((e = openssh_key_v1_unlock(&hdr, passphrase, &cursor, &len)) != SUCCESS)
+        return e;
+    for (size_t i = 0; i < hdr.nkeys; i++) {
+        entries[i].privatekey = cursor;
+        if ((e = openssh_span_string(&cursor, &len, &typeptr, &typelen)) != SUCCESS)
+            return e;
+        /* the registry knows how many strings each keytype has, so that keys
+           can be skipped without being understood */
+        if ((kt = keytype_by_name(typeptr, typelen)) == NULL || kt->fields == 0)
+            return OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE;
+        for (unsigned int f = 0; f < kt->fields; f++)
+            if ((e = openssh_span_string(&cursor, &len, &skipped, &skippedlen)) != SUCCESS)
+                return e;
+        entries[i].privlen = cursor - entries[i].privatekey;
+
+        if ((e = openssh_span_string(&cursor, &len, &entries[i].comment, &entries[i].commentlen)) != SUCCESS)
+            return e;
+    }
+    if ((e = openssh_key_v1_padding(cursor, len)) != SUCCESS)
+        return e;
+
+    *nentries = hdr.nkeys;
+    return SUCCESS;
+}
+
+/* the key and comment of an indexed entry */
+int openssh_key_v1_entry (const struct openssh_key_entry *entry, struct opensshkey **keyptr)
+{
+    int e = FAILURE;
     struct opensshkey *newkey = NULL;
-    if ((e = openssh_deserialize_private(privatekeyblob, &newkey)) != SUCCESS)
-        cleanreturn(e);
+    size_t used;
 
-    /* get comment for key */
-    unsigned char *comment;
-    if ((e = buffer_read_string(privatekeyblob, &comment, NULL, '\0')) != SUCCESS)
+    if ((e = openssh_deserialize_private_data(entry->privatekey, entry->privlen, &used, &newkey)) != SUCCESS)
+        cleanreturn(e);
+    if (used != entry->privlen)
+        cleanreturn(OPENSSH_PARSE_INVALID_FORMAT);
+    if ((e = opensshkey_set_comment(newkey, entry->comment, entry->commentlen)) != SUCCESS)
         cleanreturn(e);
-    printf("Successfully parsed %s key with comment: %s\n", opensshkey_get_typename(newkey), comment);
 
-    /* write pointer to parsed key */
-    if (keyptr != NULL) {
-        *keyptr = newkey;
-        newkey = NULL;
-    }
+    *keyptr = newkey;
+    newkey = NULL;
 
-    /* early exit or regular cleanup */
     cleanup:
-        freebuffer(encoded);
-        freebuffer(decoded);
-        freebuffer(privatekeyblob);
         freeopensshkey(newkey);
 
     return e;
+}
+
+/* the same into a key of the caller, which is wiped on failure */
+int openssh_key_v1_entry_into (const struct openssh_key_entry *entry, struct opensshkey *key)
+{
+    int e = FAILURE;
+    size_t used;
+
+    if ((e = openssh_deserialize_private_into(entry->privatekey, entry->privlen, &used, key)) != SUCCESS)
+        return e;
+    if (used != entry->privlen)
+        e = OPENSSH_PARSE_INVALID_FORMAT;
+    else
+        e = opensshkey_set_comment(key, entry->comment, entry->commentlen);
+
+    if (e != SUCCESS)
+        opensshkey_wipe(key);
+    return e;
+}
+
+/* the key material of an indexed entry into slot i of a batch, the comment is not kept */
+int openssh_key_v1_entry_batch (const struct openssh_key_entry *entry, struct opensshkey_batch *batch, size_t i)
+{
+    int e = FAILURE;
+    size_t used;
+
+    if ((e = openssh_deserialize_private_batch(entry->privatekey, entry->privlen, &used, batch, i)) != SUCCESS)
+        return e;
+    if (used != entry->privlen)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    return SUCCESS;
+}
+
+/* decrypt and deserialize all keys of decoded data in one pass, into keys of the caller */
+int openssh_key_v1_scan (unsigned char *data, size_t len, const char *passphrase,
+                         struct opensshkey *keys, size_t maxkeys, size_t *nkeys)
+{
+    int e;
+    struct openssh_key_v1_header hdr;
+    const unsigned char *cursor, *comment;
+    size_t commentlen, used, done = 0;
+
+    *nkeys = 0;
+
+    if ((e = openssh_key_v1_header(data, len, &hdr)) != SUCCESS)
+        return e;
+    if (hdr.nkeys > maxkeys)
+        return OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS;
+    if ((e = openssh_key_v1_unlock(&hdr, passphrase, &cursor, &len)) != SUCCESS)
+        return e;
+
+    /* every key with its comment, straight into the storage of the caller */
+    for (done = 0; done < hdr.nkeys; done++) {
+        if ((e = openssh_deserialize_private_into(cursor, len, &used, &keys[done])) != SUCCESS)
+            cleanreturn(e);
+        cursor += used;
+        len -= used;
+        if ((e = openssh_span_string(&cursor, &len, &comment, &commentlen)) != SUCCESS ||
+            (e = opensshkey_set_comment(&keys[done], comment, commentlen)) != SUCCESS) {
+                done++;
+                cleanreturn(e);
+            }
+    }
+    if ((e = openssh_key_v1_padding(cursor, len)) != SUCCESS)
+        cleanreturn(e);
 
+    *nkeys = hdr.nkeys;
+    return SUCCESS;
+
+    /* no half parsed files */
+    cleanup:
+        while (done > 0)
+            opensshkey_wipe(&keys[--done]);
+
+    return e;
 }
 
+/* parse the single key of a openssh-key-v1 formatted filebuffer, which is decoded in place */
+int openssh_key_v1_parse (struct buffer *filebuf, const char *passphrase, struct opensshkey **keyptr)
+{
+    struct opensshkey *newkey;
+    unsigned char *data;
+    size_t len, nkeys;
+    int e;
+
+    if ((e = openssh_key_v1_decode(filebuf, &data, &len)) != SUCCESS)
+        return e;
+    if ((newkey = newopensshkey(KEY_UNKNOWN)) == NULL)
+        return OPENSSH_KEY_ALLOCATION_FAILURE;
+    if ((e = openssh_key_v1_scan(data, len, passphrase, newkey, 1, &nkeys)) != SUCCESS) {
+        freeopensshkey(newkey);
+        return e;
+    }
+
+    /* write pointer to parsed key */
+    if (keyptr != NULL)
+        *keyptr = newkey;
+    else
+        freeopensshkey(newkey);
+    return SUCCESS;
+}
+
+/* the key derivation of an encrypted key, without deriving or decrypting anything */
+int openssh_key_v1_kdf_params (struct buffer *filebuf, struct openssh_kdf_params *params)
+{
+    int e;
+    struct openssh_key_v1_header hdr;
+    unsigned char *data;
+    size_t len;
+
+    memset(params, 0, sizeof *params);
+    if ((e = openssh_key_v1_decode(filebuf, &data, &len)) != SUCCESS ||
+        (e = openssh_key_v1_header(data, len, &hdr)) != SUCCESS)
+            return e;
+    if (hdr.cipher->keylen == 0)
+        return SUCCESS;
+
+    params->keylen = hdr.cipher->keylen + hdr.cipher->ivlen;
+    return openssh_kdf_options(hdr.kdfoptions, hdr.kdfoptlen, &params->salt, &params->saltlen, &params->rounds);
+}
+
+/* +-----------------------+ */
+/* | private key blobs     | */
+/* +-----------------------+ */
+
 /* deserialize key from buffer */
 int openssh_deserialize_private (struct buffer *buf, struct opensshkey **keyptr)
 {
-    int e = FAILURE;
+    size_t used;
+    int e;
+
+    if ((e = openssh_deserialize_private_data(buffer_get_offsetptr(buf), buffer_get_remaining(buf),
+            &used, keyptr)) != SUCCESS)
+        return e;
+    return buffer_add_offset(buf, used);
+}
+
+/* deserialize key from memory into a new key */
+int openssh_deserialize_private_data (const unsigned char *data, size_t datalen, size_t *used, struct opensshkey **keyptr)
+{
     struct opensshkey *newkey;
-    
+    int e;
+
     if (keyptr != NULL)
         *keyptr = NULL;
 
+    if ((newkey = newopensshkey(KEY_UNKNOWN)) == NULL)
+        return OPENSSH_KEY_ALLOCATION_FAILURE;
+    if ((e = openssh_deserialize_private_into(data, datalen, used, newkey)) != SUCCESS) {
+        freeopensshkey(newkey);
+        return e;
+    }
+
+    /* write pointer to deserialized key */
+    if (keyptr != NULL)
+        *keyptr = newkey;
+    else
+        freeopensshkey(newkey);
+    return SUCCESS;
+}
+
+/* the keytype and key material of a private key blob, which point into data */
+static int openssh_deserialize_private_span (const unsigned char *data, size_t datalen, size_t *used,
+                                             const struct keytype **kt, struct keytype_material *material)
+{
+    int e = FAILURE;
+    const unsigned char *start = data;
+
     /*  'decrypted' privatekey format
 
         The list of privatekey/comment pairs is padded with the
@@ -212,69 +693,215 @@ int openssh_deserialize_private (struct buffer *buf, struct opensshkey **keyptr)
             char    padlen % 255
     */
 
-    /* detect key type */
-    int keytype;
-    unsigned char *keytypename = NULL; 
-    if ((e = buffer_read_string(buf, &keytypename, NULL, '\0')) != SUCCESS)
-        cleanreturn(e);
-    if ((keytype = opensshkey_detect_type (keytypename)) == KEY_UNKNOWN)
-        cleanreturn(OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE);
-    
-    /* temporary key properties */
-    unsigned char *ed25519_pk = NULL, *ed25519_sk = NULL;
-    size_t pk_len = 0, sk_len = 0;
-
-    /* decide on action */
-    switch (keytype) {
-
-        /* ed25519 keys */
-        case KEY_ED25519:
-        case KEY_ED25519_CERT:
-
-            /* allocate new key */
-            if ((newkey = newopensshkey(keytype)) == NULL)
-                cleanreturn(OPENSSH_KEY_ALLOCATION_FAILURE);
-
-            /* get public and private key from buffer */
-            if ((e = buffer_read_string(buf, &ed25519_pk, &pk_len, NULL)) != SUCCESS ||
-                (e = buffer_read_string(buf, &ed25519_sk, &sk_len, NULL)) != SUCCESS)
-                    cleanreturn(e);
-
-            /* check read key lengths */
-            if (pk_len != ED25519_PUBLICKEY_SIZE || sk_len != ED25519_SECRETKEY_SIZE)
-                cleanreturn(OPENSSH_PARSE_INVALID_FORMAT);
-            
-            /* write correct pointers */
-            opensshkey_set_ed25519_keys(newkey, ed25519_pk, ed25519_sk);
-            ed25519_pk = ed25519_sk = NULL;
-            
-            break;
-
-        /* ecdsa keys currently not supported */
-        case KEY_ECDSA:
-        case KEY_ECDSA_CERT:
-
-        /* rsa, dsa, or otherwise unknown type */
-        case KEY_UNKNOWN:
-        default:
-            cleanreturn(OPENSSH_PARSE_INTERNAL_ERROR);
-    }
+    /* detect key type, keys without operations are not supported */
+    const unsigned char *typeptr;
+    size_t typelen;
+    if ((e = openssh_span_string(&data, &datalen, &typeptr, &typelen)) != SUCCESS)
+        return e;
+    if ((*kt = keytype_by_name(typeptr, typelen)) == NULL || (*kt)->ops->parse == NULL)
+        return OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE;
 
-    /* write pointer to deserialized key */
-    if (keyptr != NULL) {
-        *keyptr = newkey;
-        newkey = NULL;
-    }
+    if ((e = (*kt)->ops->parse(*kt, &data, &datalen, material)) != SUCCESS)
+        return e;
 
-    /* success */
-    e = SUCCESS;
+    *used = data - start;
+    return SUCCESS;
+}
 
-    /* housekeeping .. */
-    cleanup:
-        free(keytypename);
-        freeopensshkey(newkey);
-        nullpointer(ed25519_pk, pk_len);
-        nullpointer(ed25519_sk, sk_len);
+/* public and secret key of ed25519 keys, after the certificate of a certificate */
+int openssh_parse_ed25519 (const struct keytype *kt, const unsigned char **data, size_t *datalen,
+                           struct keytype_material *material)
+{
+    int e = FAILURE;
+    const unsigned char *cert;
+    size_t certlen;
+
+    if (kt->iscert && (e = openssh_span_string(data, datalen, &cert, &certlen)) != SUCCESS)
+        return e;
+    if ((e = openssh_span_string(data, datalen, &material->pk, &material->pklen)) != SUCCESS ||
+        (e = openssh_span_string(data, datalen, &material->sk, &material->sklen)) != SUCCESS)
+            return e;
+
+    /* check read key lengths */
+    if (material->pklen != ED25519_PUBLICKEY_SIZE || material->sklen != ED25519_SECRETKEY_SIZE)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    return SUCCESS;
+}
 
+/* string curve, string point and mpint scalar. the point must be uncompressed
+   and on the curve, the scalar below the order of the curve, leading zeros are
+   dropped from it and it is padded again when the material is copied */
+int openssh_parse_nistp256 (const struct keytype *kt, const unsigned char **data, size_t *datalen,
+                            struct keytype_material *material)
+{
+    int e = FAILURE;
+    const unsigned char *curve, *point, *d;
+    size_t curvelen, pointlen, dlen;
+    unsigned char scalar[NISTP256_SCALAR_SIZE];
+
+    (void)kt;
+    if ((e = openssh_span_string(data, datalen, &curve, &curvelen)) != SUCCESS ||
+        (e = openssh_span_string(data, datalen, &point, &pointlen)) != SUCCESS ||
+        (e = openssh_span_string(data, datalen, &d, &dlen)) != SUCCESS)
+            return e;
+
+    if (curvelen != sizeof NISTP256_CURVE_NAME - 1 || memcmp(curve, NISTP256_CURVE_NAME, curvelen) != 0 ||
+        pointlen != 1 + NISTP256_PUBLICKEY_SIZE || point[0] != 0x04)
+            return OPENSSH_PARSE_INVALID_FORMAT;
+
+    /* a positive mpint, which has a zero in front only if its high bit is set */
+    if (dlen > 0 && (d[0] & 0x80))
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    if (dlen > 1 && d[0] == 0 && !(d[1] & 0x80))
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    while (dlen > 0 && d[0] == 0) {
+        d++;
+        dlen--;
+    }
+    if (dlen > NISTP256_SCALAR_SIZE)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+
+    memset(scalar, 0, NISTP256_SCALAR_SIZE - dlen);
+    memcpy(scalar + NISTP256_SCALAR_SIZE - dlen, d, dlen);
+    e = p256_scalar_valid(scalar) && p256_point_valid(point + 1) ? SUCCESS : OPENSSH_PARSE_INVALID_FORMAT;
+    memzero(scalar, sizeof scalar);
+
+    material->pk = point + 1;
+    material->pklen = NISTP256_PUBLICKEY_SIZE;
+    material->sk = d;
+    material->sklen = dlen;
     return e;
-}
\ No newline at end of file
+}
+
+/* deserialize key from memory into storage of the caller, nothing is written
+   to data. as keys do not share anything, many of them can be deserialized at once */
+int openssh_deserialize_private_into (const unsigned char *data, size_t datalen, size_t *used, struct opensshkey *key)
+{
+    int e = FAILURE;
+    const struct keytype *kt;
+    struct keytype_material material;
+
+    opensshkey_init(key, KEY_UNKNOWN);
+    if ((e = openssh_deserialize_private_span(data, datalen, used, &kt, &material)) != SUCCESS)
+        return e;
+
+    /* copy key material */
+    opensshkey_init(key, kt->type);
+    key->ecdsa_nid = kt->nid;
+    return kt->ops->set(key, &material);
+}
+
+/* the same straight into slot i of a batch, without a key in between */
+int openssh_deserialize_private_batch (const unsigned char *data, size_t datalen, size_t *used,
+                                       struct opensshkey_batch *batch, size_t i)
+{
+    int e = FAILURE;
+    const struct keytype *kt;
+    struct keytype_material material;
+
+    if ((e = openssh_deserialize_private_span(data, datalen, used, &kt, &material)) != SUCCESS)
+        return e;
+    if (kt->ops->batch_set == NULL)
+        return OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE;
+    if ((e = kt->ops->batch_set(batch, i, &material)) != SUCCESS)
+        return e;
+    batch->type[i] = kt->type;
+    batch->ecdsa_nid[i] = kt->nid;
+    return SUCCESS;
+}
+
+/* +-----------------------+ */
+/* | public key lines      | */
+/* +-----------------------+ */
+
+/* the end of a field of a line, where whitespace outside of quotes ends it */
+static const char *openssh_line_field (const char *p, const char *eol)
+{
+    int quoted = 0;
+
+    for (; p < eol && (quoted || (*p != ' ' && *p != '\t')); p++)
+        if (*p == '"')
+            quoted = !quoted;
+    return p;
+}
+
+/* keytype names, which options in front of them never start with */
+static int openssh_line_is_keytype (const char *p, size_t len)
+{
+    return (len > 4 && memcmp(p, "ssh-", 4) == 0) ||
+           (len > 6 && memcmp(p, "ecdsa-", 6) == 0) ||
+           (len > 3 && memcmp(p, "sk-", 3) == 0);
+}
+
+/* the ed25519 public key of a base64 blob, which has exactly this length */
+#define OPENSSH_LINE_ED25519_B64LEN b64_encoded_len(ED25519_PUBLIC_BLOB_SIZE)
+
+static int openssh_line_ed25519 (const char *b64, size_t len, unsigned char *pk)
+{
+    char text[OPENSSH_LINE_ED25519_B64LEN + 1];
+    unsigned char blob[ED25519_PUBLIC_BLOB_SIZE];
+    const unsigned char *cursor = blob, *name, *key;
+    size_t remaining = sizeof blob, namelen, keylen;
+
+    if (len != OPENSSH_LINE_ED25519_B64LEN)
+        return OPENSSH_PARSE_INVALID_FORMAT;
+    memcpy(text, b64, len);
+    text[len] = '\0';
+    if (b64_pton(text, blob, sizeof blob) != (int)sizeof blob)
+        return BUFFER_INVALID_FORMAT;
+
+    if (openssh_span_string(&cursor, &remaining, &name, &namelen) != SUCCESS ||
+        openssh_span_string(&cursor, &remaining, &key, &keylen) != SUCCESS ||
+        !memeqstr(name, namelen, ED25519_PUBLIC_BLOB_NAME) || keylen != ED25519_PUBLICKEY_SIZE)
+            return OPENSSH_PARSE_INVALID_FORMAT;
+    memcpy(pk, key, ED25519_PUBLICKEY_SIZE);
+    return SUCCESS;
+}
+
+/* walk the lines once, each is: [options] keytype base64 [comment] */
+int openssh_public_lines_ed25519 (const char *text, size_t len, unsigned char (*pks)[ED25519_PUBLICKEY_SIZE],
+                                  size_t maxkeys, size_t *nkeys, size_t *lineno)
+{
+    const char *end = text + len, *eol, *p, *field;
+    int e;
+
+    *nkeys = 0;
+    *lineno = 0;
+
+    for (; text < end; text = eol < end ? eol + 1 : end) {
+        (*lineno)++;
+        if ((eol = memchr(text, '\n', end - text)) == NULL)
+            eol = end;
+
+        /* skip blanks, empty lines and comments */
+        for (p = text; p < eol && (*p == ' ' || *p == '\t'); p++);
+        if (p == eol || *p == '#' || *p == '\r')
+            continue;
+
+        /* options of authorized_keys come first, they may quote whitespace */
+        field = openssh_line_field(p, eol);
+        if (!openssh_line_is_keytype(p, field - p)) {
+            for (p = field; p < eol && (*p == ' ' || *p == '\t'); p++);
+            field = openssh_line_field(p, eol);
+            if (!openssh_line_is_keytype(p, field - p))
+                return OPENSSH_PARSE_INVALID_FORMAT;
+        }
+
+        /* other keytypes have no tinyssh key */
+        if (!memeqstr((const unsigned char *)p, field - p, ED25519_PUBLIC_BLOB_NAME))
+            continue;
+
+        /* the base64 ends at whitespace or the end of a line with \r\n */
+        for (p = field; p < eol && (*p == ' ' || *p == '\t'); p++);
+        for (field = p; field < eol && *field != ' ' && *field != '\t' && *field != '\r'; field++);
+
+        if (*nkeys == maxkeys)
+            return OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS;
+        if ((e = openssh_line_ed25519(p, field - p, pks[*nkeys])) != SUCCESS)
+            return e;
+        (*nkeys)++;
+    }
+
+    *lineno = 0;
+    return SUCCESS;
+}
@@ -11,6 +11,9 @@
 
 #include "buffer.h"
 #include "openssh-key.h"
+#include "keytypes.h"
+#include "cipher.h"
+#include "kdf-cache.h"
 
 /****************************************************************************************/
 
@@ -24,15 +27,15 @@
 #define OPENSSH_KEY_V1_MAGICBYTES       "openssh-key-v1"
 #define OPENSSH_KEY_V1_MAGICBYTES_LEN   sizeof(OPENSSH_KEY_V1_MAGICBYTES)
 
-/* sizes for cipher = none */
-#define OPENSSH_PARSE_NOCIPHER_BLOCKSIZE  8
+/* most keys in one file, all of them fit into a batch */
+#define OPENSSH_PARSE_MAXKEYS           OPENSSHKEY_BATCH_MAX
 
 /* openssh-key-v1 base64 decoded format:
 
     byte[]  AUTH_MAGIC
     string  ciphername
     string  kdfname
-    string  kdfoptions
+    string  kdfoptions      (for bcrypt: string salt, uint32 rounds)
     int     number of keys N
     string  publickey1
     string  publickey2
@@ -46,14 +49,95 @@
         string of appropriate length
 */
 
+/* one key of a file, pointing into the decoded and decrypted filebuffer */
+struct openssh_key_entry {
+    const unsigned char *publickey;
+    size_t publen;
+    const unsigned char *privatekey;    /* serialized, with the type in front */
+    size_t privlen;
+    const unsigned char *comment;
+    size_t commentlen;
+};
+
+/* the key derivation an encrypted key needs, salt points into the filebuffer */
+struct openssh_kdf_params {
+    const unsigned char *salt;
+    size_t saltlen;
+    unsigned int rounds;
+    size_t keylen;          /* key and iv of the cipher, 0 if not encrypted */
+};
+
+/* what a file tells without its private section, pointing into the filebuffer */
+struct openssh_key_v1_public {
+    const unsigned char *ciphername;
+    size_t cipherlen;
+    const unsigned char *kdfname;
+    size_t kdflen;
+    unsigned int rounds;    /* of bcrypt, 0 otherwise */
+    size_t nkeys;
+};
+
 /* statuscodes are in statuscodes.h */
 
 /****************************************************************************************/
 
-/* decode a filebuffer */
-int openssh_key_v1_parse (struct buffer *filebuf, struct opensshkey **keyptr);
+/* decode a filebuffer with a single key, this happens in place and consumes
+   its contents. passphrase is only needed for encrypted keys and may be NULL */
+int openssh_key_v1_parse (struct buffer *filebuf, const char *passphrase, struct opensshkey **keyptr);
+
+/* strip the markers of the text of a file and decode the base64 in place,
+   to the start of text. decodedlen is set to the bytes that were decoded */
+int openssh_key_v1_unarmor (unsigned char *text, size_t textlen, size_t *decodedlen);
+
+/* check, decrypt and deserialize decoded data with up to maxkeys keys in one
+   forward pass, into keys of the caller. nothing is allocated, and no key is
+   left behind on failure. the padding after the keys must be 1, 2, 3, ... */
+int openssh_key_v1_scan (unsigned char *data, size_t len, const char *passphrase,
+                         struct opensshkey *keys, size_t maxkeys, size_t *nkeys);
+
+/* decode and decrypt a filebuffer with up to maxentries keys in place, and
+   find the public key, private key and comment of each in one pass */
+int openssh_key_v1_index (struct buffer *filebuf, const char *passphrase,
+                          struct openssh_key_entry *entries, size_t maxentries, size_t *nentries);
+
+/* deserialize an indexed key, independently of all other entries, into a new
+   key, one of the caller or slot i of a batch */
+int openssh_key_v1_entry       (const struct openssh_key_entry *entry, struct opensshkey **keyptr);
+int openssh_key_v1_entry_into  (const struct openssh_key_entry *entry, struct opensshkey *key);
+int openssh_key_v1_entry_batch (const struct openssh_key_entry *entry, struct opensshkey_batch *batch, size_t i);
+
+/* decode a filebuffer in place only as far as the public keys reach, of
+   which the entries get the public key alone. the private section is never
+   decoded, and neither cipher nor kdf have to be supported */
+int openssh_key_v1_public (struct buffer *filebuf, struct openssh_key_v1_public *pub,
+                           struct openssh_key_entry *entries, size_t maxentries);
+
+/* read just the kdf parameters from a filebuffer, which is decoded in place
+   as well. so the keys of many files can be derived together beforehand */
+int openssh_key_v1_kdf_params (struct buffer *filebuf, struct openssh_kdf_params *params);
+
+/* the ed25519 public keys of the lines of a .pub or authorized_keys file, in
+   order, options in front of the keytype are skipped. empty lines, comments
+   and other keytypes are skipped too, a malformed line fails with its
+   number in lineno, counted from 1 */
+int openssh_public_lines_ed25519 (const char *text, size_t len, unsigned char (*pks)[ED25519_PUBLICKEY_SIZE],
+                                  size_t maxkeys, size_t *nkeys, size_t *lineno);
+
+/* deserialize a private key blob, from a buffer or from memory where used
+   is set to the bytes it took. the last ones write into a key of the caller
+   or into slot i of a batch */
+int openssh_deserialize_private       (struct buffer *buf, struct opensshkey **keyptr);
+int openssh_deserialize_private_data  (const unsigned char *data, size_t datalen, size_t *used, struct opensshkey **keyptr);
+int openssh_deserialize_private_into  (const unsigned char *data, size_t datalen, size_t *used, struct opensshkey *key);
+int openssh_deserialize_private_batch (const unsigned char *data, size_t datalen, size_t *used,
+                                       struct opensshkey_batch *batch, size_t i);
+
+/* the parse operation of ed25519 keys, which keytypes.h dispatches to */
+int openssh_parse_ed25519 (const struct keytype *kt, const unsigned char **data, size_t *datalen,
+                           struct keytype_material *material);
 
-/* deserialize a private key blob */
-int openssh_deserialize_private (struct buffer *buf, struct opensshkey **keyptr);
+/* and of ecdsa nistp256 keys */
+int openssh_parse_nistp256 (const struct keytype *kt, const unsigned char **data, size_t *datalen,
+                            struct keytype_material *material);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,115 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * The layout is the one openssh_key_v1_scan in openssh-parse.c reads,
+ * written the way sshkey_private_to_blob2 in OpenSSH writes it.
+ */
+
+#include <string.h>
+
+#include "openssh-serialize.h"
+
+/* string: uint32 length and the bytes */
+static unsigned char *openssh_serialize_string (unsigned char *p, const void *str, size_t len)
+{
+    encode_uint32(p, len);
+    memcpy(p + 4, str, len);
+    return p + 4 + len;
+}
+
+int openssh_key_v1_serialize (const struct opensshkey *key, unsigned long checkint,
+                              char *text, size_t textlen, size_t *len)
+{
+    int e = FAILURE;
+    unsigned char raw[OPENSSH_SERIALIZE_RAW_MAXLEN], blob[ED25519_PUBLIC_BLOB_SIZE];
+    unsigned char *p = raw, *private;
+    char encoded[b64_encoded_len(OPENSSH_SERIALIZE_RAW_MAXLEN) + 1];
+    const struct cipher *none = cipher_by_name((const unsigned char *)"none", 4);
+    const unsigned char *comment;
+    size_t bloblen, commentlen, w;
+    int encodedlen;
+
+    if (key == NULL || text == NULL || len == NULL)
+        return ERR_NULLPTR;
+    if (textlen < OPENSSH_SERIALIZE_TEXT_MAXLEN)
+        return BUFFER_LENGTH_OVER_MAXIMUM;
+    if (key->type != KEY_ED25519)
+        return OPENSSH_KEY_UNKNOWN_KEYTYPE;
+    if ((e = opensshkey_get_public_blob(key, blob, sizeof blob, &bloblen)) != SUCCESS)
+        return e;
+    comment = opensshkey_get_comment(key, &commentlen);
+
+    /* header, unencrypted and without kdf */
+    memcpy(p, OPENSSH_KEY_V1_MAGICBYTES, OPENSSH_KEY_V1_MAGICBYTES_LEN);
+    p = openssh_serialize_string(p + OPENSSH_KEY_V1_MAGICBYTES_LEN, "none", 4);
+    p = openssh_serialize_string(p, "none", 4);
+    p = openssh_serialize_string(p, "", 0);
+    encode_uint32(p, 1);
+    p = openssh_serialize_string(p + 4, blob, bloblen);
+
+    /* the private section, its length is filled in once it is padded */
+    private = p + 4;
+    encode_uint32(private, checkint);
+    encode_uint32(private + 4, checkint);
+    p = openssh_serialize_string(private + 8, ED25519_PUBLIC_BLOB_NAME, sizeof ED25519_PUBLIC_BLOB_NAME - 1);
+    p = openssh_serialize_string(p, key->ed25519_pk, ED25519_PUBLICKEY_SIZE);
+    p = openssh_serialize_string(p, key->ed25519_sk, ED25519_SECRETKEY_SIZE);
+    p = openssh_serialize_string(p, comment, commentlen);
+    for (unsigned char pad = 1; (p - private) % none->blocksize != 0; pad++)
+        *p++ = pad;
+    encode_uint32(private - 4, p - private);
+
+    /* armored, the base64 wrapped into lines */
+    if ((encodedlen = b64_ntop(raw, p - raw, encoded, sizeof encoded)) < 0)
+        cleanreturn(BUFFER_INTERNAL_ERROR);
+    memcpy(text, OPENSSH_KEY_V1_MARK_BEGIN, OPENSSH_KEY_V1_MARK_BEGIN_LEN);
+    w = OPENSSH_KEY_V1_MARK_BEGIN_LEN;
+    for (size_t i = 0; i < (size_t)encodedlen; i += OPENSSH_SERIALIZE_WRAP) {
+        size_t n = (size_t)encodedlen - i < OPENSSH_SERIALIZE_WRAP ? (size_t)encodedlen - i : OPENSSH_SERIALIZE_WRAP;
+        memcpy(text + w, encoded + i, n);
+        w += n;
+        text[w++] = '\n';
+    }
+    memcpy(text + w, OPENSSH_KEY_V1_MARK_END, OPENSSH_KEY_V1_MARK_END_LEN);
+    *len = w + OPENSSH_KEY_V1_MARK_END_LEN;
+    e = SUCCESS;
+
+    cleanup:
+        memzero(raw, sizeof raw);
+        memzero(encoded, sizeof encoded);
+
+    return e;
+}
+
+int openssh_key_v1_save (const struct opensshkey *key, const char *file)
+{
+    int e = FAILURE;
+    char text[OPENSSH_SERIALIZE_TEXT_MAXLEN], pubfile[1024 + 8];
+    unsigned char checkint[4];
+    size_t len;
+    FILE *pub = NULL;
+
+    if (key == NULL || file == NULL)
+        return ERR_NULLPTR;
+    if ((size_t)snprintf(pubfile, sizeof pubfile, "%s.pub", file) >= sizeof pubfile)
+        return ERR_BAD_ARGUMENT;
+
+    /* the checkints only tell a wrong passphrase, but ssh-keygen makes them random too */
+    if ((e = loadrandom(checkint, sizeof checkint)) != SUCCESS ||
+        (e = openssh_key_v1_serialize(key, decode_uint32(checkint), text, sizeof text, &len)) != SUCCESS ||
+        (e = savesecret(file, (unsigned char *)text, len)) != SUCCESS)
+            cleanreturn(e);
+
+    if ((pub = fopen(pubfile, "w")) == NULL)
+        cleanreturn(FILEIO_CANNOT_OPEN_WRITING);
+    e = opensshkey_write_authorized_keys(key, pub);
+    if (fclose(pub) != 0 && e == SUCCESS)
+        e = FILEIO_IOERROR;
+
+    cleanup:
+        memzero(text, sizeof text);
+
+    return e;
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_openssh_serialize_h_
+#define _headerguard_openssh_serialize_h_
+
+#include "buffer.h"
+#include "base64-simd.h"
+#include "openssh-key.h"
+#include "openssh-parse.h"
+
+/****************************************************************************************/
+
+/* base64 lines of a file are this long, as ssh-keygen wraps them */
+#define OPENSSH_SERIALIZE_WRAP          70
+
+/* decoded size of an unencrypted file with one ed25519 key and the longest comment:
+   magic, "none", "none", empty kdfoptions, nkeys, publickey, length of the private
+   section, two checkints, keytype, pk, sk, comment and at most a block of padding */
+#define OPENSSH_SERIALIZE_RAW_MAXLEN    ( OPENSSH_KEY_V1_MAGICBYTES_LEN + 3 * 4 + 2 * 4 + 4 \
+                                        + 4 + ED25519_PUBLIC_BLOB_SIZE + 4 + 2 * 4 + ED25519_PUBLIC_BLOB_SIZE \
+                                        + 4 + ED25519_SECRETKEY_SIZE + 4 + OPENSSHKEY_COMMENT_MAXLEN + 8 )
+
+/* the armored text of such a file, with a newline per line of base64 */
+#define OPENSSH_SERIALIZE_TEXT_MAXLEN   ( OPENSSH_KEY_V1_MARK_BEGIN_LEN + OPENSSH_KEY_V1_MARK_END_LEN \
+                                        + b64_encoded_len(OPENSSH_SERIALIZE_RAW_MAXLEN) \
+                                        + b64_encoded_len(OPENSSH_SERIALIZE_RAW_MAXLEN) / OPENSSH_SERIALIZE_WRAP + 1 )
+
+/* statuscodes are in statuscodes.h */
+
+/****************************************************************************************/
+
+/* an unencrypted openssh-key-v1 file with the ed25519 key, as ssh-keygen writes it.
+   checkint should be random, text must hold OPENSSH_SERIALIZE_TEXT_MAXLEN bytes
+   and is not terminated, len is set to its length */
+int openssh_key_v1_serialize (const struct opensshkey *key, unsigned long checkint,
+                              char *text, size_t textlen, size_t *len);
+
+/* write the key to file with a random checkint, readable only by the owner, and its
+   public key line to file.pub, as ssh-keygen does */
+int openssh_key_v1_save (const struct opensshkey *key, const char *file);
+
+#endif
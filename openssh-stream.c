@@ -0,0 +1,289 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * The accepted files and the statuscodes follow openssh_key_v1_unarmor
+ * and openssh_key_v1_scan in openssh-parse.c, which finally parse the
+ * decoded file. This only walks ahead of them to fail early.
+ */
+
+#include <string.h>
+
+#include "openssh-stream.h"
+
+/* start a new file */
+int openssh_key_v1_stream_init (struct openssh_key_v1_stream *st, const char *passphrase,
+                                struct opensshkey *keys, size_t maxkeys)
+{
+    memset(st, 0, sizeof *st);
+    st->phase = OPENSSH_STREAM_BEGIN;
+    st->field = OPENSSH_STREAM_MAGIC;
+    st->status = SUCCESS;
+    st->passphrase = passphrase;
+    st->keys = keys;
+    st->maxkeys = maxkeys;
+    b64_stream_init(&st->b64);
+
+    if ((st->decoded = newbuffer()) == NULL)
+        return BUFFER_ALLOCATION_FAILED;
+    return SUCCESS;
+}
+
+/* +---------------------+ */
+/* | decoded file        | */
+/* +---------------------+ */
+
+/* a string at the parsed position, 0 if it is not complete yet */
+static int openssh_stream_string (struct openssh_key_v1_stream *st, size_t *off, size_t *len)
+{
+    const unsigned char *data = buffer_get_dataptr(st->decoded);
+    size_t have = buffer_get_datasize(st->decoded) - st->parsed;
+
+    if (have < 4 || (*len = decode_uint32(data + st->parsed)) > have - 4)
+        return 0;
+    *off = st->parsed + 4;
+    st->parsed += 4 + *len;
+    return 1;
+}
+
+/* an uint32 at the parsed position, 0 if it is not complete yet */
+static int openssh_stream_u32 (struct openssh_key_v1_stream *st, unsigned long *value)
+{
+    if (buffer_get_datasize(st->decoded) - st->parsed < 4)
+        return 0;
+    *value = decode_uint32(buffer_get_dataptr(st->decoded) + st->parsed);
+    st->parsed += 4;
+    return 1;
+}
+
+/* check every header field that has been decoded completely, in the order
+   of openssh_key_v1_header. only errors which no later input can change
+   are reported, all others are left to the scan of the whole file */
+static int openssh_stream_header (struct openssh_key_v1_stream *st)
+{
+    const unsigned char *data = buffer_get_dataptr(st->decoded);
+    const struct cipher *cipher;
+    size_t off, len;
+    unsigned long privatelen;
+
+    for (;;) switch (st->field) {
+
+        case OPENSSH_STREAM_MAGIC:
+            if (buffer_get_datasize(st->decoded) < OPENSSH_KEY_V1_MAGICBYTES_LEN)
+                return SUCCESS;
+            if (memcmp(data, OPENSSH_KEY_V1_MAGICBYTES, OPENSSH_KEY_V1_MAGICBYTES_LEN) != 0)
+                return OPENSSH_PARSE_INVALID_FORMAT;
+            st->parsed = OPENSSH_KEY_V1_MAGICBYTES_LEN;
+            st->field++;
+            break;
+
+        case OPENSSH_STREAM_CIPHERNAME:
+            if (!openssh_stream_string(st, &st->cipheroff, &st->cipherlen))
+                return SUCCESS;
+            st->field++;
+            break;
+
+        case OPENSSH_STREAM_KDFNAME:
+            if (!openssh_stream_string(st, &st->kdfoff, &st->kdflen))
+                return SUCCESS;
+            st->field++;
+            break;
+
+        case OPENSSH_STREAM_KDFOPTIONS:
+            if (!openssh_stream_string(st, &off, &len))
+                return SUCCESS;
+            st->field++;
+            break;
+
+        /* cipher and kdf are only checked once the number of keys is read */
+        case OPENSSH_STREAM_NKEYS:
+            if (!openssh_stream_u32(st, &st->nkeys))
+                return SUCCESS;
+            if ((cipher = cipher_by_name(data + st->cipheroff, st->cipherlen)) == NULL)
+                return OPENSSH_PARSE_UNSUPPORTED_CIPHER;
+            if (!memeqstr(data + st->kdfoff, st->kdflen, cipher->keylen == 0 ? "none" : "bcrypt"))
+                return OPENSSH_PARSE_UNSUPPORTED_KDF;
+            if (st->nkeys == 0)
+                return OPENSSH_PARSE_INVALID_FORMAT;
+            st->field++;
+            break;
+
+        case OPENSSH_STREAM_PUBLICKEYS:
+            while (st->counted < st->nkeys && openssh_stream_string(st, &off, &len))
+                st->counted++;
+            if (st->counted < st->nkeys)
+                return SUCCESS;
+            st->field++;
+            break;
+
+        /* now the size of the whole file is known */
+        case OPENSSH_STREAM_PRIVATELEN:
+            if (!openssh_stream_u32(st, &privatelen))
+                return SUCCESS;
+            cipher = cipher_by_name(data + st->cipheroff, st->cipherlen);
+            if (privatelen < cipher->blocksize || (privatelen % cipher->blocksize) != 0)
+                return OPENSSH_PARSE_INVALID_PRIVATE_FORMAT;
+            if (st->nkeys > st->maxkeys)
+                return OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS;
+            st->end = st->parsed + privatelen;
+            st->field++;
+            break;
+
+        /* the keys as soon as the last byte is there, anything beyond it is an error */
+        case OPENSSH_STREAM_PRIVATE:
+            if (buffer_get_datasize(st->decoded) < st->end)
+                return SUCCESS;
+            if (buffer_get_datasize(st->decoded) > st->end)
+                return OPENSSH_PARSE_INVALID_PRIVATE_FORMAT;
+            st->field++;
+            return openssh_key_v1_scan(buffer_get_dataptr(st->decoded), st->end, st->passphrase,
+                                       st->keys, st->maxkeys, &st->nscanned);
+
+        case OPENSSH_STREAM_SCANNED:
+            if (buffer_get_datasize(st->decoded) > st->end)
+                return OPENSSH_PARSE_INVALID_PRIVATE_FORMAT;
+            return SUCCESS;
+
+        default:
+            return OPENSSH_PARSE_INTERNAL_ERROR;
+    }
+}
+
+/* decode a part of a line. after invalid base64 the valid part in front of it
+   is decoded one character at a time, so that the decoded file does not
+   depend on how the text was split, then decoding stops for good */
+static int openssh_stream_decode (struct openssh_key_v1_stream *st, const unsigned char *text, size_t len)
+{
+    struct b64_stream before = st->b64;
+    int e;
+
+    if (st->b64failed || len == 0)
+        return SUCCESS;
+
+    e = buffer_put_decoded_base64_chunk(st->decoded, &st->b64, (const char *)text, len);
+    if (e == BUFFER_INVALID_FORMAT) {
+        st->b64 = before;
+        for (size_t i = 0; i < len; i++)
+            if (buffer_put_decoded_base64_chunk(st->decoded, &st->b64, (const char *)text + i, 1) != SUCCESS)
+                break;
+        st->b64failed = 1;
+    }
+    else if (e != SUCCESS)
+        return e;
+
+    return openssh_stream_header(st);
+}
+
+/* +---------------------+ */
+/* | armored text        | */
+/* +---------------------+ */
+
+int openssh_key_v1_stream_push (struct openssh_key_v1_stream *st, const void *chunk, size_t len)
+{
+    const unsigned char *text = chunk, *eol;
+    size_t linelen;
+    int e = SUCCESS;
+
+    while (len > 0 && st->status == SUCCESS) switch (st->phase) {
+
+        /* the first bytes of the file must be the begin marker */
+        case OPENSSH_STREAM_BEGIN:
+            if (*text != (unsigned char)OPENSSH_KEY_V1_MARK_BEGIN[st->marked]) {
+                st->status = OPENSSH_PARSE_INVALID_FORMAT;
+                break;
+            }
+            text++, len--;
+            if (++st->marked == OPENSSH_KEY_V1_MARK_BEGIN_LEN) {
+                st->phase = OPENSSH_STREAM_LINESTART;
+                st->marked = 0;
+            }
+            break;
+
+        /* hold back what matches the end marker, the matched part is known */
+        case OPENSSH_STREAM_LINESTART:
+            if (*text == (unsigned char)OPENSSH_KEY_V1_MARK_END[st->marked]) {
+                text++, len--;
+                if (++st->marked == OPENSSH_KEY_V1_MARK_END_LEN)
+                    st->phase = OPENSSH_STREAM_ENDED;
+                break;
+            }
+            e = openssh_stream_decode(st, (const unsigned char *)OPENSSH_KEY_V1_MARK_END, st->marked);
+            st->phase = OPENSSH_STREAM_LINE;
+            st->marked = 0;
+            if (e != SUCCESS)
+                st->status = e;
+            break;
+
+        /* the rest of a line, the newline is decoded with it as whitespace */
+        case OPENSSH_STREAM_LINE:
+            eol = memchr(text, '\n', len);
+            linelen = eol != NULL ? (size_t)(eol - text) + 1 : len;
+            if ((e = openssh_stream_decode(st, text, linelen)) != SUCCESS)
+                st->status = e;
+            if (eol != NULL)
+                st->phase = OPENSSH_STREAM_LINESTART;
+            text += linelen;
+            len -= linelen;
+            break;
+
+        /* nothing after the end marker is looked at */
+        case OPENSSH_STREAM_ENDED:
+            len = 0;
+            break;
+    }
+
+    return st->status;
+}
+
+int openssh_key_v1_stream_done (const struct openssh_key_v1_stream *st)
+{
+    return st->phase == OPENSSH_STREAM_ENDED;
+}
+
+struct opensshkey * openssh_key_v1_stream_keys (const struct openssh_key_v1_stream *st, size_t *nkeys)
+{
+    if (st->status != SUCCESS || st->field != OPENSSH_STREAM_SCANNED)
+        return NULL;
+    if (nkeys != NULL)
+        *nkeys = st->nscanned;
+    return st->keys;
+}
+
+int openssh_key_v1_stream_final (struct openssh_key_v1_stream *st, size_t *nkeys)
+{
+    int e = st->status;
+
+    *nkeys = 0;
+
+    /* the checks of openssh_key_v1_unarmor, in its order */
+    if (e == SUCCESS && st->phase != OPENSSH_STREAM_ENDED)
+        e = OPENSSH_PARSE_INVALID_FORMAT;
+    if (e == SUCCESS && (st->b64failed || b64_stream_final(&st->b64) != 0))
+        e = BUFFER_INVALID_FORMAT;
+
+    /* a file which ended early has not been scanned, which finds the exact error */
+    if (e == SUCCESS && st->field != OPENSSH_STREAM_SCANNED)
+        e = openssh_key_v1_scan(buffer_get_dataptr(st->decoded), buffer_get_datasize(st->decoded),
+                                st->passphrase, st->keys, st->maxkeys, &st->nscanned);
+
+    /* no keys of a file that failed after all */
+    if (e != SUCCESS) {
+        if (st->field == OPENSSH_STREAM_SCANNED)
+            for (size_t k = 0; k < st->nscanned; k++)
+                opensshkey_wipe(&st->keys[k]);
+        st->nscanned = 0;
+        st->status = e;
+        return e;
+    }
+
+    st->field = OPENSSH_STREAM_SCANNED;
+    *nkeys = st->nscanned;
+    return SUCCESS;
+}
+
+void openssh_key_v1_stream_free (struct openssh_key_v1_stream *st)
+{
+    freebuffer(st->decoded);
+    st->decoded = NULL;
+}
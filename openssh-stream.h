@@ -0,0 +1,85 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_openssh_stream_h_
+#define _headerguard_openssh_stream_h_
+
+#include "buffer.h"
+#include "base64-stream.h"
+#include "openssh-key.h"
+#include "openssh-parse.h"
+
+/****************************************************************************************/
+
+/* where in the text of a file the push parser is */
+enum openssh_stream_phases {
+    OPENSSH_STREAM_BEGIN,       /* matching the begin marker */
+    OPENSSH_STREAM_LINESTART,   /* at the start of a line, which may be the end marker */
+    OPENSSH_STREAM_LINE,        /* inside a line of base64 */
+    OPENSSH_STREAM_ENDED,       /* saw the end marker, anything after it is ignored */
+};
+
+/* how far the decoded file has been checked, in the order of openssh-parse.h */
+enum openssh_stream_fields {
+    OPENSSH_STREAM_MAGIC,
+    OPENSSH_STREAM_CIPHERNAME,
+    OPENSSH_STREAM_KDFNAME,
+    OPENSSH_STREAM_KDFOPTIONS,
+    OPENSSH_STREAM_NKEYS,
+    OPENSSH_STREAM_PUBLICKEYS,
+    OPENSSH_STREAM_PRIVATELEN,
+    OPENSSH_STREAM_PRIVATE,     /* waiting for the end of the private section */
+    OPENSSH_STREAM_SCANNED,     /* keys are deserialized */
+};
+
+/* state of a push parser, all offsets are into the decoded file */
+struct openssh_key_v1_stream {
+    int phase;                  /* one of openssh_stream_phases */
+    int field;                  /* one of openssh_stream_fields */
+    int status;                 /* first error, sticky */
+    size_t marked;              /* bytes of a marker matched so far */
+    struct b64_stream b64;
+    int b64failed;              /* the file is invalid, decoding stopped */
+    struct buffer *decoded;
+    size_t parsed;              /* header bytes checked */
+    size_t cipheroff, cipherlen, kdfoff, kdflen;
+    unsigned long nkeys, counted;
+    size_t end;                 /* size of the decoded file, once known */
+    const char *passphrase;
+    struct opensshkey *keys;
+    size_t maxkeys, nscanned;
+};
+
+/* statuscodes are in statuscodes.h */
+
+/****************************************************************************************/
+
+/* start a file with up to maxkeys keys, which are deserialized into keys of
+   the caller. passphrase is only needed for encrypted keys and may be NULL */
+int openssh_key_v1_stream_init (struct openssh_key_v1_stream *st, const char *passphrase,
+                                struct opensshkey *keys, size_t maxkeys);
+
+/* push the next chunk of text, split anywhere. returns SUCCESS as long as the
+   file may still turn out valid and the error as soon as it cannot, which
+   is then returned for every further chunk */
+int openssh_key_v1_stream_push (struct openssh_key_v1_stream *st, const void *chunk, size_t len);
+
+/* the end marker was seen, further text is not needed */
+int openssh_key_v1_stream_done (const struct openssh_key_v1_stream *st);
+
+/* the keys once the private section is complete, or NULL before. they are
+   usable right away, but only final confirms the end of the file */
+struct opensshkey * openssh_key_v1_stream_keys (const struct openssh_key_v1_stream *st, size_t *nkeys);
+
+/* end of the text. returns the status of unarmoring and scanning the whole
+   file at once, or the error push has reported already, which only differs
+   from it for files with more than one defect. no key is left on failure */
+int openssh_key_v1_stream_final (struct openssh_key_v1_stream *st, size_t *nkeys);
+
+/* release the decoded file, wiping it */
+void openssh_key_v1_stream_free (struct openssh_key_v1_stream *st);
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * The NIST P-256 curve y^2 = x^3 - 3x + b, as far as converting keys needs
+ * it: range checks, the curve equation and the public point of a scalar.
+ * Field elements are eight limbs of 32 bits in Montgomery form, which only
+ * needs 64 bit products. Points are projective and added with the complete
+ * formulas of Renes, Costello and Batina for a = -3, which also double and
+ * handle the point at infinity, so the Montgomery ladder over the scalar
+ * runs the same operations for every key.
+ */
+
+#include <string.h>
+
+#include "p256.h"
+#include "utilities.h"
+
+/* +---------------------+ */
+/* | field arithmetic    | */
+/* +---------------------+ */
+
+/* an element of GF(p), least significant limb first and below p between operations */
+typedef uint32_t fe[8];
+
+/* p = 2^256 - 2^224 + 2^192 + 2^96 - 1 */
+static const fe fe_p = { 0xffffffff, 0xffffffff, 0xffffffff, 0, 0, 0, 1, 0xffffffff };
+
+/* 2^512 mod p, to bring elements into Montgomery form */
+static const fe fe_r2 = { 3, 0, 0xffffffff, 0xfffffffb, 0xfffffffe, 0xffffffff, 0xfffffffd, 4 };
+
+/* the order of the base point, and the curve constant and base point, big endian */
+static const unsigned char p256_n[32] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51,
+};
+static const unsigned char p256_b[32] = {
+    0x5a, 0xc6, 0x35, 0xd8, 0xaa, 0x3a, 0x93, 0xe7, 0xb3, 0xeb, 0xbd, 0x55, 0x76, 0x98, 0x86, 0xbc,
+    0x65, 0x1d, 0x06, 0xb0, 0xcc, 0x53, 0xb0, 0xf6, 0x3b, 0xce, 0x3c, 0x3e, 0x27, 0xd2, 0x60, 0x4b,
+};
+static const unsigned char p256_g[64] = {
+    0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47, 0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2,
+    0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0, 0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96,
+    0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b, 0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16,
+    0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce, 0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5,
+};
+
+/* t - p if t, with carry as its ninth limb, is at least p, in constant time */
+static void fe_reduce (fe r, const uint32_t t[8], uint32_t carry)
+{
+    uint32_t s[8], mask;
+    uint64_t d, borrow = 0;
+
+    for (int i = 0; i < 8; i++) {
+        d = (uint64_t)t[i] - fe_p[i] - borrow;
+        s[i] = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+    mask = 0 - ((carry | (borrow ^ 1)) & 1);
+    for (int i = 0; i < 8; i++)
+        r[i] = (s[i] & mask) | (t[i] & ~mask);
+}
+
+static void fe_add (fe r, const fe a, const fe b)
+{
+    uint32_t t[8];
+    uint64_t c = 0;
+
+    for (int i = 0; i < 8; i++) {
+        c += (uint64_t)a[i] + b[i];
+        t[i] = (uint32_t)c;
+        c >>= 32;
+    }
+    fe_reduce(r, t, (uint32_t)c);
+}
+
+static void fe_sub (fe r, const fe a, const fe b)
+{
+    uint32_t t[8], mask;
+    uint64_t d, c = 0, borrow = 0;
+
+    for (int i = 0; i < 8; i++) {
+        d = (uint64_t)a[i] - b[i] - borrow;
+        t[i] = (uint32_t)d;
+        borrow = (d >> 32) & 1;
+    }
+    /* add p back if it went below zero */
+    mask = 0 - (uint32_t)borrow;
+    for (int i = 0; i < 8; i++) {
+        c += (uint64_t)t[i] + (fe_p[i] & mask);
+        r[i] = (uint32_t)c;
+        c >>= 32;
+    }
+}
+
+/* a * b / 2^256 mod p. -1/p mod 2^32 is 1, so the multiple of p to add
+   for each limb is that limb itself */
+static void fe_mul (fe r, const fe a, const fe b)
+{
+    uint32_t t[10] = { 0 }, m;
+    uint64_t c;
+
+    for (int i = 0; i < 8; i++) {
+        c = 0;
+        for (int j = 0; j < 8; j++) {
+            c += (uint64_t)a[j] * b[i] + t[j];
+            t[j] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[8];
+        t[8] = (uint32_t)c;
+        t[9] = (uint32_t)(c >> 32);
+
+        m = t[0];
+        c = ((uint64_t)m * fe_p[0] + t[0]) >> 32;
+        for (int j = 1; j < 8; j++) {
+            c += (uint64_t)m * fe_p[j] + t[j];
+            t[j - 1] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[8];
+        t[7] = (uint32_t)c;
+        t[8] = t[9] + (uint32_t)(c >> 32);
+    }
+    fe_reduce(r, t, t[8]);
+}
+
+/* big endian bytes, which must be below p, to Montgomery form and back */
+static void fe_frombytes (fe r, const unsigned char *s)
+{
+    fe t;
+
+    for (int i = 0; i < 8; i++)
+        t[i] = (uint32_t)s[31 - 4 * i] | (uint32_t)s[30 - 4 * i] << 8 |
+               (uint32_t)s[29 - 4 * i] << 16 | (uint32_t)s[28 - 4 * i] << 24;
+    fe_mul(r, t, fe_r2);
+}
+
+static void fe_tobytes (unsigned char *s, const fe a)
+{
+    static const fe one = { 1 };
+    fe t;
+
+    fe_mul(t, a, one);
+    for (int i = 0; i < 8; i++) {
+        s[31 - 4 * i] = t[i];
+        s[30 - 4 * i] = t[i] >> 8;
+        s[29 - 4 * i] = t[i] >> 16;
+        s[28 - 4 * i] = t[i] >> 24;
+    }
+}
+
+/* a^(p-2), the exponent is public so plain square and multiply will do */
+static void fe_invert (fe r, const fe a)
+{
+    static const fe p_minus_2 = { 0xfffffffd, 0xffffffff, 0xffffffff, 0, 0, 0, 1, 0xffffffff };
+    fe t;
+
+    memcpy(t, a, sizeof t);
+    for (int i = 254; i >= 0; i--) {
+        fe_mul(t, t, t);
+        if ((p_minus_2[i / 32] >> (i % 32)) & 1)
+            fe_mul(t, t, a);
+    }
+    memcpy(r, t, sizeof t);
+}
+
+static uint32_t fe_equal (const fe a, const fe b)
+{
+    uint32_t d = 0;
+
+    for (int i = 0; i < 8; i++)
+        d |= a[i] ^ b[i];
+    return d == 0;
+}
+
+/* big endian a < b, both 32 bytes, in constant time */
+static int bytes_less (const unsigned char *a, const unsigned char *b)
+{
+    int lt = 0, gt = 0;
+
+    for (int i = 0; i < 32; i++) {
+        lt |= !gt & (a[i] < b[i]);
+        gt |= !lt & (a[i] > b[i]);
+    }
+    return lt;
+}
+
+
+/* +---------------------+ */
+/* | points              | */
+/* +---------------------+ */
+
+struct p256_point {
+    fe X, Y, Z;
+};
+
+/* r = p + q, algorithm 4 of Renes, Costello and Batina, complete for a = -3 */
+static void p256_add (struct p256_point *r, const struct p256_point *p, const struct p256_point *q, const fe b)
+{
+    fe t0, t1, t2, t3, t4, X3, Y3, Z3;
+
+    fe_mul(t0, p->X, q->X);     fe_mul(t1, p->Y, q->Y);     fe_mul(t2, p->Z, q->Z);
+    fe_add(t3, p->X, p->Y);     fe_add(t4, q->X, q->Y);     fe_mul(t3, t3, t4);
+    fe_add(t4, t0, t1);         fe_sub(t3, t3, t4);         fe_add(t4, p->Y, p->Z);
+    fe_add(X3, q->Y, q->Z);     fe_mul(t4, t4, X3);         fe_add(X3, t1, t2);
+    fe_sub(t4, t4, X3);         fe_add(X3, p->X, p->Z);     fe_add(Y3, q->X, q->Z);
+    fe_mul(X3, X3, Y3);         fe_add(Y3, t0, t2);         fe_sub(Y3, X3, Y3);
+    fe_mul(Z3, b, t2);          fe_sub(X3, Y3, Z3);         fe_add(Z3, X3, X3);
+    fe_add(X3, X3, Z3);         fe_sub(Z3, t1, X3);         fe_add(X3, t1, X3);
+    fe_mul(Y3, b, Y3);          fe_add(t1, t2, t2);         fe_add(t2, t1, t2);
+    fe_sub(Y3, Y3, t2);         fe_sub(Y3, Y3, t0);         fe_add(t1, Y3, Y3);
+    fe_add(Y3, t1, Y3);         fe_add(t1, t0, t0);         fe_add(t0, t1, t0);
+    fe_sub(t0, t0, t2);         fe_mul(t1, t4, Y3);         fe_mul(t2, t0, Y3);
+    fe_mul(Y3, X3, Z3);         fe_add(Y3, Y3, t2);         fe_mul(X3, t3, X3);
+    fe_sub(X3, X3, t1);         fe_mul(Z3, t4, Z3);         fe_mul(t1, t3, t0);
+    fe_add(Z3, Z3, t1);
+
+    memcpy(r->X, X3, sizeof X3);
+    memcpy(r->Y, Y3, sizeof Y3);
+    memcpy(r->Z, Z3, sizeof Z3);
+}
+
+/* swap p and q if swap is 1, in constant time */
+static void p256_cswap (struct p256_point *p, struct p256_point *q, uint32_t swap)
+{
+    uint32_t *a = (uint32_t *)p, *b = (uint32_t *)q, mask = 0 - swap, t;
+
+    for (size_t i = 0; i < sizeof *p / sizeof *a; i++) {
+        t = mask & (a[i] ^ b[i]);
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+
+/* +---------------------+ */
+/* | keys                | */
+/* +---------------------+ */
+
+int p256_scalar_valid (const unsigned char d[P256_SCALAR_SIZE])
+{
+    unsigned char nonzero = 0;
+
+    for (int i = 0; i < P256_SCALAR_SIZE; i++)
+        nonzero |= d[i];
+    return nonzero != 0 && bytes_less(d, p256_n);
+}
+
+int p256_point_valid (const unsigned char q[P256_POINT_SIZE])
+{
+    static const unsigned char p_bytes[32] = {
+        0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    };
+    fe x, y, b, lhs, rhs, t;
+
+    if (!bytes_less(q, p_bytes) || !bytes_less(q + 32, p_bytes))
+        return 0;
+
+    /* y^2 = x^3 - 3x + b */
+    fe_frombytes(x, q);
+    fe_frombytes(y, q + 32);
+    fe_frombytes(b, p256_b);
+    fe_mul(lhs, y, y);
+    fe_mul(rhs, x, x);
+    fe_mul(rhs, rhs, x);
+    fe_add(t, x, x);
+    fe_add(t, t, x);
+    fe_sub(rhs, rhs, t);
+    fe_add(rhs, rhs, b);
+
+    return fe_equal(lhs, rhs);
+}
+
+/* a ladder from the top bit, r0 + base = r1 throughout */
+void p256_public (const unsigned char d[P256_SCALAR_SIZE], unsigned char q[P256_POINT_SIZE])
+{
+    static const fe one = { 1 };
+    struct p256_point r0, r1;
+    fe b, zinv, t;
+    uint32_t bit, swap = 0;
+
+    fe_frombytes(b, p256_b);
+
+    /* the point at infinity is (0 : 1 : 0) */
+    memset(&r0, 0, sizeof r0);
+    fe_mul(r0.Y, one, fe_r2);
+    fe_frombytes(r1.X, p256_g);
+    fe_frombytes(r1.Y, p256_g + 32);
+    memcpy(r1.Z, r0.Y, sizeof r1.Z);
+
+    for (int i = 255; i >= 0; i--) {
+        bit = (d[31 - i / 8] >> (i % 8)) & 1;
+        p256_cswap(&r0, &r1, swap ^ bit);
+        swap = bit;
+        p256_add(&r1, &r0, &r1, b);
+        p256_add(&r0, &r0, &r0, b);
+    }
+    p256_cswap(&r0, &r1, swap);
+
+    fe_invert(zinv, r0.Z);
+    fe_mul(t, r0.X, zinv);
+    fe_tobytes(q, t);
+    fe_mul(t, r0.Y, zinv);
+    fe_tobytes(q + 32, t);
+
+    memzero(&r0, sizeof r0);
+    memzero(&r1, sizeof r1);
+    memzero(zinv, sizeof zinv);
+    memzero(t, sizeof t);
+}
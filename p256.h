@@ -0,0 +1,30 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_p256_h_
+#define _headerguard_p256_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/****************************************************************************************/
+
+/* the secret scalar and the public point X || Y, both big endian */
+#define P256_SCALAR_SIZE 32
+#define P256_POINT_SIZE  64
+
+/****************************************************************************************/
+
+/* 1 if 0 < d < n, the order of the base point */
+int p256_scalar_valid (const unsigned char d[P256_SCALAR_SIZE]);
+
+/* 1 if both coordinates are below p and the point is on the curve */
+int p256_point_valid (const unsigned char q[P256_POINT_SIZE]);
+
+/* the public point d times the base point, in constant time. d must be valid */
+void p256_public (const unsigned char d[P256_SCALAR_SIZE], unsigned char q[P256_POINT_SIZE]);
+
+#endif
@@ -0,0 +1,1334 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "selftest.h"
+#include "aes.h"
+#include "base64.h"
+#include "base64-simd.h"
+#include "base64-stream.h"
+#include "sha256.h"
+#include "sha512.h"
+#include "bcrypt-pbkdf.h"
+#include "openssh-parse.h"
+#include "openssh-stream.h"
+#include "openssh-serialize.h"
+#include "cpufeatures.h"
+#include "ed25519.h"
+#include "p256.h"
+#include "keytypes.h"
+
+/* largest generated inputs, long enough to run through every vector width */
+#define SELFTEST_MAXDATA 1600
+#define SELFTEST_MAXCLEAN ( (SELFTEST_MAXDATA + 2) / 3 * 4 + 1 )
+/* room for a newline in front of every character and some trailing junk */
+#define SELFTEST_MAXTEXT  ( 2 * SELFTEST_MAXCLEAN + 16 )
+
+/* failures shown in detail, the rest is only counted */
+#define SELFTEST_SHOW_FAILURES 5
+
+/* a generated ed25519 key file, decoded and armored */
+#define SELFTEST_KEYFILE_RAW  320
+#define SELFTEST_KEYFILE_WRAP 70
+#define SELFTEST_KEYFILE_TEXT 640
+
+#ifdef STATIC_STORAGE
+/* the single buffer slot holds a regular key file, and no copy of it */
+# define SELFTEST_BENCH_COMMENT 0
+#else
+/* a key file with a long comment, so that copies of it show in the peak rss */
+# define SELFTEST_BENCH_COMMENT ( 256 * 1024 )
+#endif
+#define SELFTEST_BENCH_KEYFILE_RAW  ( SELFTEST_KEYFILE_RAW + SELFTEST_BENCH_COMMENT )
+#define SELFTEST_BENCH_KEYFILE_TEXT ( SELFTEST_KEYFILE_TEXT + 2 * SELFTEST_BENCH_COMMENT )
+
+/* fixed seed, so that a failure can be reproduced */
+#define SELFTEST_SEED 0x746e7973636f6e76ULL
+
+static const char ref_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/* +----------------------------+ */
+/* | random and timing utility  | */
+/* +----------------------------+ */
+
+static unsigned long long selftest_state;
+
+/* xorshift64* */
+static unsigned long long rnd ()
+{
+    selftest_state ^= selftest_state >> 12;
+    selftest_state ^= selftest_state << 25;
+    selftest_state ^= selftest_state >> 27;
+    return selftest_state * 0x2545f4914f6cdd1dULL;
+}
+
+/* uniform enough in [0, n) */
+static size_t rndn (size_t n)
+{
+    return n > 0 ? (size_t)(rnd() % n) : 0;
+}
+
+static double selftest_now ()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* repeat stmt for at least SELFTEST_BENCH_SECONDS and compute bytes per second in MB/s */
+#define SELFTEST_MBPS(result, bytes, stmt) do {                                     \
+    unsigned long rounds_ = 0;                                                      \
+    double start_ = selftest_now(), elapsed_;                                       \
+    do { stmt; rounds_++; }                                                         \
+    while ((elapsed_ = selftest_now() - start_) < SELFTEST_BENCH_SECONDS);          \
+    result = (double)(bytes) * rounds_ / elapsed_ / 1e6;                            \
+} while (0)
+
+static void selftest_fail (FILE *out, int *fails, const char *kernel, const char *what, unsigned long c, int want, int got)
+{
+    if ((*fails)++ >= SELFTEST_SHOW_FAILURES)
+        return;
+    if (want == got)
+        fprintf(out, "  %-11s %s case %lu: output differs from reference\n", kernel, what, c);
+    else
+        fprintf(out, "  %-11s %s case %lu: returned %d, reference %d\n", kernel, what, c, got, want);
+}
+
+
+/* +---------------------------------+ */
+/* | reference base64, one at a time | */
+/* +---------------------------------+ */
+
+/* isspace() of the C locale */
+static int ref_isspace (int ch)
+{
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+static int ref_value (int ch)
+{
+    const char *pos = ch != '\0' ? strchr(ref_alphabet, ch) : NULL;
+    return pos != NULL ? (int)(pos - ref_alphabet) : -1;
+}
+
+/* straight from the rules b64_pton has always had: whitespace anywhere, one or two
+   '=' after two or three characters, zero bits in the last partial byte and the
+   peculiar capacity checks which need room for the partial byte */
+static int ref_b64_pton (const char *src, unsigned char *target, size_t targsize)
+{
+    size_t tarindex = 0;
+    unsigned int state = 0;
+    int ch, val;
+
+    while ((ch = (unsigned char)*src++) != '\0' && ch != '=') {
+        if (ref_isspace(ch))
+            continue;
+        if ((val = ref_value(ch)) < 0)
+            return -1;
+
+        switch (state) {
+            case 0:
+                if (tarindex >= targsize)
+                    return -1;
+                target[tarindex] = val << 2;
+                break;
+            case 1:
+                if (tarindex + 1 >= targsize)
+                    return -1;
+                target[tarindex++] |= val >> 4;
+                target[tarindex] = (val & 0x0f) << 4;
+                break;
+            case 2:
+                if (tarindex + 1 >= targsize)
+                    return -1;
+                target[tarindex++] |= val >> 2;
+                target[tarindex] = (val & 0x03) << 6;
+                break;
+            case 3:
+                if (tarindex >= targsize)
+                    return -1;
+                target[tarindex++] |= val;
+                break;
+        }
+        state = (state + 1) % 4;
+    }
+
+    if (ch == '=') {
+        if (state < 2)
+            return -1;
+        /* after a single byte a second '=' must follow */
+        if (state == 2) {
+            while ((ch = (unsigned char)*src++) != '\0' && ref_isspace(ch))
+                ;
+            if (ch != '=')
+                return -1;
+        }
+        while ((ch = (unsigned char)*src++) != '\0')
+            if (!ref_isspace(ch))
+                return -1;
+        if (target[tarindex] != 0)
+            return -1;
+    } else if (state != 0)
+        return -1;
+
+    return (int)tarindex;
+}
+
+/* encode with padding, fails unless the terminating zero fits as well */
+static int ref_b64_ntop (const unsigned char *src, size_t srclen, char *target, size_t targsize)
+{
+    size_t i, o = 0;
+    unsigned long group;
+
+    if ((srclen + 2) / 3 * 4 >= targsize)
+        return -1;
+
+    for (i = 0; i < srclen; i += 3) {
+        group = (unsigned long)src[i] << 16 |
+                (i + 1 < srclen ? (unsigned long)src[i + 1] << 8 : 0) |
+                (i + 2 < srclen ? (unsigned long)src[i + 2] : 0);
+        target[o++] = ref_alphabet[group >> 18 & 0x3f];
+        target[o++] = ref_alphabet[group >> 12 & 0x3f];
+        target[o++] = i + 1 < srclen ? ref_alphabet[group >> 6 & 0x3f] : '=';
+        target[o++] = i + 2 < srclen ? ref_alphabet[group & 0x3f] : '=';
+    }
+    target[o] = '\0';
+    return (int)o;
+}
+
+
+/* +------------------+ */
+/* | base64 kernels   | */
+/* +------------------+ */
+
+/* random length, mostly short but sometimes long enough for the widest kernel */
+static size_t selftest_length (size_t max)
+{
+    return rndn(8) == 0 ? rndn(max + 1) : rndn(100);
+}
+
+/* base64 text as found in key files, wrapped or not, then possibly damaged */
+static void selftest_b64_text (char *text)
+{
+    static const char foreign[] = "=-_.@!\x01\x7f\x80\xff";
+    unsigned char data[SELFTEST_MAXDATA];
+    char clean[SELFTEST_MAXCLEAN];
+    size_t n, len, wrap, i, out = 0, last;
+
+    n = selftest_length(SELFTEST_MAXDATA);
+    for (i = 0; i < n; i++)
+        data[i] = rnd();
+    len = ref_b64_ntop(data, n, clean, sizeof clean);
+
+    /* nonzero bits in the last partial byte */
+    if (rndn(10) == 0 && len > 0 && clean[len - 1] == '=') {
+        for (last = len - 1; last > 0 && clean[last] == '='; last--)
+            ;
+        clean[last] = ref_alphabet[rndn(64)];
+    }
+    /* padding missing, truncated or a foreign character anywhere */
+    if (rndn(8) == 0)
+        while (len > 0 && clean[len - 1] == '=')
+            len--;
+    if (rndn(6) == 0 && len > 0)
+        len = rndn(len);
+    if (rndn(10) == 0 && len > 0)
+        clean[rndn(len)] = foreign[rndn(sizeof foreign - 1)];
+
+    /* line breaks as in armored files, stray whitespace of all kinds */
+    wrap = rndn(3) == 0 ? 0 : rndn(4) == 0 ? 1 + rndn(80) : 64 + 6 * rndn(3);
+    for (i = 0; i < len; i++) {
+        if (wrap > 0 && i > 0 && i % wrap == 0)
+            text[out++] = '\n';
+        else if (rndn(50) == 0)
+            text[out++] = " \t\n\v\f\r"[rndn(6)];
+        text[out++] = clean[i];
+    }
+    if (rndn(4) == 0)
+        text[out++] = '\n';
+    /* something after the end */
+    if (rndn(20) == 0)
+        text[out++] = rndn(2) ? '=' : ref_alphabet[rndn(64)];
+    text[out] = '\0';
+}
+
+/* all entry points which use the kernels, on the same cases for each kernel */
+static int selftest_base64 (FILE *out, const char *kernel)
+{
+    static char text[SELFTEST_MAXTEXT], work[SELFTEST_MAXTEXT];
+    static unsigned char want[SELFTEST_MAXTEXT], got[SELFTEST_MAXTEXT + 256];
+    static unsigned char data[SELFTEST_MAXDATA + 64];
+    static char enc_want[SELFTEST_MAXCLEAN + 16], enc_got[SELFTEST_MAXCLEAN + 16];
+    struct b64_stream st;
+    size_t textlen, ts, pos, chunk, produced, n, off, need;
+    int r_want, r_got, fails = 0;
+    unsigned long c;
+
+    selftest_state = SELFTEST_SEED;
+    for (c = 0; c < SELFTEST_BASE64_CASES; c++) {
+        selftest_b64_text(text);
+        textlen = strlen(text);
+
+        /* decoding, with room to spare, exactly enough or too little */
+        r_want = ref_b64_pton(text, want, sizeof want);
+        switch (rndn(4)) {
+            case 0:  ts = sizeof want; break;
+            case 1:  ts = r_want >= 0 ? (size_t)r_want + rndn(3) : rndn(textlen + 1); break;
+            case 2:  ts = r_want > 0 ? (size_t)r_want - 1 : 0; break;
+            default: ts = rndn(textlen + 1); break;
+        }
+        r_want = ref_b64_pton(text, want, ts);
+        r_got = b64_pton(text, got, ts);
+        if (r_want != r_got || (r_want > 0 && memcmp(want, got, r_want) != 0))
+            selftest_fail(out, &fails, kernel, "b64_pton", c, r_want, r_got);
+
+        /* in place, as key files are decoded */
+        memcpy(work, text, textlen + 1);
+        r_want = ref_b64_pton(text, want, textlen + 1);
+        r_got = b64_pton(work, (unsigned char *)work, textlen + 1);
+        if (r_want != r_got || (r_want > 0 && memcmp(want, work, r_want) != 0))
+            selftest_fail(out, &fails, kernel, "b64_pton in place", c, r_want, r_got);
+
+        /* streamed in chunks of random size */
+        r_want = ref_b64_pton(text, want, sizeof want);
+        b64_stream_init(&st);
+        produced = 0;
+        r_got = 0;
+        for (pos = 0; pos < textlen && r_got >= 0; pos += chunk) {
+            chunk = 1 + rndn(rndn(2) ? 8 : 200);
+            if (chunk > textlen - pos)
+                chunk = textlen - pos;
+            if ((r_got = b64_stream_decode(&st, text + pos, chunk, got + produced)) >= 0)
+                produced += r_got;
+        }
+        r_got = r_got < 0 || b64_stream_final(&st) != 0 ? -1 : (int)produced;
+        if (r_want != r_got || (r_want > 0 && memcmp(want, got, r_want) != 0))
+            selftest_fail(out, &fails, kernel, "b64_stream_decode", c, r_want, r_got);
+
+        /* encoding at any alignment, nothing may be written past the zero */
+        n = selftest_length(SELFTEST_MAXDATA);
+        off = rndn(64);
+        for (size_t i = 0; i < n; i++)
+            data[off + i] = rnd();
+        need = b64_encoded_len(n);
+        ts = rndn(3) == 0 ? need + rndn(2) : need + 1 + rndn(8);
+        memset(enc_want, '#', sizeof enc_want);
+        memset(enc_got, '#', sizeof enc_got);
+        r_want = ref_b64_ntop(data + off, n, enc_want, ts);
+        r_got = b64_ntop(data + off, n, enc_got, ts);
+        if (r_want != r_got || (r_want >= 0 && (memcmp(enc_want, enc_got, r_want + 1) != 0 || enc_got[r_want + 1] != '#')))
+            selftest_fail(out, &fails, kernel, "b64_ntop", c, r_want, r_got);
+    }
+
+    return fails;
+}
+
+
+/* +------------------+ */
+/* | sha256 kernels   | */
+/* +------------------+ */
+
+/* FIPS 180-4 examples */
+static const struct {
+    const char *msg;
+    const unsigned char digest[SHA256_DIGEST_SIZE];
+} sha256_answers[] = {
+    { "", {
+        0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+    { "abc", {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", {
+        0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+        0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+};
+#define n_sha256_answers (sizeof sha256_answers / sizeof *sha256_answers)
+
+/* the known answers, then random messages and batches against the portable kernel */
+static int selftest_sha256 (FILE *out, const char *kernel)
+{
+    static unsigned char pool[4 * SELFTEST_MAXDATA];
+    unsigned char want[SHA256_DIGEST_SIZE], got[SHA256_DIGEST_SIZE];
+    unsigned char batch_got[17][SHA256_DIGEST_SIZE];
+    const unsigned char *msgs[17];
+    size_t lens[17], len, off, n;
+    int fails = 0;
+    unsigned long c;
+
+    for (c = 0; c < n_sha256_answers; c++) {
+        sha256((const unsigned char *)sha256_answers[c].msg, strlen(sha256_answers[c].msg), got);
+        if (memcmp(got, sha256_answers[c].digest, SHA256_DIGEST_SIZE) != 0)
+            selftest_fail(out, &fails, kernel, "sha256 known answer", c, 0, 0);
+    }
+
+    selftest_state = SELFTEST_SEED;
+    for (size_t i = 0; i < sizeof pool; i++)
+        pool[i] = rnd();
+
+    for (c = 0; c < SELFTEST_SHA256_CASES; c++) {
+        len = selftest_length(sizeof pool / 2);
+        off = rndn(sizeof pool - len);
+
+        sha256_kernels_select("portable");
+        sha256(pool + off, len, want);
+        sha256_kernels_select(kernel);
+        sha256(pool + off, len, got);
+        if (memcmp(want, got, SHA256_DIGEST_SIZE) != 0)
+            selftest_fail(out, &fails, kernel, "sha256", c, 0, 0);
+
+        /* batches of any size with messages of mixed lengths */
+        if (c % 8 == 0) {
+            n = rndn(18);
+            for (size_t i = 0; i < n; i++) {
+                lens[i] = selftest_length(2 * SHA256_BLOCK_SIZE * 4);
+                msgs[i] = pool + rndn(sizeof pool - lens[i]);
+            }
+            sha256_batch(msgs, lens, n, batch_got);
+            sha256_kernels_select("portable");
+            for (size_t i = 0; i < n; i++) {
+                sha256(msgs[i], lens[i], want);
+                if (memcmp(want, batch_got[i], SHA256_DIGEST_SIZE) != 0)
+                    selftest_fail(out, &fails, kernel, "sha256_batch", c, 0, 0);
+            }
+            sha256_kernels_select(kernel);
+        }
+    }
+
+    return fails;
+}
+
+
+/* +------------------+ */
+/* | aes kernels      | */
+/* +------------------+ */
+
+/* FIPS 197 appendix C, the plaintext is 00112233445566778899aabbccddeeff
+   and the key 000102... with keylen bytes */
+static const struct {
+    size_t keylen;
+    const unsigned char ciphertext[AES_BLOCK_SIZE];
+} aes_answers[] = {
+    { 16, { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a } },
+    { 24, { 0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0, 0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91 } },
+    { 32, { 0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89 } },
+};
+#define n_aes_answers (sizeof aes_answers / sizeof *aes_answers)
+
+/* the known answers through both modes, then random keys, counters and
+   lengths against the portable kernel */
+static int selftest_aes (FILE *out, const char *kernel)
+{
+    static unsigned char data[SELFTEST_MAXDATA], want[SELFTEST_MAXDATA], got[SELFTEST_MAXDATA];
+    unsigned char k[32], block[AES_BLOCK_SIZE], ivwant[AES_BLOCK_SIZE], ivgot[AES_BLOCK_SIZE];
+    struct aes_key key;
+    size_t len, keylen;
+    int fails = 0;
+    unsigned long c;
+
+    for (size_t i = 0; i < sizeof k; i++)
+        k[i] = i;
+    for (c = 0; c < n_aes_answers; c++) {
+        aes_setkey(&key, k, aes_answers[c].keylen);
+
+        /* the keystream for a counter is its encryption */
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+            ivgot[i] = 0x11 * i;
+        memset(block, 0, sizeof block);
+        aes_ctr(&key, ivgot, block, sizeof block);
+        if (memcmp(block, aes_answers[c].ciphertext, sizeof block) != 0)
+            selftest_fail(out, &fails, kernel, "aes ctr known answer", c, 0, 0);
+
+        memset(ivgot, 0, sizeof ivgot);
+        memcpy(block, aes_answers[c].ciphertext, sizeof block);
+        aes_cbc_decrypt(&key, ivgot, block, 1);
+        for (int i = 0; i < AES_BLOCK_SIZE; i++)
+            if (block[i] != 0x11 * i) {
+                selftest_fail(out, &fails, kernel, "aes cbc known answer", c, 0x11 * i, block[i]);
+                break;
+            }
+    }
+
+    selftest_state = SELFTEST_SEED;
+    for (c = 0; c < SELFTEST_AES_CASES; c++) {
+        keylen = 16 + 8 * rndn(3);
+        for (size_t i = 0; i < keylen; i++)
+            k[i] = rnd();
+        for (size_t i = 0; i < AES_BLOCK_SIZE; i++)
+            ivwant[i] = rnd();
+        /* counters close to a carry into the upper bytes */
+        if (c % 4 == 0) {
+            size_t ones = rndn(8) + 1;
+            memset(ivwant + AES_BLOCK_SIZE - ones, 0xff, ones);
+        }
+        len = selftest_length(sizeof data);
+        for (size_t i = 0; i < len; i++)
+            data[i] = rnd();
+        aes_setkey(&key, k, keylen);
+
+        memcpy(want, data, len);
+        memcpy(got, data, len);
+        memcpy(ivgot, ivwant, sizeof ivgot);
+        aes_kernels_select("portable");
+        aes_ctr(&key, ivwant, want, len);
+        aes_kernels_select(kernel);
+        aes_ctr(&key, ivgot, got, len);
+        if (memcmp(want, got, len) != 0 || memcmp(ivwant, ivgot, sizeof ivgot) != 0)
+            selftest_fail(out, &fails, kernel, "aes_ctr", c, 0, 0);
+
+        len -= len % AES_BLOCK_SIZE;
+        memcpy(want, data, len);
+        memcpy(got, data, len);
+        memcpy(ivgot, ivwant, sizeof ivgot);
+        aes_kernels_select("portable");
+        aes_cbc_decrypt(&key, ivwant, want, len / AES_BLOCK_SIZE);
+        aes_kernels_select(kernel);
+        aes_cbc_decrypt(&key, ivgot, got, len / AES_BLOCK_SIZE);
+        if (memcmp(want, got, len) != 0 || memcmp(ivwant, ivgot, sizeof ivgot) != 0)
+            selftest_fail(out, &fails, kernel, "aes_cbc_decrypt", c, 0, 0);
+    }
+
+    aes_clearkey(&key);
+    return fails;
+}
+
+
+/* +------------------+ */
+/* | key derivation   | */
+/* +------------------+ */
+
+/* FIPS 180-4 "abc" */
+static const unsigned char sha512_abc[SHA512_DIGEST_SIZE] = {
+    0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba, 0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+    0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2, 0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+    0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8, 0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+    0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e, 0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f,
+};
+
+/* bcrypt_pbkdf("password", "salt", 4 rounds), as in the tests of other implementations */
+static const unsigned char bcrypt_pbkdf_answer[32] = {
+    0x5b, 0xbf, 0x0c, 0xc2, 0x93, 0x58, 0x7f, 0x1c, 0x36, 0x35, 0x55, 0x5c, 0x27, 0x79, 0x65, 0x98,
+    0xd4, 0x7e, 0x57, 0x90, 0x71, 0xbf, 0x42, 0x7e, 0x9d, 0x8f, 0xbe, 0x84, 0x2a, 0xba, 0x34, 0xd9,
+};
+
+/* known answers, then the threaded against the serial derivation for several
+   output sizes, alone and as one batch with mixed rounds */
+static int selftest_kdf (FILE *out)
+{
+    static const size_t keylens[] = { 1, 31, 32, 33, 48, 100, 257 };
+#define n_keylens (sizeof keylens / sizeof *keylens)
+    unsigned char salt[n_keylens][16], got[n_keylens][257], want[n_keylens][257], digest[SHA512_DIGEST_SIZE];
+    struct bcrypt_pbkdf_job jobs[n_keylens];
+    int fails = 0;
+
+    sha512((const unsigned char *)"abc", 3, digest);
+    if (memcmp(digest, sha512_abc, sizeof digest) != 0)
+        selftest_fail(out, &fails, "portable", "sha512 known answer", 0, 0, 0);
+
+    bcrypt_pbkdf("password", 8, (const unsigned char *)"salt", 4, got[0], sizeof bcrypt_pbkdf_answer, 4);
+    if (memcmp(got[0], bcrypt_pbkdf_answer, sizeof bcrypt_pbkdf_answer) != 0)
+        selftest_fail(out, &fails, "portable", "bcrypt_pbkdf known answer", 0, 0, 0);
+
+    /* a fixed number of threads, so that they run even on a single cpu */
+    selftest_state = SELFTEST_SEED;
+    for (size_t c = 0; c < n_keylens; c++) {
+        for (size_t i = 0; i < sizeof salt[c]; i++)
+            salt[c][i] = rnd();
+        bcrypt_pbkdf_set_threads(1);
+        bcrypt_pbkdf("selftest", 8, salt[c], sizeof salt[c], want[c], keylens[c], 1 + c % 3);
+        bcrypt_pbkdf_set_threads(4);
+        bcrypt_pbkdf("selftest", 8, salt[c], sizeof salt[c], got[c], keylens[c], 1 + c % 3);
+        if (memcmp(want[c], got[c], keylens[c]) != 0)
+            selftest_fail(out, &fails, "threads", "bcrypt_pbkdf", c, 0, 0);
+    }
+
+    memset(got, 0, sizeof got);
+    for (size_t c = 0; c < n_keylens; c++)
+        jobs[c] = (struct bcrypt_pbkdf_job) {
+            .pass = "selftest", .passlen = 8, .salt = salt[c], .saltlen = sizeof salt[c],
+            .key = got[c], .keylen = keylens[c], .rounds = 1 + c % 3,
+        };
+    bcrypt_pbkdf_batch(jobs, n_keylens);
+    for (size_t c = 0; c < n_keylens; c++)
+        if (jobs[c].result != 0 || memcmp(want[c], got[c], keylens[c]) != 0)
+            selftest_fail(out, &fails, "threads", "bcrypt_pbkdf_batch", c, 0, 0);
+    bcrypt_pbkdf_set_threads(0);
+
+    return fails;
+#undef n_keylens
+}
+
+
+/* +------------------+ */
+/* | ed25519          | */
+/* +------------------+ */
+
+#define SELFTEST_ED25519_CASES 100
+
+/* RFC 8032 section 7.1, tests 1 to 3: secret seed and public key */
+static const unsigned char ed25519_answers[3][2][32] = {
+    { { 0x9d, 0x61, 0xb1, 0x9d, 0xef, 0xfd, 0x5a, 0x60, 0xba, 0x84, 0x4a, 0xf4, 0x92, 0xec, 0x2c, 0xc4,
+        0x44, 0x49, 0xc5, 0x69, 0x7b, 0x32, 0x69, 0x19, 0x70, 0x3b, 0xac, 0x03, 0x1c, 0xae, 0x7f, 0x60 },
+      { 0xd7, 0x5a, 0x98, 0x01, 0x82, 0xb1, 0x0a, 0xb7, 0xd5, 0x4b, 0xfe, 0xd3, 0xc9, 0x64, 0x07, 0x3a,
+        0x0e, 0xe1, 0x72, 0xf3, 0xda, 0xa6, 0x23, 0x25, 0xaf, 0x02, 0x1a, 0x68, 0xf7, 0x07, 0x51, 0x1a } },
+    { { 0x4c, 0xcd, 0x08, 0x9b, 0x28, 0xff, 0x96, 0xda, 0x9d, 0xb6, 0xc3, 0x46, 0xec, 0x11, 0x4e, 0x0f,
+        0x5b, 0x8a, 0x31, 0x9f, 0x35, 0xab, 0xa6, 0x24, 0xda, 0x8c, 0xf6, 0xed, 0x4f, 0xb8, 0xa6, 0xfb },
+      { 0x3d, 0x40, 0x17, 0xc3, 0xe8, 0x43, 0x89, 0x5a, 0x92, 0xb7, 0x0a, 0xa7, 0x4d, 0x1b, 0x7e, 0xbc,
+        0x9c, 0x98, 0x2c, 0xcf, 0x2e, 0xc4, 0x96, 0x8c, 0xc0, 0xcd, 0x55, 0xf1, 0x2a, 0xf4, 0x66, 0x0c } },
+    { { 0xc5, 0xaa, 0x8d, 0xf4, 0x3f, 0x9f, 0x83, 0x7b, 0xed, 0xb7, 0x44, 0x2f, 0x31, 0xdc, 0xb7, 0xb1,
+        0x66, 0xd3, 0x85, 0x35, 0x07, 0x6f, 0x09, 0x4b, 0x85, 0xce, 0x3a, 0x2e, 0x0b, 0x44, 0x58, 0xf7 },
+      { 0xfc, 0x51, 0xcd, 0x8e, 0x62, 0x18, 0xa1, 0xa3, 0x8d, 0xa4, 0x7e, 0xd0, 0x02, 0x30, 0xf0, 0x58,
+        0x08, 0x16, 0xed, 0x13, 0xba, 0x33, 0x03, 0xac, 0x5d, 0xeb, 0x91, 0x15, 0x48, 0x90, 0x80, 0x25 } },
+};
+
+/* known answers, then random seeds one at a time against all of them at once,
+   which spans several batches that share their inversion */
+static int selftest_ed25519 (FILE *out)
+{
+    static unsigned char seeds[SELFTEST_ED25519_CASES][ED25519_SEED_SIZE];
+    static unsigned char want[SELFTEST_ED25519_CASES][ED25519_PUBLIC_SIZE], got[SELFTEST_ED25519_CASES][ED25519_PUBLIC_SIZE];
+    const unsigned char *ptrs[SELFTEST_ED25519_CASES];
+    int fails = 0;
+
+    for (size_t c = 0; c < 3; c++) {
+        ptrs[0] = ed25519_answers[c][0];
+        ed25519_public_batch(ptrs, 1, got);
+        if (memcmp(got[0], ed25519_answers[c][1], ED25519_PUBLIC_SIZE) != 0)
+            selftest_fail(out, &fails, "portable", "ed25519 known answer", c, 0, 0);
+    }
+
+    selftest_state = SELFTEST_SEED;
+    for (size_t c = 0; c < SELFTEST_ED25519_CASES; c++) {
+        for (size_t i = 0; i < ED25519_SEED_SIZE; i++)
+            seeds[c][i] = rnd();
+        ptrs[c] = seeds[c];
+        ed25519_public_batch(&ptrs[c], 1, &want[c]);
+    }
+    ed25519_public_batch(ptrs, SELFTEST_ED25519_CASES, got);
+    for (size_t c = 0; c < SELFTEST_ED25519_CASES; c++)
+        if (memcmp(want[c], got[c], ED25519_PUBLIC_SIZE) != 0)
+            selftest_fail(out, &fails, "batch", "ed25519_public_batch", c, 0, 0);
+
+    return fails;
+}
+
+
+/* +------------------+ */
+/* | nistp256         | */
+/* +------------------+ */
+
+#define SELFTEST_P256_CASES 32
+
+/* the base point G and 2G, the order n and the prime p, all big endian */
+static const unsigned char p256_answers[2][P256_POINT_SIZE] = {
+    { 0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47, 0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40, 0xf2,
+      0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0, 0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98, 0xc2, 0x96,
+      0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b, 0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e, 0x16,
+      0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce, 0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf, 0x51, 0xf5 },
+    { 0x7c, 0xf2, 0x7b, 0x18, 0x8d, 0x03, 0x4f, 0x7e, 0x8a, 0x52, 0x38, 0x03, 0x04, 0xb5, 0x1a, 0xc3,
+      0xc0, 0x89, 0x69, 0xe2, 0x77, 0xf2, 0x1b, 0x35, 0xa6, 0x0b, 0x48, 0xfc, 0x47, 0x66, 0x99, 0x78,
+      0x07, 0x77, 0x55, 0x10, 0xdb, 0x8e, 0xd0, 0x40, 0x29, 0x3d, 0x9a, 0xc6, 0x9f, 0x74, 0x30, 0xdb,
+      0xba, 0x7d, 0xad, 0xe6, 0x3c, 0xe9, 0x82, 0x29, 0x9e, 0x04, 0xb7, 0x9d, 0x22, 0x78, 0x73, 0xd1 },
+};
+static const unsigned char p256_order[P256_SCALAR_SIZE] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51 };
+static const unsigned char p256_prime[P256_SCALAR_SIZE] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+/* r = m - a for big endian numbers below m */
+static void selftest_p256_negate (const unsigned char *m, const unsigned char *a, unsigned char *r)
+{
+    int borrow = 0, d;
+
+    for (size_t i = P256_SCALAR_SIZE; i-- > 0; ) {
+        d = m[i] - a[i] - borrow;
+        borrow = d < 0;
+        r[i] = d & 0xff;
+    }
+}
+
+/* known answers and the bounds of both checks, then random scalars d and n - d,
+   whose points share x and have opposite y */
+static int selftest_p256 (FILE *out)
+{
+    unsigned char d[P256_SCALAR_SIZE], q[P256_POINT_SIZE], neg[P256_POINT_SIZE], y[P256_SCALAR_SIZE];
+    int fails = 0;
+
+    for (size_t c = 0; c < 2; c++) {
+        memset(d, 0, sizeof d);
+        d[P256_SCALAR_SIZE - 1] = c + 1;
+        p256_public(d, q);
+        if (memcmp(q, p256_answers[c], P256_POINT_SIZE) != 0)
+            selftest_fail(out, &fails, "portable", "p256 known answer", c, 0, 0);
+    }
+
+    /* 0 and n are no scalars, n - 1 is */
+    memset(d, 0, sizeof d);
+    if (p256_scalar_valid(d) || p256_scalar_valid(p256_order))
+        selftest_fail(out, &fails, "portable", "p256_scalar_valid", 0, 0, 1);
+    memcpy(d, p256_order, sizeof d);
+    d[P256_SCALAR_SIZE - 1]--;
+    if (!p256_scalar_valid(d))
+        selftest_fail(out, &fails, "portable", "p256_scalar_valid", 1, 1, 0);
+
+    /* G is on the curve, G with y + 1 is not, nor is a coordinate of p */
+    memcpy(q, p256_answers[0], sizeof q);
+    if (!p256_point_valid(q))
+        selftest_fail(out, &fails, "portable", "p256_point_valid", 0, 1, 0);
+    q[P256_POINT_SIZE - 1]++;
+    if (p256_point_valid(q))
+        selftest_fail(out, &fails, "portable", "p256_point_valid", 1, 0, 1);
+    memcpy(q, p256_prime, P256_SCALAR_SIZE);
+    if (p256_point_valid(q))
+        selftest_fail(out, &fails, "portable", "p256_point_valid", 2, 0, 1);
+
+    selftest_state = SELFTEST_SEED;
+    for (size_t c = 0; c < SELFTEST_P256_CASES; c++) {
+        do {
+            for (size_t i = 0; i < P256_SCALAR_SIZE; i++)
+                d[i] = rnd();
+        } while (!p256_scalar_valid(d));
+        p256_public(d, q);
+        selftest_p256_negate(p256_order, d, d);
+        p256_public(d, neg);
+        selftest_p256_negate(p256_prime, q + P256_SCALAR_SIZE, y);
+        if (!p256_point_valid(q) || memcmp(q, neg, P256_SCALAR_SIZE) != 0 ||
+            memcmp(y, neg + P256_SCALAR_SIZE, P256_SCALAR_SIZE) != 0)
+                selftest_fail(out, &fails, "portable", "p256_public", c, 0, 0);
+    }
+
+    return fails;
+}
+
+
+/* +---------------------+ */
+/* | key file parsing    | */
+/* +---------------------+ */
+
+/* ways to damage a generated key file */
+enum selftest_key_damage { SELFTEST_KEY_INTACT, SELFTEST_KEY_CHECKINT, SELFTEST_KEY_PADDING };
+
+static unsigned char *selftest_put_string (unsigned char *p, const void *str, size_t len)
+{
+    p[0] = len >> 24; p[1] = len >> 16; p[2] = len >> 8; p[3] = len;
+    memcpy(p + 4, str, len);
+    return p + 4 + len;
+}
+
+/* an unencrypted ed25519 key file as ssh-keygen writes it, with random key
+   material and the usual comment, or one of commentlen bytes if not 0. returns
+   the length of the text, which is not terminated */
+static size_t selftest_keyfile_sized (char *text, enum selftest_key_damage damage, size_t commentlen)
+{
+    static unsigned char raw[SELFTEST_BENCH_KEYFILE_RAW], comment[SELFTEST_BENCH_COMMENT + 1];
+    static char encoded[(SELFTEST_BENCH_KEYFILE_RAW + 2) / 3 * 4 + 1];
+    unsigned char pk[32], sk[64], blob[51], check[4], *p = raw, *priv, *lenptr;
+    size_t len, pad, w;
+
+    for (size_t i = 0; i < sizeof pk; i++)
+        sk[32 + i] = pk[i] = rnd();
+    for (size_t i = 0; i < 32; i++)
+        sk[i] = rnd();
+    for (size_t i = 0; i < sizeof check; i++)
+        check[i] = rnd();
+    selftest_put_string(selftest_put_string(blob, "ssh-ed25519", 11), pk, sizeof pk);
+
+    memcpy(p, "openssh-key-v1", 15);
+    p = selftest_put_string(p + 15, "none", 4);
+    p = selftest_put_string(p, "none", 4);
+    p = selftest_put_string(p, "", 0);
+    p[0] = p[1] = p[2] = 0; p[3] = 1;
+    p = selftest_put_string(p + 4, blob, sizeof blob);
+
+    /* the private section, its length is filled in afterwards */
+    lenptr = p;
+    priv = p += 4;
+    memcpy(p, check, 4);
+    memcpy(p + 4, check, 4);
+    if (damage == SELFTEST_KEY_CHECKINT)
+        p[7] ^= 1;
+    p = selftest_put_string(p + 8, "ssh-ed25519", 11);
+    p = selftest_put_string(p, pk, sizeof pk);
+    p = selftest_put_string(p, sk, sizeof sk);
+    if (commentlen == 0)
+        p = selftest_put_string(p, "selftest@localhost", 18);
+    else {
+        memset(comment, 'c', commentlen);
+        p = selftest_put_string(p, comment, commentlen);
+    }
+    for (pad = 1; (p - priv) % 8 != 0; pad++)
+        *p++ = pad;
+    if (damage == SELFTEST_KEY_PADDING)
+        p[-1] ^= 0x40;
+    len = p - priv;
+    lenptr[0] = len >> 24; lenptr[1] = len >> 16; lenptr[2] = len >> 8; lenptr[3] = len;
+
+    /* armored, with lines of 70 characters */
+    len = ref_b64_ntop(raw, p - raw, encoded, sizeof encoded);
+    memcpy(text, OPENSSH_KEY_V1_MARK_BEGIN, OPENSSH_KEY_V1_MARK_BEGIN_LEN);
+    w = OPENSSH_KEY_V1_MARK_BEGIN_LEN;
+    for (size_t i = 0; i < len; i++) {
+        text[w++] = encoded[i];
+        if (i % SELFTEST_KEYFILE_WRAP == SELFTEST_KEYFILE_WRAP - 1 || i == len - 1)
+            text[w++] = '\n';
+    }
+    memcpy(text + w, OPENSSH_KEY_V1_MARK_END, OPENSSH_KEY_V1_MARK_END_LEN);
+    return w + OPENSSH_KEY_V1_MARK_END_LEN;
+}
+
+static size_t selftest_keyfile (char *text, enum selftest_key_damage damage)
+{
+    return selftest_keyfile_sized(text, damage, 0);
+}
+
+/* same type, key material and comment */
+static int selftest_samekey (const struct opensshkey *a, const struct opensshkey *b)
+{
+    return a->type == b->type && a->commentlen == b->commentlen &&
+        memcmp(a->ed25519_pk, b->ed25519_pk, sizeof a->ed25519_pk) == 0 &&
+        memcmp(a->ed25519_sk, b->ed25519_sk, sizeof a->ed25519_sk) == 0 &&
+        memcmp(a->comment, b->comment, a->commentlen) == 0;
+}
+
+/* every name of the registry finds itself in a slot of its own, and names
+   which differ in the length or a byte find nothing */
+static int selftest_keytypes (FILE *out)
+{
+    const struct keytype *kt;
+    unsigned char name[64];
+    int fails = 0;
+
+    if (keytype_init() != 0)
+        selftest_fail(out, &fails, "registry", "keytype_init perfect hash", 0, 0, -1);
+
+    for (size_t i = 0; (kt = keytype_list(i)) != NULL; i++) {
+        if (keytype_by_name((const unsigned char *)kt->name, kt->namelen) != kt)
+            selftest_fail(out, &fails, "registry", "keytype_by_name", i, 0, 0);
+        if (keytype_by_name((const unsigned char *)kt->name, kt->namelen - 1) != NULL)
+            selftest_fail(out, &fails, "registry", "keytype_by_name prefix", i, 0, 0);
+        memcpy(name, kt->name, kt->namelen);
+        name[kt->namelen / 2] ^= 0x20;
+        if (keytype_by_name(name, kt->namelen) != NULL)
+            selftest_fail(out, &fails, "registry", "keytype_by_name changed byte", i, 0, 0);
+        if (keytype_of(kt->type, kt->nid) == NULL || keytype_of(kt->type, kt->nid)->type != kt->type)
+            selftest_fail(out, &fails, "registry", "keytype_of", i, 0, 0);
+    }
+
+    return fails;
+}
+
+/* hosts of known_hosts lines taken from key comments, NULL where none is valid */
+static const struct {
+    const char *comment, *hosts;
+} selftest_hosts_cases[] = {
+    { "root@host1",              "host1"                  },
+    { "host1",                   "host1"                  },
+    { "user@host,10.0.0.1",      "host,10.0.0.1"          },
+    { "me@work@[host]:2222",     "[host]:2222"            },
+    { "*.example.org,!bad",      "*.example.org,!bad"     },
+    { "|1|c2FsdA==|aGFzaA==",    "|1|c2FsdA==|aGFzaA=="   },
+    { "plain comment",           NULL                     },
+    { "user@host name",          NULL                     },
+    { "key\tfile",               NULL                     },
+    { "",                        NULL                     },
+    { "user@",                   NULL                     },
+    { "user@a,,b",               NULL                     },
+    { "user@a,",                 NULL                     },
+};
+#define SELFTEST_HOSTS_CASES ( sizeof selftest_hosts_cases / sizeof selftest_hosts_cases[0] )
+
+static int selftest_hosts (FILE *out)
+{
+    struct opensshkey key;
+    char hosts[OPENSSHKEY_COMMENT_MAXLEN + 1];
+    int fails = 0, want, e;
+
+    opensshkey_init(&key, KEY_ED25519);
+    for (unsigned long c = 0; c < SELFTEST_HOSTS_CASES; c++) {
+        const char *comment = selftest_hosts_cases[c].comment, *expect = selftest_hosts_cases[c].hosts;
+        want = expect != NULL ? SUCCESS : OPENSSH_KEY_INVALID_HOSTS;
+
+        opensshkey_set_comment(&key, (const unsigned char *)comment, strlen(comment));
+        e = opensshkey_comment_hosts(&key, hosts, sizeof hosts);
+        if (e != want || (e == SUCCESS && strcmp(hosts, expect) != 0))
+            selftest_fail(out, &fails, "known_hosts", "opensshkey_comment_hosts", c, want, e);
+        if (expect != NULL && (e = opensshkey_check_hosts(expect)) != SUCCESS)
+            selftest_fail(out, &fails, "known_hosts", "opensshkey_check_hosts", c, SUCCESS, e);
+    }
+
+    return fails;
+}
+
+/* the single pass parser against the buffered one, which shares nothing but
+   the deserialization of the key itself, on intact and damaged files */
+static int selftest_parse (FILE *out)
+{
+    static const int want[] = {
+        [SELFTEST_KEY_INTACT]   = SUCCESS,
+        [SELFTEST_KEY_CHECKINT] = OPENSSH_PARSE_INVALID_PRIVATE_FORMAT,
+        [SELFTEST_KEY_PADDING]  = OPENSSH_PARSE_INVALID_PRIVATE_FORMAT,
+    };
+    static char text[SELFTEST_KEYFILE_TEXT];
+    struct opensshkey scanned, *parsed;
+    struct buffer *buf;
+    size_t len, decoded, nkeys;
+    int fails = 0, e;
+
+    selftest_state = SELFTEST_SEED;
+    for (unsigned long c = 0; c < SELFTEST_PARSE_CASES; c++) {
+        enum selftest_key_damage damage = c % 3;
+        len = selftest_keyfile(text, damage);
+
+        parsed = NULL;
+        if ((e = buffer_new_from_data(&buf, text, len)) == SUCCESS) {
+            e = openssh_key_v1_parse(buf, NULL, &parsed);
+            freebuffer(buf);
+        }
+        if (e != want[damage])
+            selftest_fail(out, &fails, "buffered", "openssh_key_v1_parse", c, want[damage], e);
+
+        if ((e = openssh_key_v1_unarmor((unsigned char *)text, len, &decoded)) == SUCCESS)
+            e = openssh_key_v1_scan((unsigned char *)text, decoded, NULL, &scanned, 1, &nkeys);
+        if (e != want[damage])
+            selftest_fail(out, &fails, "scan", "openssh_key_v1_scan", c, want[damage], e);
+        else if (e == SUCCESS && (parsed == NULL || !selftest_samekey(parsed, &scanned)))
+            selftest_fail(out, &fails, "scan", "openssh_key_v1_scan", c, 0, 0);
+
+        if (e == SUCCESS)
+            opensshkey_wipe(&scanned);
+        freeopensshkey(parsed);
+    }
+
+    return fails;
+}
+
+/* files written back from a parsed key are the ones ssh-keygen writes, byte for
+   byte, once the checkint is the same. it follows the public key, which is the
+   fourth string after the magic, and the length of the private section */
+static int selftest_serialize (FILE *out)
+{
+    static char text[SELFTEST_KEYFILE_TEXT], work[SELFTEST_KEYFILE_TEXT];
+    static char written[OPENSSH_SERIALIZE_TEXT_MAXLEN];
+    struct opensshkey key;
+    size_t len, decoded, nkeys, writtenlen, off;
+    int fails = 0, e;
+
+    selftest_state = SELFTEST_SEED;
+    for (unsigned long c = 0; c < SELFTEST_SERIALIZE_CASES; c++) {
+        len = selftest_keyfile(text, SELFTEST_KEY_INTACT);
+        memcpy(work, text, len);
+        if ((e = openssh_key_v1_unarmor((unsigned char *)work, len, &decoded)) != SUCCESS ||
+            (e = openssh_key_v1_scan((unsigned char *)work, decoded, NULL, &key, 1, &nkeys)) != SUCCESS) {
+                selftest_fail(out, &fails, "serialize", "openssh_key_v1_scan", c, SUCCESS, e);
+                continue;
+            }
+
+        off = OPENSSH_KEY_V1_MAGICBYTES_LEN;
+        for (int i = 0; i < 3; i++)
+            off += 4 + decode_uint32((unsigned char *)work + off);
+        off += 4;
+        off += 4 + decode_uint32((unsigned char *)work + off) + 4;
+
+        e = openssh_key_v1_serialize(&key, decode_uint32((unsigned char *)work + off),
+                                     written, sizeof written, &writtenlen);
+        if (e != SUCCESS || writtenlen != len || memcmp(written, text, len) != 0)
+            selftest_fail(out, &fails, "serialize", "openssh_key_v1_serialize", c, SUCCESS, e);
+        opensshkey_wipe(&key);
+    }
+
+    return fails;
+}
+
+static void selftest_parse_public (const char *text, size_t len)
+{
+    static struct openssh_key_entry entries[1];
+    struct openssh_key_v1_public pub;
+    struct buffer *buf;
+
+    if (buffer_new_from_data(&buf, text, len) != SUCCESS)
+        return;
+    openssh_key_v1_public(buf, &pub, entries, 1);
+    freebuffer(buf);
+}
+
+/* push a key file in chunks ending at the given split points, stopping at the first error */
+static int selftest_stream_push (const char *text, size_t len, const size_t *splits, size_t nsplits,
+                                 struct opensshkey *key, size_t *nkeys)
+{
+    struct openssh_key_v1_stream stream;
+    size_t from = 0, to;
+    int e;
+
+    if ((e = openssh_key_v1_stream_init(&stream, NULL, key, 1)) != SUCCESS)
+        return e;
+    for (size_t i = 0; i <= nsplits && e == SUCCESS; i++) {
+        to = i < nsplits ? splits[i] : len;
+        e = openssh_key_v1_stream_push(&stream, text + from, to - from);
+        from = to;
+    }
+    if (e == SUCCESS)
+        e = openssh_key_v1_stream_final(&stream, nkeys);
+    openssh_key_v1_stream_free(&stream);
+    return e;
+}
+
+/* the push parser against the batch parser, split once at every position and
+   several times at random ones. files damaged twice may fail early on the
+   second defect, but then for every split alike */
+static int selftest_stream (FILE *out)
+{
+    static char text[SELFTEST_KEYFILE_TEXT], work[SELFTEST_KEYFILE_TEXT];
+    struct opensshkey want, got;
+    size_t len, decoded, nwant, ngot, splits[8];
+    int fails = 0, ewant, egot, efirst = SUCCESS, single;
+
+    selftest_state = SELFTEST_SEED;
+    for (unsigned long c = 0; c < SELFTEST_STREAM_CASES; c++) {
+        len = selftest_keyfile(text, c % 3);
+        single = c % 3 == 0 || c / 3 % 4 == 0;
+
+        /* damage the text as well: a bad character, a cut, a lost end marker */
+        switch (c / 3 % 4) {
+            case 1: text[OPENSSH_KEY_V1_MARK_BEGIN_LEN + rndn(len - OPENSSH_KEY_V1_MARK_BEGIN_LEN)] = '*'; break;
+            case 2: len = rndn(len); break;
+            case 3: len -= OPENSSH_KEY_V1_MARK_END_LEN - rndn(3); break;
+        }
+
+        memcpy(work, text, len);
+        if ((ewant = openssh_key_v1_unarmor((unsigned char *)work, len, &decoded)) == SUCCESS)
+            ewant = openssh_key_v1_scan((unsigned char *)work, decoded, NULL, &want, 1, &nwant);
+
+        for (size_t at = 0; at <= len + 1; at++) {
+            size_t nsplits = 1;
+            splits[0] = at;
+            /* the last round splits everywhere at random */
+            if (at == len + 1)
+                for (nsplits = 0; nsplits < sizeof splits / sizeof *splits; nsplits++)
+                    splits[nsplits] = (nsplits > 0 ? splits[nsplits - 1] : 0) + rndn(len / 4 + 1);
+            for (size_t i = 0; i < nsplits; i++)
+                if (splits[i] > len)
+                    splits[i] = len;
+
+            egot = selftest_stream_push(text, len, splits, nsplits, &got, &ngot);
+            if (at == 0)
+                efirst = egot;
+            if (egot != (single ? ewant : efirst))
+                selftest_fail(out, &fails, "stream", "openssh_key_v1_stream", c, ewant, egot);
+            else if (egot == SUCCESS && !selftest_samekey(&want, &got))
+                selftest_fail(out, &fails, "stream", "openssh_key_v1_stream", c, 0, 0);
+            if (egot == SUCCESS)
+                opensshkey_wipe(&got);
+        }
+        if (ewant == SUCCESS)
+            opensshkey_wipe(&want);
+    }
+
+    return fails;
+}
+
+/* one round of each parser for the benchmark, the text is copied first since
+   it is decoded in place */
+static void selftest_parse_buffered (const char *text, size_t len)
+{
+    struct opensshkey *parsed = NULL;
+    struct buffer *buf;
+
+    if (buffer_new_from_data(&buf, text, len) != SUCCESS)
+        return;
+    openssh_key_v1_parse(buf, NULL, &parsed);
+    freebuffer(buf);
+    freeopensshkey(parsed);
+}
+
+#ifndef STATIC_STORAGE
+/* the same, next to the copies the parser made before it worked in place: the
+   text in a buffer of its own and one more which it is decoded in */
+static void selftest_parse_copied (const char *text, size_t len)
+{
+    struct buffer *encoded, *decoded;
+    unsigned char *p;
+    size_t n;
+
+    if (buffer_new_from_data(&encoded, text, len) != SUCCESS)
+        return;
+    if ((decoded = newbuffer()) != NULL && buffer_reserve(decoded, len, &p) == SUCCESS) {
+        memcpy(p, text, len);
+        if (openssh_key_v1_unarmor(p, len, &n) == SUCCESS)
+            selftest_parse_buffered(text, len);
+    }
+    freebuffer(decoded);
+    freebuffer(encoded);
+}
+#endif
+
+static void selftest_parse_scan (const char *text, size_t len)
+{
+    static unsigned char work[SELFTEST_KEYFILE_TEXT];
+    static struct opensshkey scanned;
+    size_t decoded, nkeys;
+
+    memcpy(work, text, len);
+    if (openssh_key_v1_unarmor(work, len, &decoded) == SUCCESS &&
+        openssh_key_v1_scan(work, decoded, NULL, &scanned, 1, &nkeys) == SUCCESS)
+            opensshkey_wipe(&scanned);
+}
+
+
+/* +---------------------+ */
+/* | differential run    | */
+/* +---------------------+ */
+
+int selftest_run (FILE *out)
+{
+    const char *kernel;
+    int fails, total = 0;
+
+    cpu_dispatch();
+
+    for (size_t i = 0; (kernel = b64_kernels_list(i)) != NULL; i++) {
+        if (b64_kernels_select(kernel) != 0) {
+            fprintf(out, "base64 %-11s skipped, not enabled on this cpu\n", kernel);
+            continue;
+        }
+        fails = selftest_base64(out, kernel);
+        fprintf(out, "base64 %-11s %6d cases, %s\n", kernel, SELFTEST_BASE64_CASES, fails ? "FAILED" : "ok");
+        total += fails;
+    }
+
+    for (size_t i = 0; (kernel = sha256_kernels_list(i)) != NULL; i++) {
+        if (sha256_kernels_select(kernel) != 0) {
+            fprintf(out, "sha256 %-11s skipped, not enabled on this cpu\n", kernel);
+            continue;
+        }
+        fails = selftest_sha256(out, kernel);
+        fprintf(out, "sha256 %-11s %6d cases, %s\n", kernel, SELFTEST_SHA256_CASES, fails ? "FAILED" : "ok");
+        total += fails;
+    }
+
+    for (size_t i = 0; (kernel = aes_kernels_list(i)) != NULL; i++) {
+        if (aes_kernels_select(kernel) != 0) {
+            fprintf(out, "aes    %-11s skipped, not enabled on this cpu\n", kernel);
+            continue;
+        }
+        fails = selftest_aes(out, kernel);
+        fprintf(out, "aes    %-11s %6d cases, %s\n", kernel, SELFTEST_AES_CASES, fails ? "FAILED" : "ok");
+        total += fails;
+    }
+
+    fails = selftest_kdf(out);
+    fprintf(out, "%-18s known answers and threads, %s\n", "bcrypt_pbkdf", fails ? "FAILED" : "ok");
+    total += fails;
+
+    fails = selftest_ed25519(out);
+    fprintf(out, "%-18s %6d cases and known answers, %s\n", "ed25519", SELFTEST_ED25519_CASES, fails ? "FAILED" : "ok");
+    total += fails;
+
+    fails = selftest_p256(out);
+    fprintf(out, "%-18s %6d cases and known answers, %s\n", "nistp256", SELFTEST_P256_CASES, fails ? "FAILED" : "ok");
+    total += fails;
+
+    fails = selftest_keytypes(out);
+    fprintf(out, "%-18s %6d names in a perfect hash, %s\n", "keytypes", KEYTYPE_COUNT, fails ? "FAILED" : "ok");
+    total += fails;
+
+    fails = selftest_hosts(out);
+    fprintf(out, "%-18s %6d comments, %s\n", "known_hosts", (int)SELFTEST_HOSTS_CASES, fails ? "FAILED" : "ok");
+    total += fails;
+
+    fails = selftest_parse(out);
+    fprintf(out, "%-18s %6d cases, %s\n", "openssh-key-v1", SELFTEST_PARSE_CASES, fails ? "FAILED" : "ok");
+    total += fails;
+
+    fails = selftest_stream(out);
+    fprintf(out, "%-18s %6d cases split everywhere, %s\n", "  stream", SELFTEST_STREAM_CASES, fails ? "FAILED" : "ok");
+    total += fails;
+
+    fails = selftest_serialize(out);
+    fprintf(out, "%-18s %6d cases written back, %s\n", "  serialize", SELFTEST_SERIALIZE_CASES, fails ? "FAILED" : "ok");
+    total += fails;
+
+    /* back to the kernels chosen for this cpu */
+    cpu_dispatch();
+    return total == 0 ? SUCCESS : ERR_SELFTEST;
+}
+
+
+/* +---------------------+ */
+/* | throughput          | */
+/* +---------------------+ */
+
+/* 64 KiB of data, its encoding in one line and wrapped like a key file */
+#define SELFTEST_BENCH_DATA  ( 64 * 1024 )
+#define SELFTEST_BENCH_TEXT  ( (SELFTEST_BENCH_DATA + 2) / 3 * 4 + 1 )
+#define SELFTEST_BENCH_WRAP  70
+
+/* peak resident set in KiB of a child which runs work once, or does nothing
+   for NULL, so that its pages are those of this process plus what work adds */
+static long selftest_child_maxrss (void (*work) (const char *, size_t), const char *text, size_t len)
+{
+    struct rusage usage;
+    int status;
+    pid_t pid;
+
+    fflush(NULL);
+    if ((pid = fork()) < 0)
+        return -1;
+    if (pid == 0) {
+        if (work != NULL)
+            work(text, len);
+        _exit(0);
+    }
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status))
+        return -1;
+    return usage.ru_maxrss;
+}
+
+int selftest_bench (FILE *out)
+{
+    static unsigned char data[SELFTEST_BENCH_DATA], dst[SELFTEST_BENCH_DATA];
+    static char text[SELFTEST_BENCH_TEXT], wrapped[SELFTEST_BENCH_TEXT + SELFTEST_BENCH_TEXT / SELFTEST_BENCH_WRAP + 1];
+    static char encoded[SELFTEST_BENCH_TEXT], keyfile[SELFTEST_BENCH_KEYFILE_TEXT];
+    const unsigned char *msgs[64];
+    size_t lens[64], textlen, w = 0;
+    unsigned char digests[64][SHA256_DIGEST_SIZE], iv[AES_BLOCK_SIZE] = { 0 };
+    struct aes_key key;
+    struct buffer_pool_stats pool_before, pool_after;
+    double decode, decode_wrapped, encode, bulk, single, batch;
+    long idle, converted;
+#ifndef STATIC_STORAGE
+    long copied;
+#endif
+    const char *kernel;
+
+    /* the memory of converting one key file in place and with copies of it,
+       before the buffers below are touched and counted in the children as well */
+    selftest_state = SELFTEST_SEED;
+    textlen = selftest_keyfile_sized(keyfile, SELFTEST_KEY_INTACT, SELFTEST_BENCH_COMMENT);
+    idle = selftest_child_maxrss(NULL, keyfile, textlen);
+    converted = selftest_child_maxrss(selftest_parse_buffered, keyfile, textlen);
+    fprintf(out, "%-18s %12s %12s %12s   (KiB, ru_maxrss of a child, %zu byte key file)\n",
+        "peak rss", "idle", "key file", "added", textlen);
+    fprintf(out, "  %-16s %12ld %12ld %12ld\n", "in place", idle, converted, converted - idle);
+#ifndef STATIC_STORAGE
+    copied = selftest_child_maxrss(selftest_parse_copied, keyfile, textlen);
+    fprintf(out, "  %-16s %12ld %12ld %12ld\n", "copying", idle, copied, copied - idle);
+#endif
+
+    selftest_state = SELFTEST_SEED;
+    for (size_t i = 0; i < sizeof data; i++)
+        data[i] = rnd();
+    textlen = ref_b64_ntop(data, sizeof data, text, sizeof text);
+    for (size_t i = 0; i < textlen; i++) {
+        if (i > 0 && i % SELFTEST_BENCH_WRAP == 0)
+            wrapped[w++] = '\n';
+        wrapped[w++] = text[i];
+    }
+    wrapped[w] = '\0';
+
+    fprintf(out, "%-18s %12s %12s %12s   (MB/s of decoded data, %d KiB)\n",
+        "base64", "decode", "wrapped", "encode", SELFTEST_BENCH_DATA / 1024);
+
+    SELFTEST_MBPS(decode,         sizeof data, ref_b64_pton(text,    dst, sizeof dst));
+    SELFTEST_MBPS(decode_wrapped, sizeof data, ref_b64_pton(wrapped, dst, sizeof dst));
+    SELFTEST_MBPS(encode,         sizeof data, ref_b64_ntop(data, sizeof data, encoded, sizeof encoded));
+    fprintf(out, "%-18s %12.0f %12.0f %12.0f\n", "  reference", decode, decode_wrapped, encode);
+
+    for (size_t i = 0; (kernel = b64_kernels_list(i)) != NULL; i++) {
+        if (b64_kernels_select(kernel) != 0)
+            continue;
+        SELFTEST_MBPS(decode,         sizeof data, b64_pton(text,    dst, sizeof dst));
+        SELFTEST_MBPS(decode_wrapped, sizeof data, b64_pton(wrapped, dst, sizeof dst));
+        SELFTEST_MBPS(encode,         sizeof data, b64_ntop(data, sizeof data, encoded, sizeof encoded));
+        fprintf(out, "  %-16s %12.0f %12.0f %12.0f\n", kernel, decode, decode_wrapped, encode);
+    }
+
+    /* public key blobs are 51 bytes */
+    for (size_t i = 0; i < 64; i++) {
+        msgs[i] = data + 51 * i;
+        lens[i] = 51;
+    }
+
+    fprintf(out, "%-18s %12s %12s %12s   (MB/s, ns per public key blob)\n",
+        "sha256", "64 KiB", "blob", "blob batch");
+    for (size_t i = 0; (kernel = sha256_kernels_list(i)) != NULL; i++) {
+        if (sha256_kernels_select(kernel) != 0)
+            continue;
+        SELFTEST_MBPS(bulk,   sizeof data, sha256(data, sizeof data, digests[0]));
+        /* with a million bytes per round the rate is in rounds per second */
+        SELFTEST_MBPS(single, 1e6,         sha256(data, 51, digests[0]));
+        SELFTEST_MBPS(batch,  64e6,        sha256_batch(msgs, lens, 64, digests));
+        fprintf(out, "  %-16s %12.0f %12.1f %12.1f\n", kernel, bulk, 1e9 / single, 1e9 / batch);
+    }
+
+    /* aes256 on the whole buffer, private sections are far smaller but
+       this shows the cost per byte */
+    fprintf(out, "%-18s %12s %12s %12s   (MB/s, aes256)\n", "aes", "ctr", "cbc decrypt", "");
+    aes_setkey(&key, data, 32);
+    for (size_t i = 0; (kernel = aes_kernels_list(i)) != NULL; i++) {
+        if (aes_kernels_select(kernel) != 0)
+            continue;
+        SELFTEST_MBPS(bulk,   sizeof dst, aes_ctr(&key, iv, dst, sizeof dst));
+        SELFTEST_MBPS(single, sizeof dst, aes_cbc_decrypt(&key, iv, dst, sizeof dst / AES_BLOCK_SIZE));
+        fprintf(out, "  %-16s %12.0f %12.0f\n", kernel, bulk, single);
+    }
+    aes_clearkey(&key);
+
+    /* unlocking a key as written by ssh-keygen: aes256-ctr key and iv with 16 rounds */
+    fprintf(out, "%-18s %12s %12s %12s   (ms per 48 byte key, 16 rounds)\n",
+        "bcrypt_pbkdf", "1 thread", "threads", "");
+    bcrypt_pbkdf_set_threads(1);
+    SELFTEST_MBPS(single, 1e6, bcrypt_pbkdf("selftest", 8, data, 16, dst, 48, 16));
+    bcrypt_pbkdf_set_threads(0);
+    SELFTEST_MBPS(batch,  1e6, bcrypt_pbkdf("selftest", 8, data, 16, dst, 48, 16));
+    fprintf(out, "  %-16s %12.1f %12.1f\n", "portable", 1e3 / single, 1e3 / batch);
+
+    /* deriving public keys for --verify, the table is built before */
+    fprintf(out, "%-18s %12s %12s %12s   (us per public key)\n", "ed25519", "1 key", "batch", "");
+    ed25519_init();
+    for (size_t i = 0; i < ED25519_BATCH; i++)
+        msgs[i] = data + ED25519_SEED_SIZE * i;
+    SELFTEST_MBPS(single, 1e6, ed25519_public_batch(msgs, 1, (unsigned char (*)[ED25519_PUBLIC_SIZE])dst));
+    SELFTEST_MBPS(batch,  ED25519_BATCH * 1e6, ed25519_public_batch(msgs, ED25519_BATCH, (unsigned char (*)[ED25519_PUBLIC_SIZE])dst));
+    fprintf(out, "  %-16s %12.1f %12.1f\n", "portable", 1e6 / single, 1e6 / batch);
+
+    /* the same for nistp256 keys, one ladder per key */
+    fprintf(out, "%-18s %12s %12s %12s   (us per public key)\n", "nistp256", "1 key", "", "");
+    memset(dst, 0, P256_SCALAR_SIZE);
+    dst[P256_SCALAR_SIZE - 1] = 7;
+    SELFTEST_MBPS(single, 1e6, p256_public(dst, dst + P256_SCALAR_SIZE));
+    fprintf(out, "  %-16s %12.1f\n", "portable", 1e6 / single);
+
+    /* a whole unencrypted key file, from armored text to the deserialized key */
+    fprintf(out, "%-18s %12s %12s %12s   (ns per ed25519 key file)\n",
+        "openssh-key-v1", "buffered", "scan", "public only");
+    cpu_dispatch();
+    textlen = selftest_keyfile(text, SELFTEST_KEY_INTACT);
+    buffer_pool_get_stats(&pool_before);
+    SELFTEST_MBPS(single, 1e6, selftest_parse_buffered(text, textlen));
+    buffer_pool_get_stats(&pool_after);
+    SELFTEST_MBPS(batch,  1e6, selftest_parse_scan(text, textlen));
+    SELFTEST_MBPS(bulk,   1e6, selftest_parse_public(text, textlen));
+    fprintf(out, "  %-16s %12.1f %12.1f %12.1f\n", "selected", 1e9 / single, 1e9 / batch, 1e9 / bulk);
+
+    /* the buffers of the buffered parses above, which the pool of this thread recycles */
+    fprintf(out, "%-18s %12s %12s %12s   (buffered key files)\n", "buffer pool", "hits", "misses", "peak KiB");
+    fprintf(out, "  %-16s %12lu %12lu %12.1f\n", "per thread",
+        pool_after.hits - pool_before.hits, pool_after.misses - pool_before.misses,
+        pool_after.peak_bytes / 1024.0);
+
+    cpu_dispatch();
+    return SUCCESS;
+}
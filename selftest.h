@@ -0,0 +1,36 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_selftest_h_
+#define _headerguard_selftest_h_
+
+#include <stdio.h>
+
+#include "errors.h"
+
+/****************************************************************************************/
+
+/* randomised cases per kernel, the generator is seeded identically for every kernel */
+#define SELFTEST_BASE64_CASES 20000
+#define SELFTEST_SHA256_CASES 4000
+#define SELFTEST_AES_CASES    1000
+#define SELFTEST_PARSE_CASES  300
+#define SELFTEST_STREAM_CASES 36
+#define SELFTEST_SERIALIZE_CASES 300
+
+/* every measurement runs for at least this long */
+#define SELFTEST_BENCH_SECONDS 0.2
+
+/****************************************************************************************/
+
+/* run every kernel this cpu can execute against the reference code,
+   returns SUCCESS or ERR_SELFTEST if any output differed */
+int selftest_run (FILE *out);
+
+/* throughput of every kernel and the reference code on the same data */
+int selftest_bench (FILE *out);
+
+#endif
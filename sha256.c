@@ -0,0 +1,433 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ *
+ * SHA-256 as specified in FIPS 180-4. The SHA-NI kernel follows the
+ * reference code in Intel's "New Instructions Supporting the Secure Hash
+ * Algorithm on Intel Architecture Processors" (2013), the ARMv8 kernel the
+ * sequence given in the ARM Cryptography Extension documentation.
+ */
+
+#include <string.h>
+
+#include "sha256.h"
+#include "cpufeatures.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define SHA256_X86_KERNELS
+# include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+# define SHA256_ARM_KERNELS
+# include <arm_neon.h>
+#endif
+
+/* signatures of the compression kernels, nblocks whole blocks of data */
+typedef void (*sha256_blocks_fn)    (uint32_t state[8], const unsigned char *data, size_t nblocks);
+typedef void (*sha256_blocks_x2_fn) (uint32_t sa[8], uint32_t sb[8], const unsigned char *a, const unsigned char *b);
+
+/* selected kernels, resolved on first use */
+static sha256_blocks_fn    sha256_blocks_kernel = NULL;
+static sha256_blocks_x2_fn sha256_blocks_x2_kernel = NULL;
+static const char *sha256_kernel_label = NULL;
+
+static const uint32_t sha256_initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+
+/* +-----------------+ */
+/* | portable kernel | */
+/* +-----------------+ */
+
+#define ROTR(x, n) ((x) >> (n) | (x) << (32 - (n)))
+
+static void sha256_blocks_portable (uint32_t state[8], const unsigned char *data, size_t nblocks)
+{
+    uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+
+    while (nblocks-- > 0) {
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)data[4 * i] << 24 | (uint32_t)data[4 * i + 1] << 16 |
+                   (uint32_t)data[4 * i + 2] << 8 | data[4 * i + 3];
+        for (int i = 16; i < 64; i++)
+            w[i] = w[i - 16] + w[i - 7] +
+                   (ROTR(w[i - 15],  7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >>  3)) +
+                   (ROTR(w[i -  2], 17) ^ ROTR(w[i -  2], 19) ^ (w[i -  2] >> 10));
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+        for (int i = 0; i < 64; i++) {
+            t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + (g ^ (e & (f ^ g))) + sha256_k[i] + w[i];
+            t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) | (c & (a | b)));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+        data += SHA256_BLOCK_SIZE;
+    }
+}
+
+#undef ROTR
+
+/* without interleaving hardware, two messages are simply hashed in turn */
+static void sha256_blocks_x2_serial (uint32_t sa[8], uint32_t sb[8], const unsigned char *a, const unsigned char *b)
+{
+    sha256_blocks_kernel(sa, a, 1);
+    sha256_blocks_kernel(sb, b, 1);
+}
+
+
+#ifdef SHA256_X86_KERNELS
+
+/* +----------------+ */
+/* | x86 sha kernel | */
+/* +----------------+ */
+
+/* the instructions keep the state as ABEF and CDGH */
+#define SHA256_NI_LOAD(state, abef, cdgh) do {                                  \
+    __m128i dcba_ = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state)), 0xb1); \
+    __m128i efgh_ = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)(state) + 1), 0x1b); \
+    abef = _mm_alignr_epi8(dcba_, efgh_, 8);                                    \
+    cdgh = _mm_blend_epi16(efgh_, dcba_, 0xf0);                                 \
+} while (0)
+
+#define SHA256_NI_STORE(state, abef, cdgh) do {                                 \
+    __m128i feba_ = _mm_shuffle_epi32(abef, 0x1b);                              \
+    __m128i dchg_ = _mm_shuffle_epi32(cdgh, 0xb1);                              \
+    _mm_storeu_si128((__m128i *)(state), _mm_blend_epi16(feba_, dchg_, 0xf0));  \
+    _mm_storeu_si128((__m128i *)(state) + 1, _mm_alignr_epi8(dchg_, feba_, 8)); \
+} while (0)
+
+/* load one block as four big endian message vectors */
+__attribute__((target("sha,sse4.1,ssse3"), always_inline))
+static inline void sha256_ni_message (__m128i m[4], const unsigned char *data)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    for (int i = 0; i < 4; i++)
+        m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data + i), bswap);
+}
+
+/* four rounds, expanding the message schedule from the fourth group on.
+   m[g & 3] holds w(g - 4) and is replaced by w(g) */
+__attribute__((target("sha,sse4.1,ssse3"), always_inline))
+static inline void sha256_ni_rounds (__m128i m[4], int g, __m128i *abef, __m128i *cdgh)
+{
+    __m128i msg;
+
+    if (g >= 4)
+        m[g & 3] = _mm_sha256msg2_epu32(
+            _mm_add_epi32(_mm_sha256msg1_epu32(m[g & 3], m[(g + 1) & 3]),
+                          _mm_alignr_epi8(m[(g + 3) & 3], m[(g + 2) & 3], 4)),
+            m[(g + 3) & 3]);
+
+    msg = _mm_add_epi32(m[g & 3], _mm_load_si128((const __m128i *)sha256_k + g));
+    *cdgh = _mm_sha256rnds2_epu32(*cdgh, *abef, msg);
+    *abef = _mm_sha256rnds2_epu32(*abef, *cdgh, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_blocks_shani (uint32_t state[8], const unsigned char *data, size_t nblocks)
+{
+    __m128i abef, cdgh, abef_save, cdgh_save, m[4];
+
+    SHA256_NI_LOAD(state, abef, cdgh);
+    while (nblocks-- > 0) {
+        abef_save = abef;
+        cdgh_save = cdgh;
+
+        sha256_ni_message(m, data);
+#pragma GCC unroll 16
+        for (int g = 0; g < 16; g++)
+            sha256_ni_rounds(m, g, &abef, &cdgh);
+
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+        data += SHA256_BLOCK_SIZE;
+    }
+    SHA256_NI_STORE(state, abef, cdgh);
+}
+
+/* the rounds are a long dependency chain, so two independent
+   blocks side by side keep the sha unit busy */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_blocks_x2_shani (uint32_t sa[8], uint32_t sb[8], const unsigned char *a, const unsigned char *b)
+{
+    __m128i abef_a, cdgh_a, abef_b, cdgh_b, ma[4], mb[4];
+    __m128i abef_a_save, cdgh_a_save, abef_b_save, cdgh_b_save;
+
+    SHA256_NI_LOAD(sa, abef_a, cdgh_a);
+    SHA256_NI_LOAD(sb, abef_b, cdgh_b);
+    abef_a_save = abef_a; cdgh_a_save = cdgh_a;
+    abef_b_save = abef_b; cdgh_b_save = cdgh_b;
+
+    sha256_ni_message(ma, a);
+    sha256_ni_message(mb, b);
+#pragma GCC unroll 16
+    for (int g = 0; g < 16; g++) {
+        sha256_ni_rounds(ma, g, &abef_a, &cdgh_a);
+        sha256_ni_rounds(mb, g, &abef_b, &cdgh_b);
+    }
+
+    abef_a = _mm_add_epi32(abef_a, abef_a_save); cdgh_a = _mm_add_epi32(cdgh_a, cdgh_a_save);
+    abef_b = _mm_add_epi32(abef_b, abef_b_save); cdgh_b = _mm_add_epi32(cdgh_b, cdgh_b_save);
+    SHA256_NI_STORE(sa, abef_a, cdgh_a);
+    SHA256_NI_STORE(sb, abef_b, cdgh_b);
+}
+
+#undef SHA256_NI_LOAD
+#undef SHA256_NI_STORE
+
+#endif /* SHA256_X86_KERNELS */
+
+
+#ifdef SHA256_ARM_KERNELS
+
+/* +------------------+ */
+/* | armv8 sha kernel | */
+/* +------------------+ */
+
+/* load one block as four big endian message vectors */
+__attribute__((target("arch=armv8-a+crypto"), always_inline))
+static inline void sha256_armv8_message (uint32x4_t m[4], const unsigned char *data)
+{
+    for (int i = 0; i < 4; i++)
+        m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+}
+
+/* four rounds, m[g & 3] holds w(g - 4) and is replaced by w(g) */
+__attribute__((target("arch=armv8-a+crypto"), always_inline))
+static inline void sha256_armv8_rounds (uint32x4_t m[4], int g, uint32x4_t *abcd, uint32x4_t *efgh)
+{
+    uint32x4_t msg, abcd_prev;
+
+    if (g >= 4)
+        m[g & 3] = vsha256su1q_u32(vsha256su0q_u32(m[g & 3], m[(g + 1) & 3]), m[(g + 2) & 3], m[(g + 3) & 3]);
+
+    msg = vaddq_u32(m[g & 3], vld1q_u32(sha256_k + 4 * g));
+    abcd_prev = *abcd;
+    *abcd = vsha256hq_u32(*abcd, *efgh, msg);
+    *efgh = vsha256h2q_u32(*efgh, abcd_prev, msg);
+}
+
+__attribute__((target("arch=armv8-a+crypto")))
+static void sha256_blocks_armv8 (uint32_t state[8], const unsigned char *data, size_t nblocks)
+{
+    uint32x4_t abcd = vld1q_u32(state), efgh = vld1q_u32(state + 4);
+    uint32x4_t abcd_save, efgh_save, m[4];
+
+    while (nblocks-- > 0) {
+        abcd_save = abcd;
+        efgh_save = efgh;
+
+        sha256_armv8_message(m, data);
+#pragma GCC unroll 16
+        for (int g = 0; g < 16; g++)
+            sha256_armv8_rounds(m, g, &abcd, &efgh);
+
+        abcd = vaddq_u32(abcd, abcd_save);
+        efgh = vaddq_u32(efgh, efgh_save);
+        data += SHA256_BLOCK_SIZE;
+    }
+    vst1q_u32(state, abcd);
+    vst1q_u32(state + 4, efgh);
+}
+
+__attribute__((target("arch=armv8-a+crypto")))
+static void sha256_blocks_x2_armv8 (uint32_t sa[8], uint32_t sb[8], const unsigned char *a, const unsigned char *b)
+{
+    uint32x4_t abcd_a = vld1q_u32(sa), efgh_a = vld1q_u32(sa + 4);
+    uint32x4_t abcd_b = vld1q_u32(sb), efgh_b = vld1q_u32(sb + 4);
+    uint32x4_t ma[4], mb[4];
+
+    sha256_armv8_message(ma, a);
+    sha256_armv8_message(mb, b);
+#pragma GCC unroll 16
+    for (int g = 0; g < 16; g++) {
+        sha256_armv8_rounds(ma, g, &abcd_a, &efgh_a);
+        sha256_armv8_rounds(mb, g, &abcd_b, &efgh_b);
+    }
+
+    vst1q_u32(sa,     vaddq_u32(abcd_a, vld1q_u32(sa)));
+    vst1q_u32(sa + 4, vaddq_u32(efgh_a, vld1q_u32(sa + 4)));
+    vst1q_u32(sb,     vaddq_u32(abcd_b, vld1q_u32(sb)));
+    vst1q_u32(sb + 4, vaddq_u32(efgh_b, vld1q_u32(sb + 4)));
+}
+
+#endif /* SHA256_ARM_KERNELS */
+
+
+/* +----------+ */
+/* | dispatch | */
+/* +----------+ */
+
+/* all kernels, hardware first, with the cpu features each one uses */
+static const struct {
+    const char *name;
+    unsigned int features;
+    sha256_blocks_fn blocks;
+    sha256_blocks_x2_fn blocks_x2;
+} sha256_kernels[] = {
+#ifdef SHA256_X86_KERNELS
+    { "sha-ni",     CPU_MASK(CPU_SHA) | CPU_MASK(CPU_SSE41) | CPU_MASK(CPU_SSSE3),
+                    sha256_blocks_shani,    sha256_blocks_x2_shani  },
+#endif
+#ifdef SHA256_ARM_KERNELS
+    { "armv8-sha2", CPU_MASK(CPU_ARM_SHA2),
+                    sha256_blocks_armv8,    sha256_blocks_x2_armv8  },
+#endif
+    { "portable",   0,
+                    sha256_blocks_portable, sha256_blocks_x2_serial },
+};
+#define n_sha256_kernels (sizeof sha256_kernels / sizeof *sha256_kernels)
+
+static void sha256_kernels_install (size_t i)
+{
+    sha256_kernel_label = sha256_kernels[i].name;
+    sha256_blocks_kernel = sha256_kernels[i].blocks;
+    sha256_blocks_x2_kernel = sha256_kernels[i].blocks_x2;
+}
+
+/* pick the hardware kernels if the enabled cpu features allow, portable needs none */
+void sha256_kernels_resolve ()
+{
+    size_t i = 0;
+    while ((sha256_kernels[i].features & ~cpu_features()) != 0)
+        i++;
+    sha256_kernels_install(i);
+}
+
+/* install kernels by name, if the enabled cpu features allow them */
+int sha256_kernels_select (const char *name)
+{
+    for (size_t i = 0; i < n_sha256_kernels; i++)
+        if (strcmp(sha256_kernels[i].name, name) == 0) {
+            if ((sha256_kernels[i].features & ~cpu_features()) != 0)
+                return -1;
+            sha256_kernels_install(i);
+            return 0;
+        }
+    return -1;
+}
+
+const char *sha256_kernels_list (size_t i)
+{
+    return i < n_sha256_kernels ? sha256_kernels[i].name : NULL;
+}
+
+const char *sha256_kernel_name ()
+{
+    if (sha256_kernel_label == NULL)
+        sha256_kernels_resolve();
+    return sha256_kernel_label;
+}
+
+
+/* +---------+ */
+/* | hashing | */
+/* +---------+ */
+
+/* a message in progress, whole blocks are read in place and the
+   rest is padded in tail, which holds one or two blocks */
+struct sha256_message {
+    uint32_t state[8];
+    const unsigned char *data;
+    size_t nblocks, ntail;
+    unsigned char tail[2 * SHA256_BLOCK_SIZE];
+};
+
+static void sha256_message_init (struct sha256_message *m, const unsigned char *msg, size_t len)
+{
+    size_t rest = len % SHA256_BLOCK_SIZE;
+    uint64_t bits = (uint64_t)len * 8;
+
+    memcpy(m->state, sha256_initial_state, sizeof m->state);
+    m->data = msg;
+    m->nblocks = len / SHA256_BLOCK_SIZE;
+    m->ntail = rest + 9 > SHA256_BLOCK_SIZE ? 2 : 1;
+
+    /* message end, a one bit, zeros and the big endian bit length */
+    memset(m->tail, 0, sizeof m->tail);
+    if (rest > 0)
+        memcpy(m->tail, msg + len - rest, rest);
+    m->tail[rest] = 0x80;
+    for (int i = 0; i < 8; i++)
+        m->tail[m->ntail * SHA256_BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+}
+
+static inline const unsigned char *sha256_message_block (const struct sha256_message *m, size_t i)
+{
+    return i < m->nblocks ? m->data + i * SHA256_BLOCK_SIZE : m->tail + (i - m->nblocks) * SHA256_BLOCK_SIZE;
+}
+
+static void sha256_message_final (struct sha256_message *m, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i]     = m->state[i] >> 24;
+        digest[4 * i + 1] = m->state[i] >> 16;
+        digest[4 * i + 2] = m->state[i] >> 8;
+        digest[4 * i + 3] = m->state[i];
+    }
+    memset(m, 0, sizeof *m);
+}
+
+void sha256 (const unsigned char *msg, size_t len, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    struct sha256_message m;
+
+    if (sha256_blocks_kernel == NULL)
+        sha256_kernels_resolve();
+
+    sha256_message_init(&m, msg, len);
+    if (m.nblocks > 0)
+        sha256_blocks_kernel(m.state, m.data, m.nblocks);
+    sha256_blocks_kernel(m.state, m.tail, m.ntail);
+    sha256_message_final(&m, digest);
+}
+
+void sha256_batch (const unsigned char *const *msgs, const size_t *lens, size_t n,
+                   unsigned char (*digests)[SHA256_DIGEST_SIZE])
+{
+    struct sha256_message a, b;
+    size_t i, blocks_a, blocks_b, k;
+
+    if (sha256_blocks_kernel == NULL)
+        sha256_kernels_resolve();
+
+    /* pairs of messages, block by block side by side as long as both last */
+    for (i = 0; i + 1 < n; i += 2) {
+        sha256_message_init(&a, msgs[i], lens[i]);
+        sha256_message_init(&b, msgs[i + 1], lens[i + 1]);
+        blocks_a = a.nblocks + a.ntail;
+        blocks_b = b.nblocks + b.ntail;
+
+        for (k = 0; k < blocks_a && k < blocks_b; k++)
+            sha256_blocks_x2_kernel(a.state, b.state, sha256_message_block(&a, k), sha256_message_block(&b, k));
+        for (; k < blocks_a; k++)
+            sha256_blocks_kernel(a.state, sha256_message_block(&a, k), 1);
+        for (; k < blocks_b; k++)
+            sha256_blocks_kernel(b.state, sha256_message_block(&b, k), 1);
+
+        sha256_message_final(&a, digests[i]);
+        sha256_message_final(&b, digests[i + 1]);
+    }
+
+    /* odd one out */
+    if (i < n)
+        sha256(msgs[i], lens[i], digests[i]);
+}
@@ -0,0 +1,40 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_sha256_h_
+#define _headerguard_sha256_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/****************************************************************************************/
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE  64
+
+/****************************************************************************************/
+
+/* hash a single message */
+void sha256 (const unsigned char *msg, size_t len, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+/* hash n independent messages. two messages at a time are interleaved where the
+   hardware kernel benefits from it, so batches of short messages are much faster */
+void sha256_batch (const unsigned char *const *msgs, const size_t *lens, size_t n,
+                   unsigned char (*digests)[SHA256_DIGEST_SIZE]);
+
+/* select the kernels for the enabled cpu features, which otherwise happens on first use */
+void sha256_kernels_resolve ();
+
+/* force the named kernels, returns -1 if unknown or not allowed on this cpu */
+int sha256_kernels_select (const char *name);
+
+/* name of the i-th kernel built in, hardware first, NULL after the last */
+const char *sha256_kernels_list (size_t i);
+
+/* name of the compression kernel selected for this cpu */
+const char *sha256_kernel_name ();
+
+#endif
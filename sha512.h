@@ -0,0 +1,35 @@
+/*
+ * This file is governed by Licenses which are listed in
+ * the LICENSE file, which shall be included in all copies
+ * and redistributions of this project.
+ */
+
+#ifndef _headerguard_sha512_h_
+#define _headerguard_sha512_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/****************************************************************************************/
+
+#define SHA512_DIGEST_SIZE 64
+#define SHA512_BLOCK_SIZE  128
+
+/* state of an incremental hash */
+struct sha512_ctx {
+    uint64_t state[8];
+    uint64_t count;                             /* bytes hashed so far */
+    unsigned char block[SHA512_BLOCK_SIZE];     /* pending partial block */
+};
+
+/****************************************************************************************/
+
+/* incremental interface, final wipes the context */
+void sha512_init   (struct sha512_ctx *ctx);
+void sha512_update (struct sha512_ctx *ctx, const unsigned char *msg, size_t len);
+void sha512_final  (struct sha512_ctx *ctx, unsigned char digest[SHA512_DIGEST_SIZE]);
+
+/* hash a single message */
+void sha512 (const unsigned char *msg, size_t len, unsigned char digest[SHA512_DIGEST_SIZE]);
+
+#endif
@@ -5,7 +5,8 @@
  */
 
 /* collection of all following definitions */
-#define STATUSCODES(fn) MISC_STATUS(fn), BUFFER_STATUS(fn), FILEIO_STATUS(fn), OPENSSH_KEY_STATUS(fn), OPENSSH_PARSE_STATUS(fn)
+#define STATUSCODES(fn) MISC_STATUS(fn), BUFFER_STATUS(fn), FILEIO_STATUS(fn), OPENSSH_KEY_STATUS(fn), OPENSSH_PARSE_STATUS(fn), \
+                        LATER_STATUS(fn)
 
 /* general statuscodes */
 #define MISC_STATUS(fn) \
@@ -48,6 +49,19 @@
     fn( OPENSSH_PARSE_INVALID_PRIVATE_FORMAT,       The private key was malformed.                              ),\
     fn( OPENSSH_PARSE_UNSUPPORTED_CIPHER,           This encryption cipher is not supported.                    ),\
     fn( OPENSSH_PARSE_UNSUPPORTED_KDF,              This key derivation function is not supported.              ),\
-    fn( OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS,     Multiple keys in one file are not supported.                ),\
+    fn( OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS,     The file holds more keys than are supported.                ),\
     fn( OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE,         This keytype is not supported for parsing.                  ),\
     fn( OPENSSH_PARSE_INTERNAL_ERROR,               Internal error occured in a parsing function.               )
+
+/* statuscodes added after the groups above, which are also exit codes;
+   new ones only ever go at the end, so that existing codes keep their values */
+#define LATER_STATUS(fn) \
+    fn( ERR_SELFTEST,                       A cpu specific kernel disagreed with the reference. ),\
+    fn( FILEIO_PASSPHRASE_TOO_LONG,         The passphrase is too long.                         ),\
+    fn( OPENSSH_PARSE_INVALID_KDF_OPTIONS,  The key derivation options are invalid.             ),\
+    fn( OPENSSH_PARSE_PASSPHRASE_REQUIRED,  The key is encrypted but no passphrase was given.   ),\
+    fn( OPENSSH_PARSE_WRONG_PASSPHRASE,     The passphrase is incorrect.                        ),\
+    fn( FILEIO_CANNOT_CREATE_DIRECTORY,     Cannot create directory.                            ),\
+    fn( OPENSSH_KEY_INCONSISTENT,           The public key does not belong to the secret key.   ),\
+    fn( OPENSSH_KEY_COMMENT_TOO_LONG,       The key comment is longer than 1024 bytes.          ),\
+    fn( OPENSSH_KEY_INVALID_HOSTS,          The hosts for known_hosts are empty or malformed.   )
@@ -5,16 +5,47 @@
  */
 
  #define USAGE_MESSAGE \
-    "Usage: " PACKAGE_NAME " [-hv] [-f keyfile] [-d destination_dir]\n" \
-    "Convert an OpenSSH ed25510 privatekey file to TinySSH\n" \
-    "compatible format keys and save them in destination_dir."
+    "Usage: " PACKAGE_NAME " [-hv] [--cpu-features] [--self-test] [--benchmark] [--passphrase-fd fd]\n" \
+    "       " PACKAGE_NAME " [--verify] [-f keyfile] [-d destination_dir] [keyfile ...]\n" \
+    "       " PACKAGE_NAME " -a|-k|-l|-i [-H hosts] [-o output] [-f keyfile] [keyfile ...]\n" \
+    "       " PACKAGE_NAME " -p [-d destination_dir] [-f pubfile] [pubfile ...]\n" \
+    "       " PACKAGE_NAME " -r [-C comment] [-d destination_dir] [-f keydir] [keydir ...]\n" \
+    "Convert OpenSSH ed25519 or ecdsa nistp256 privatekey files to TinySSH\n" \
+    "compatible format keys and save them in destination_dir, where\n" \
+    "a key of each type has files of its own, so that both host keys\n" \
+    "are converted in one run.\n" \
+    "The keys of a single file with several go to destination_dir/0, /1 ...\n" \
+    "A keyfile - is a single key read from stdin as it arrives.\n" \
+    "With -a, -k or -l write authorized_keys or known_hosts lines\n" \
+    "or SHA256 fingerprints for all keyfiles to output instead.\n" \
+    "-i writes a line of cipher, kdf, rounds, number of keys and type and\n" \
+    "fingerprint of each key per keyfile, without decoding private keys.\n" \
+    "-p writes only ed25519.pk for each ed25519 key of .pub or authorized_keys\n" \
+    "files, to destination_dir or destination_dir/0, /1 ... for several.\n" \
+    "-r converts TinySSH keydirs back to OpenSSH " REVERSE_KEYFILE_NAME "\n" \
+    "files in destination_dir or destination_dir/0, /1 ... for several.\n" \
+    "--verify derives the public key of every key from its secret seed or scalar\n" \
+    "and rejects keys where it differs from one of the stored copies.\n" \
+    "--self-test checks the cpu specific kernels against reference code,\n" \
+    "--benchmark measures their throughput.\n" \
+    "Encrypted keys are unlocked with a passphrase read from fd or\n" \
+    "from $" PASSPHRASE_ENV ", there is never a prompt."
+
+/* environment variable with the passphrase for encrypted keys */
+#define PASSPHRASE_ENV "TINYSSH_CONVERT_PASSPHRASE"
 
 /* system includes */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <ctype.h>
 #include <sys/stat.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 /* local includes */
 #include "errors.h"
@@ -22,33 +53,720 @@
 #include "fileio.h"
 #include "buffer.h"
 #include "openssh-parse.h"
+#include "openssh-stream.h"
+#include "openssh-serialize.h"
+#include "ed25519.h"
 #include "openssh-key.h"
+#include "sha256.h"
+#include "selftest.h"
+#include "cpufeatures.h"
 
 /* the secretkey filename */
 #define SOURCEFN_DEFAULT "/etc/ssh/ssh_host_ed25519_key"
+#define SOURCEFN_STDIN   "-"
 char sourcefn[1024];
 int have_sourcefn = 0;
 
 /* the destination directory */
 #define DESTFN_DEFAULT "/etc/tinyssh/sshkeydir"
+#define REVERSE_DESTFN_DEFAULT "/etc/ssh"
 char destfn[1024];
 int have_destfn = 0;
 
+/* passphrase for encrypted keys, from --passphrase-fd or the environment */
+char passphrase[1024];
+int have_passphrase = 0;
+
 /* buffer to load private key */
 struct buffer *filebuffer = NULL;
 
 /* structure to hold deserialized private key */
 struct opensshkey *privatekey = NULL;
 
+/* the keys of the file at hand, more than one for a bundle */
+struct openssh_key_entry key_entries[OPENSSH_PARSE_MAXKEYS];
+
+/* a bundle is converted to a keydir per key, destination_dir/0, /1 and so on,
+   by threads which take the next key until none is left */
+#define BUNDLE_MAXTHREADS 64
+struct bundle_work {
+    size_t next, nkeys;
+    size_t base;        /* of the keys at hand, when there are more than fit at once */
+    int results[OPENSSH_PARSE_MAXKEYS];
+} bundle;
+
+/* the keys of a bundle while they are converted */
+struct opensshkey_batch bundle_keys;
+
+/* keydirs to convert back to openssh-key-v1 files of this name, with a comment */
+#define REVERSE_KEYFILE_NAME "ssh_host_ed25519_key"
+char **reverse_keydirs = NULL;
+char commentarg[OPENSSHKEY_COMMENT_MAXLEN + 1];
+
+/* public key lines instead of tinyssh keys, or tinyssh public keys alone */
+enum output_formats { OUTPUT_TINYSSH, OUTPUT_AUTHORIZED_KEYS, OUTPUT_KNOWN_HOSTS, OUTPUT_FINGERPRINTS, OUTPUT_INVENTORY,
+                      OUTPUT_TINYSSH_PUBLIC, OUTPUT_OPENSSH };
+
+/* derive the public key of every key from its seed and compare */
+int verify_keys = 0;
+
+/* the ed25519 keys of all .pub and authorized_keys files, in order */
+unsigned char public_keys[OPENSSH_PARSE_MAXKEYS][ED25519_PUBLICKEY_SIZE];
+int output_format = OUTPUT_TINYSSH;
+
+/* hosts for known_hosts lines, taken from the key comment if not given */
+char hostsarg[1024];
+int have_hostsarg = 0;
+
+/* stream for public key lines */
+char outputfn[1024];
+int have_outputfn = 0;
+FILE *output = NULL;
+
+/* lines are collected in a large stdio buffer and written in big chunks */
+#define OUTPUT_BUFFER_SIZE 64*1024
+char output_buffer[OUTPUT_BUFFER_SIZE];
+
+/* fingerprints are collected from this many keys and then hashed at once */
+#define FINGERPRINT_BATCH 64
+struct fingerprint_pending {
+    unsigned char blob[OPENSSHKEY_PUBLIC_BLOB_MAXLEN];
+    size_t bloblen;
+    int bits;
+    const unsigned char *shortname;
+    size_t commentlen;
+    unsigned char comment[OPENSSHKEY_COMMENT_MAXLEN];
+} fingerprint_pending[FINGERPRINT_BATCH];
+size_t fingerprint_npending = 0;
+
+#ifdef STATIC_STORAGE
+/* stdio buffers, so that libc does not malloc them either */
+char stdout_buffer[BUFSIZ], stdin_buffer[BUFSIZ];
+#endif
+
+/* hash all pending public blobs and print them like ssh-keygen -l */
+static int flush_fingerprints ()
+{
+    int e = SUCCESS;
+    const unsigned char *blobs[FINGERPRINT_BATCH];
+    size_t bloblens[FINGERPRINT_BATCH];
+    unsigned char digests[FINGERPRINT_BATCH][SHA256_DIGEST_SIZE];
+    char fp[OPENSSHKEY_FINGERPRINT_SIZE];
+    struct fingerprint_pending *p;
+
+    for (size_t i = 0; i < fingerprint_npending; i++) {
+        blobs[i] = fingerprint_pending[i].blob;
+        bloblens[i] = fingerprint_pending[i].bloblen;
+    }
+    sha256_batch(blobs, bloblens, fingerprint_npending, digests);
+
+    for (size_t i = 0; i < fingerprint_npending && e == SUCCESS; i++) {
+        p = &fingerprint_pending[i];
+        if ((e = opensshkey_format_fingerprint(digests[i], fp, sizeof fp)) != SUCCESS)
+            break;
+        /* ssh-keygen shows keys without a comment like this */
+        if (p->commentlen > 0)
+            fprintf(output, "%d %s %.*s (%s)\n", p->bits, fp, (int)p->commentlen, p->comment, p->shortname);
+        else
+            fprintf(output, "%d %s %s (%s)\n", p->bits, fp, "no comment", p->shortname);
+    }
+    fingerprint_npending = 0;
+
+    if (e == SUCCESS && ferror(output))
+        e = FILEIO_IOERROR;
+    return e;
+}
+
+/* queue a fingerprint, the arguments are only needed until this returns */
+static int queue_fingerprint_blob (const unsigned char *blob, size_t bloblen, int bits,
+                                   const unsigned char *shortname, const unsigned char *comment, size_t commentlen)
+{
+    struct fingerprint_pending *p = &fingerprint_pending[fingerprint_npending];
+
+    if (bloblen > sizeof p->blob)
+        return BUFFER_LENGTH_OVER_MAXIMUM;
+    memcpy(p->blob, blob, bloblen);
+    p->bloblen = bloblen;
+    p->bits = bits;
+    p->shortname = shortname;
+    p->commentlen = commentlen < sizeof p->comment ? commentlen : sizeof p->comment;
+    if (p->commentlen > 0)
+        memcpy(p->comment, comment, p->commentlen);
+
+    if (++fingerprint_npending == FINGERPRINT_BATCH)
+        return flush_fingerprints();
+    return SUCCESS;
+}
+
+/* the fingerprint of a key */
+static int queue_fingerprint (const struct opensshkey *key)
+{
+    int e = FAILURE;
+    unsigned char blob[OPENSSHKEY_PUBLIC_BLOB_MAXLEN];
+    size_t bloblen, commentlen;
+    const unsigned char *comment;
+
+    if ((e = opensshkey_check_comment(key)) != SUCCESS ||
+        (e = opensshkey_get_public_blob(key, blob, sizeof blob, &bloblen)) != SUCCESS)
+            return e;
+    comment = opensshkey_get_comment(key, &commentlen);
+    return queue_fingerprint_blob(blob, bloblen, opensshkey_get_bits(key), opensshkey_get_shortname(key),
+                                  comment, commentlen);
+}
+
+/* a key against its seed with --verify */
+static int verify_key (const struct opensshkey *key)
+{
+    int result;
+
+    if (!verify_keys)
+        return SUCCESS;
+    return opensshkey_verify_batch(&key, 1, &result);
+}
+
+/* a name from a file, which must not break the record it is part of */
+static void write_name (const unsigned char *name, size_t len)
+{
+    if (len == 0)
+        fputc('-', output);
+    for (size_t i = 0; i < len; i++)
+        fputc(isgraph(name[i]) ? name[i] : '?', output);
+}
+
+/* one record for a file read without its private section: cipher, kdf and
+   its rounds, the number of keys and then type and fingerprint of each */
+static int write_inventory (const char *file, const struct openssh_key_v1_public *pub)
+{
+    const unsigned char *blobs[FINGERPRINT_BATCH];
+    size_t bloblens[FINGERPRINT_BATCH], n, typelen;
+    unsigned char digests[FINGERPRINT_BATCH][SHA256_DIGEST_SIZE];
+    char fp[OPENSSHKEY_FINGERPRINT_SIZE];
+    int e;
+
+    fprintf(output, "%s ", file);
+    write_name(pub->ciphername, pub->cipherlen);
+    fputc(' ', output);
+    write_name(pub->kdfname, pub->kdflen);
+    fprintf(output, " %u %zu", pub->rounds, pub->nkeys);
+
+    for (size_t k = 0; k < pub->nkeys; k += n) {
+        n = pub->nkeys - k < FINGERPRINT_BATCH ? pub->nkeys - k : FINGERPRINT_BATCH;
+        for (size_t i = 0; i < n; i++) {
+            blobs[i] = key_entries[k + i].publickey;
+            bloblens[i] = key_entries[k + i].publen;
+        }
+        sha256_batch(blobs, bloblens, n, digests);
+
+        /* the type is the first string of a public key blob */
+        for (size_t i = 0; i < n; i++) {
+            typelen = bloblens[i] >= 4 ? decode_uint32(blobs[i]) : 0;
+            if (typelen > bloblens[i] - 4)
+                typelen = 0;
+            if ((e = opensshkey_format_fingerprint(digests[i], fp, sizeof fp)) != SUCCESS)
+                return e;
+            fputc(' ', output);
+            write_name(blobs[i] + 4, typelen);
+            fprintf(output, " %s", fp);
+        }
+    }
+
+    fputc('\n', output);
+    return ferror(output) ? FILEIO_IOERROR : SUCCESS;
+}
+
+/* derive the keys of the encrypted files among the next ones all at once,
+   so that parsing them finds the keys in the cache. errors are left to the
+   parse, which reads the files again */
+static void prefetch_kdf (char **files, int nfiles)
+{
+    struct kdf_cache_job jobs[KDF_CACHE_BATCH];
+    struct openssh_kdf_params params;
+    size_t njobs = 0;
+
+    for (int i = 0; i < nfiles && njobs < KDF_CACHE_BATCH; i++) {
+        if (loadfile(files[i], &filebuffer) == SUCCESS &&
+            openssh_key_v1_kdf_params(filebuffer, &params) == SUCCESS &&
+            params.keylen > 0 && params.saltlen <= KDF_CACHE_MAXSALTLEN) {
+                memcpy(jobs[njobs].salt, params.salt, params.saltlen);
+                jobs[njobs].saltlen = params.saltlen;
+                jobs[njobs].rounds = params.rounds;
+                jobs[njobs].keylen = params.keylen;
+                njobs++;
+            }
+        freebuffer(filebuffer);
+        filebuffer = NULL;
+    }
+
+    kdf_cache_prefetch(passphrase, strlen(passphrase), jobs, njobs);
+}
+
+/* the lines of a keyfile from the public keys of its header alone, which are
+   in the clear. they have no comment, as with ssh-keygen */
+static int write_public_header (const char *file)
+{
+    int e = FAILURE;
+    struct openssh_key_v1_public pub;
+    const struct keytype *kt;
+    const unsigned char *blob;
+    size_t bloblen;
+
+    /* the index has decoded the buffer in place already, so the file is read again */
+    freebuffer(filebuffer);
+    filebuffer = NULL;
+    if ((e = loadfile(file, &filebuffer)) != SUCCESS ||
+        (e = openssh_key_v1_public(filebuffer, &pub, key_entries, OPENSSH_PARSE_MAXKEYS)) != SUCCESS)
+            return e;
+
+    for (size_t k = 0; k < pub.nkeys && e == SUCCESS; k++) {
+        blob = key_entries[k].publickey;
+        bloblen = key_entries[k].publen;
+        if ((kt = opensshkey_blob_keytype(blob, bloblen)) == NULL)
+            e = OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE;
+        else if (output_format == OUTPUT_FINGERPRINTS)
+            e = queue_fingerprint_blob(blob, bloblen, kt->bits, (const unsigned char *)kt->shortname, NULL, 0);
+        else
+            e = opensshkey_write_blob_line(blob, bloblen,
+                    output_format == OUTPUT_KNOWN_HOSTS ? hostsarg : NULL, output);
+    }
+    return e;
+}
+
+/* write one public key line for each keyfile, keep going after errors */
+static int write_public_lines (char **files, int nfiles)
+{
+    int e, first = SUCCESS;
+    size_t nkeys = 0;
+    char hosts[OPENSSHKEY_COMMENT_MAXLEN + 1];
+    struct openssh_key_v1_public inventory;
+
+    for (int i = 0; i < nfiles; i++) {
+
+        /* an inventory never needs the private section */
+        if (output_format == OUTPUT_INVENTORY) {
+            if ((e = loadfile(files[i], &filebuffer)) == SUCCESS &&
+                (e = openssh_key_v1_public(filebuffer, &inventory, key_entries, OPENSSH_PARSE_MAXKEYS)) == SUCCESS)
+                    e = write_inventory(files[i], &inventory);
+            freebuffer(filebuffer);
+            filebuffer = NULL;
+            if (e != SUCCESS) {
+                eprintf("%s: %s\n", files[i], ereason(e));
+                if (first == SUCCESS)
+                    first = e;
+            }
+            continue;
+        }
+
+        /* unlocking encrypted keys one after another would leave all but
+           a cpu or two idle, so they are derived in batches */
+        if (have_passphrase && *passphrase != '\0' && i % KDF_CACHE_BATCH == 0)
+            prefetch_kdf(files + i, nfiles - i < KDF_CACHE_BATCH ? nfiles - i : KDF_CACHE_BATCH);
+
+        /* load and index, the buffer is recycled for the next file */
+        if ((e = loadfile(files[i], &filebuffer)) == SUCCESS)
+            e = openssh_key_v1_index(filebuffer, have_passphrase ? passphrase : NULL,
+                    key_entries, OPENSSH_PARSE_MAXKEYS, &nkeys);
+
+        /* without a passphrase an encrypted file still has its public keys, the
+           private section is only needed with --verify or for hosts from comments */
+        if (e == OPENSSH_PARSE_PASSPHRASE_REQUIRED && !verify_keys &&
+            (output_format != OUTPUT_KNOWN_HOSTS || have_hostsarg)) {
+                e = write_public_header(files[i]);
+                nkeys = 0;
+        }
+
+        /* a line for every key of a bundle */
+        for (size_t k = 0; e == SUCCESS && k < nkeys; k++) {
+            if ((e = openssh_key_v1_entry(&key_entries[k], &privatekey)) != SUCCESS ||
+                (e = verify_key(privatekey)) != SUCCESS)
+                    break;
+
+            if (output_format == OUTPUT_AUTHORIZED_KEYS)
+                e = opensshkey_write_authorized_keys(privatekey, output);
+
+            else if (output_format == OUTPUT_FINGERPRINTS)
+                e = queue_fingerprint(privatekey);
+
+            else if (have_hostsarg)
+                e = opensshkey_write_known_hosts(privatekey, hostsarg, output);
+
+            else if ((e = opensshkey_comment_hosts(privatekey, hosts, sizeof hosts)) == SUCCESS)
+                e = opensshkey_write_known_hosts(privatekey, hosts, output);
+
+            freeopensshkey(privatekey);
+            privatekey = NULL;
+        }
+
+        freebuffer(filebuffer);
+        filebuffer = NULL;
+
+        /* report, but continue with the next file */
+        if (e != SUCCESS) {
+            eprintf("%s: %s\n", files[i], ereason(e));
+            if (first == SUCCESS)
+                first = e;
+        }
+    }
+
+    /* the last, incomplete batch */
+    if (fingerprint_npending > 0 && (e = flush_fingerprints()) != SUCCESS && first == SUCCESS)
+        first = e;
+
+    return first;
+}
+
+/* parse a single key while it is read from fd, which stops at the end marker
+   so that a writer keeping the pipe or socket open is not waited for */
+static int stream_key (int fd)
+{
+    int e = FAILURE;
+    struct openssh_key_v1_stream stream = { .decoded = NULL };
+    unsigned char chunk[FILEIO_CHUNKSIZE];
+    size_t len, nkeys;
+
+    if ((privatekey = newopensshkey(KEY_UNKNOWN)) == NULL)
+        return OPENSSH_KEY_ALLOCATION_FAILURE;
+    if ((e = openssh_key_v1_stream_init(&stream, have_passphrase ? passphrase : NULL, privatekey, 1)) != SUCCESS)
+        cleanreturn(e);
+
+    /* errors in the header are reported before the rest is read */
+    while (!openssh_key_v1_stream_done(&stream)) {
+        if ((e = readchunk(fd, chunk, sizeof chunk, &len)) != SUCCESS ||
+            (e = openssh_key_v1_stream_push(&stream, chunk, len)) != SUCCESS)
+                cleanreturn(e);
+        if (len == 0)
+            break;
+    }
+    e = openssh_key_v1_stream_final(&stream, &nkeys);
+
+    cleanup:
+        openssh_key_v1_stream_free(&stream);
+        memzero(chunk, sizeof chunk);
+
+    return e;
+}
+
+/* read the ed25519 keys of all public key files first, which only decodes
+   their base64, and then write the keydirs. the layout follows bundles:
+   a single key goes to destination_dir, several to destination_dir/0, /1 ... */
+static int convert_public (char **files, int nfiles)
+{
+    int e, first = SUCCESS;
+    size_t nkeys = 0, n, lineno, failed = 0;
+    char dir[sizeof destfn + 24];
+
+    for (int i = 0; i < nfiles; i++) {
+        if ((e = loadfile(files[i], &filebuffer)) == SUCCESS)
+            e = openssh_public_lines_ed25519((const char *)buffer_get_dataptr(filebuffer),
+                    buffer_get_datasize(filebuffer), public_keys + nkeys, OPENSSH_PARSE_MAXKEYS - nkeys,
+                    &n, &lineno);
+        freebuffer(filebuffer);
+        filebuffer = NULL;
+
+        /* none of the keys of a file with a bad line are used */
+        if (e != SUCCESS) {
+            if (e == OPENSSH_PARSE_INVALID_FORMAT || e == BUFFER_INVALID_FORMAT)
+                eprintf("%s:%zu: %s\n", files[i], lineno, ereason(e));
+            else
+                eprintf("%s: %s\n", files[i], ereason(e));
+            if (first == SUCCESS)
+                first = e;
+            continue;
+        }
+        nkeys += n;
+    }
+    if (nkeys == 0)
+        return first != SUCCESS ? first : OPENSSH_PARSE_UNSUPPORTED_KEY_TYPE;
+
+    if (!have_destfn &&
+        (e = prompt ("Enter a destination directory", destfn, sizeof destfn, DESTFN_DEFAULT)) != SUCCESS)
+            return e;
+
+    for (size_t k = 0; k < nkeys; k++) {
+        if (nkeys == 1)
+            snprintf(dir, sizeof dir, "%s", destfn);
+        else
+            snprintf(dir, sizeof dir, "%s/%zu", destfn, k);
+        if (nkeys > 1 && mkdir(dir, 0755) != 0 && errno != EEXIST)
+            e = FILEIO_CANNOT_CREATE_DIRECTORY;
+        else
+            e = opensshkey_save_public_to_tinyssh(public_keys[k], (const unsigned char *)dir);
+        if (e != SUCCESS) {
+            eprintf("key %zu: %s\n", k, ereason(e));
+            if (failed++ == 0 && first == SUCCESS)
+                first = e;
+        }
+    }
+
+    if (nkeys == 1 && failed == 0)
+        printf("Wrote the public key to %s\n", destfn);
+    else if (nkeys > 1)
+        printf("Wrote %zu of %zu public keys to %s/0 .. %s/%zu\n", nkeys - failed, nkeys, destfn, destfn, nkeys - 1);
+    return first;
+}
+
+/* deserialize keys of the bundle into their slots of the batch and save each
+   to its own keydir. with --verify a thread takes a batch of keys at a time,
+   which are checked together */
+static void *convert_bundle_work (void *arg)
+{
+    int verified[ED25519_BATCH];
+    size_t first, n;
+    const size_t batch = verify_keys ? ED25519_BATCH : 1;
+    char dir[sizeof destfn + 24];
+    int *results;
+
+    (void)arg;
+    while ((first = __atomic_fetch_add(&bundle.next, batch, __ATOMIC_RELAXED)) < bundle.nkeys) {
+        n = bundle.nkeys - first < batch ? bundle.nkeys - first : batch;
+        results = bundle.results + first;
+
+        for (size_t k = 0; k < n; k++)
+            results[k] = openssh_key_v1_entry_batch(&key_entries[first + k], &bundle_keys, first + k);
+
+        /* keys which did not parse keep their error */
+        if (verify_keys) {
+            opensshkey_batch_verify(&bundle_keys, first, n, verified);
+            for (size_t k = 0; k < n; k++)
+                if (results[k] == SUCCESS)
+                    results[k] = verified[k];
+        }
+
+        for (size_t k = 0; k < n; k++) {
+            if (results[k] != SUCCESS)
+                continue;
+            snprintf(dir, sizeof dir, "%s/%zu", destfn, first + k);
+            if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+                results[k] = FILEIO_CANNOT_CREATE_DIRECTORY;
+            else
+                results[k] = opensshkey_batch_save_to_tinyssh(&bundle_keys, first + k, (const unsigned char *)dir);
+        }
+    }
+
+    /* buffers this thread freed are cached in its pool */
+    buffer_pool_drain();
+    return NULL;
+}
+
+/* run work on one thread per cpu until all keys of the bundle are taken,
+   then report those which failed. failed is set to their number */
+static int run_bundle (void *(*work) (void *), size_t nkeys, size_t *failed)
+{
+    int e = SUCCESS;
+    size_t nthreads = 1;
+#ifdef HAVE_PTHREAD
+    pthread_t threads[BUNDLE_MAXTHREADS];
+    int started[BUNDLE_MAXTHREADS];
+#endif
+
+    bundle.next = 0;
+    bundle.nkeys = nkeys;
+    *failed = 0;
+
+    /* the keys are independent, but the malloc-free profile has a single key slot */
+#if defined(HAVE_PTHREAD) && !defined(STATIC_STORAGE)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 1)
+        nthreads = (size_t)cpus < nkeys ? (size_t)cpus : nkeys;
+    if (nthreads > BUNDLE_MAXTHREADS)
+        nthreads = BUNDLE_MAXTHREADS;
+    for (size_t t = 1; t < nthreads; t++)
+        started[t] = pthread_create(&threads[t], NULL, work, NULL) == 0;
+#endif
+    work(NULL);
+#ifdef HAVE_PTHREAD
+    for (size_t t = 1; t < nthreads; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+#else
+    (void)nthreads;
+#endif
+
+    for (size_t k = 0; k < nkeys; k++)
+        if (bundle.results[k] != SUCCESS) {
+            eprintf("key %zu: %s\n", bundle.base + k, ereason(bundle.results[k]));
+            if ((*failed)++ == 0)
+                e = bundle.results[k];
+        }
+    return e;
+}
+
+/* convert all keys of an indexed bundle, report those which failed */
+static int convert_bundle (size_t nkeys)
+{
+    size_t failed;
+    int e;
+
+    bundle.base = 0;
+    opensshkey_batch_init(&bundle_keys);
+    e = run_bundle(convert_bundle_work, nkeys, &failed);
+    opensshkey_batch_wipe(&bundle_keys);
+    printf("Converted %zu of %zu keys to %s/0 .. %s/%zu\n", nkeys - failed, nkeys, destfn, destfn, nkeys - 1);
+    return e;
+}
+
+/* read keydirs back and write each as an openssh-key-v1 file, to destination_dir
+   for a single one and to destination_dir/0, /1 ... for several */
+static void *reverse_bundle_work (void *arg)
+{
+    struct opensshkey key;
+    char dir[sizeof destfn + 24], file[sizeof dir + sizeof REVERSE_KEYFILE_NAME + 1];
+    size_t k, i;
+    int e;
+
+    (void)arg;
+    while ((k = __atomic_fetch_add(&bundle.next, 1, __ATOMIC_RELAXED)) < bundle.nkeys) {
+        i = bundle.base + k;
+        if (bundle.base == 0 && bundle.nkeys == 1)
+            snprintf(dir, sizeof dir, "%s", destfn);
+        else
+            snprintf(dir, sizeof dir, "%s/%zu", destfn, i);
+        snprintf(file, sizeof file, "%s/%s", dir, REVERSE_KEYFILE_NAME);
+
+        if ((e = opensshkey_load_from_tinyssh(&key, (const unsigned char *)reverse_keydirs[i])) == SUCCESS) {
+            if ((e = verify_key(&key)) != SUCCESS)
+                ;
+            else if (strcmp(dir, destfn) != 0 && mkdir(dir, 0755) != 0 && errno != EEXIST)
+                e = FILEIO_CANNOT_CREATE_DIRECTORY;
+            else if ((e = opensshkey_set_comment(&key, (const unsigned char *)commentarg, strlen(commentarg))) == SUCCESS)
+                e = openssh_key_v1_save(&key, file);
+            opensshkey_wipe(&key);
+        }
+        bundle.results[k] = e;
+    }
+
+    /* the buffers of the files written, as above */
+    buffer_pool_drain();
+    return NULL;
+}
+
+/* convert keydirs back, as many at once as a bundle may hold */
+static int reverse_keydirs_to_openssh (char **keydirs, int nkeydirs)
+{
+    int e, first = SUCCESS;
+    size_t n, failed, converted = 0, total = nkeydirs;
+
+    if (!have_destfn &&
+        (e = prompt ("Enter a destination directory", destfn, sizeof destfn, REVERSE_DESTFN_DEFAULT)) != SUCCESS)
+            return e;
+
+    reverse_keydirs = keydirs;
+    for (bundle.base = 0; bundle.base < total; bundle.base += n) {
+        n = total - bundle.base < OPENSSH_PARSE_MAXKEYS ? total - bundle.base : OPENSSH_PARSE_MAXKEYS;
+        if ((e = run_bundle(reverse_bundle_work, n, &failed)) != SUCCESS && first == SUCCESS)
+            first = e;
+        converted += n - failed;
+    }
+
+    if (total == 1 && converted == 1)
+        printf("Converted the keydir to %s/%s\n", destfn, REVERSE_KEYFILE_NAME);
+    else if (total > 1)
+        printf("Converted %zu of %zu keydirs to %s/0 .. %s/%zu\n", converted, total, destfn, destfn, total - 1);
+    return first;
+}
+
+/* long options, which have no short equivalent */
+enum long_options { OPT_CPU_FEATURES = 256, OPT_SELF_TEST, OPT_BENCHMARK, OPT_PASSPHRASE_FD, OPT_VERIFY };
+static const struct option long_options[] = {
+    { "cpu-features",   no_argument,    NULL,   OPT_CPU_FEATURES },
+    { "self-test",      no_argument,    NULL,   OPT_SELF_TEST },
+    { "benchmark",      no_argument,    NULL,   OPT_BENCHMARK },
+    { "passphrase-fd",  required_argument, NULL, OPT_PASSPHRASE_FD },
+    { "verify",         no_argument,    NULL,   OPT_VERIFY },
+    { NULL,             0,              NULL,   0 },
+};
+
+/* convert the key of one keyfile, or a bundle unless there are several keyfiles */
+static int convert_keyfile (const char *file, int several)
+{
+    int e = FAILURE;
+    const unsigned char *comment;
+    size_t commentlen, nkeys;
+    char fingerprint[OPENSSHKEY_FINGERPRINT_SIZE];
+
+    /* a key on stdin is parsed while it arrives */
+    if (strcmp(file, SOURCEFN_STDIN) == 0) {
+        if ((e = stream_key(STDIN_FILENO)) != SUCCESS)
+            cleanreturn(e);
+    }
+    else {
+        /* load to buffer */
+        if ((e = loadfile(file, &filebuffer)) != 0)
+            cleanreturn(e);
+
+        /* index the keys of the file */
+        if ((e = openssh_key_v1_index(filebuffer, have_passphrase ? passphrase : NULL,
+                key_entries, OPENSSH_PARSE_MAXKEYS, &nkeys)) != SUCCESS)
+            cleanreturn(e);
+
+        /* a bundle goes to one keydir per key, which the keys of other files would share */
+        if (nkeys > 1 && several)
+            cleanreturn(OPENSSH_PARSE_UNSUPPORTED_MULTIPLEKEYS);
+        if (nkeys > 1) {
+            printf("Found a bundle of %zu keys\n", nkeys);
+            if (!have_destfn &&
+                (e = prompt ("Enter a destination directory", destfn, sizeof destfn, DESTFN_DEFAULT)) != SUCCESS)
+                    cleanreturn(e);
+            cleanreturn(convert_bundle(nkeys));
+        }
+
+        /* parse as opensshkey */
+        if ((e = openssh_key_v1_entry(&key_entries[0], &privatekey))!= SUCCESS)
+            cleanreturn(e);
+    }
+    if ((e = verify_key(privatekey)) != SUCCESS)
+        cleanreturn(e);
+    comment = opensshkey_get_comment(privatekey, &commentlen);
+    printf("Successfully parsed %s key with comment: %.*s\n", opensshkey_get_typename(privatekey), (int)commentlen, comment);
+    if ((e = opensshkey_fingerprint(privatekey, fingerprint, sizeof fingerprint)) != SUCCESS)
+        cleanreturn(e);
+    printf("Key fingerprint is %s\n", fingerprint);
+
+    /* ask for destination, once for all keyfiles */
+    if (!have_destfn) {
+        if ((e = prompt ("Enter a destination directory", destfn, sizeof destfn, DESTFN_DEFAULT)) != SUCCESS)
+            cleanreturn(e);
+        have_destfn = 1;
+    }
+
+    /* export tinyssh keys */
+    e = opensshkey_save_to_tinyssh(privatekey, destfn);
+
+    cleanup:
+        freebuffer(filebuffer);
+        filebuffer = NULL;
+        freeopensshkey(privatekey);
+        privatekey = NULL;
+
+    return e;
+}
+
+/* the keys of several keyfiles into the same keydir, such as the ed25519 and
+   the ecdsa host key, which have files of their own. keep going after errors */
+static int convert_keyfiles (char **files, int nfiles)
+{
+    int e, first = SUCCESS;
+
+    for (int i = 0; i < nfiles; i++)
+        if ((e = convert_keyfile(files[i], 1)) != SUCCESS) {
+            eprintf("%s: %s\n", files[i], ereason(e));
+            if (first == SUCCESS)
+                first = e;
+        }
+    return first;
+}
+
 /* ======  MAIN  ====== */
 
 int main(int argc, char **argv)
 {
 	int opt, e;
+    long fd;
+    char *end, *env;
 	extern char *optarg;
+	extern int optind;
 
     /* parse arguments */
-	while ((opt = getopt(argc, argv, "?hvf:d:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "?hvf:d:akliH:o:prC:", long_options, NULL)) != -1) {
 		switch (opt) {
 
         /* filename */
@@ -64,6 +782,56 @@ int main(int argc, char **argv)
 			    fatale(ERR_BAD_ARGUMENT);
 			have_destfn = 1;
 			break;
+
+        /* public key lines */
+        case 'a':
+        case 'k':
+        case 'l':
+        case 'i':
+            if (output_format != OUTPUT_TINYSSH)
+                usage();
+            output_format = opt == 'a' ? OUTPUT_AUTHORIZED_KEYS :
+                            opt == 'k' ? OUTPUT_KNOWN_HOSTS :
+                            opt == 'l' ? OUTPUT_FINGERPRINTS : OUTPUT_INVENTORY;
+            break;
+
+        /* tinyssh public keys from public key files */
+        case 'p':
+            if (output_format != OUTPUT_TINYSSH)
+                usage();
+            output_format = OUTPUT_TINYSSH_PUBLIC;
+            break;
+
+        /* keydirs back to openssh keys */
+        case 'r':
+            if (output_format != OUTPUT_TINYSSH)
+                usage();
+            output_format = OUTPUT_OPENSSH;
+            break;
+
+        /* comment of keys converted back */
+        case 'C':
+			if (strlen(optarg) >= sizeof commentarg)
+			    fatale(ERR_BAD_ARGUMENT);
+			strcpy(commentarg, optarg);
+			break;
+
+        /* hosts for known_hosts */
+        case 'H':
+			if (strlen(optarg) >= sizeof hostsarg)
+			    fatale(ERR_BAD_ARGUMENT);
+			if ((e = opensshkey_check_hosts(optarg)) != SUCCESS)
+			    fatal(e, "%s: %s\n", optarg, ereason(e));
+			strcpy(hostsarg, optarg);
+			have_hostsarg = 1;
+			break;
+
+        /* output stream for lines */
+        case 'o':
+			if (strncpy(outputfn, optarg, sizeof outputfn) == NULL)
+			    fatale(ERR_BAD_ARGUMENT);
+			have_outputfn = 1;
+			break;
         
         /* version display */
         case 'v':
@@ -75,6 +843,38 @@ int main(int argc, char **argv)
             exit(0);
             break;
 
+        /* detected cpu features and selected kernels */
+        case OPT_CPU_FEATURES:
+            cpu_features_dump(stdout);
+            exit(0);
+            break;
+
+        /* kernels against the reference code */
+        case OPT_SELF_TEST:
+            if ((e = selftest_run(stdout)) != SUCCESS)
+                fatale(e);
+            exit(0);
+            break;
+
+        case OPT_BENCHMARK:
+            exit(selftest_bench(stdout));
+            break;
+
+        /* passphrase from a pipe or file, the first line */
+        case OPT_PASSPHRASE_FD:
+            fd = strtol(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || fd < 0)
+                fatale(ERR_BAD_ARGUMENT);
+            if ((e = loadpassphrase(fd, passphrase, sizeof passphrase)) != SUCCESS)
+                fatale(e);
+            have_passphrase = 1;
+            break;
+
+        /* check every key against its seed */
+        case OPT_VERIFY:
+            verify_keys = 1;
+            break;
+
         case 'h':
 		case '?':
 		default:
@@ -82,31 +882,73 @@ int main(int argc, char **argv)
 		}
 	}
 
-    /* prompt for source if not given */
-    if (!have_sourcefn &&
-        (e = prompt ("Enter a source filename", sourcefn, sizeof sourcefn, SOURCEFN_DEFAULT)) != SUCCESS)
-            cleanreturn(e);
+#ifdef STATIC_STORAGE
+    setvbuf(stdout, stdout_buffer, _IOLBF, sizeof stdout_buffer);
+    setvbuf(stdin,  stdin_buffer,  _IOLBF, sizeof stdin_buffer);
+#endif
 
-    /* load to buffer */
-    if ((e = loadfile(sourcefn, &filebuffer)) != 0)
-        cleanreturn(e);
+    /* passphrase from the environment, unless given on a file descriptor */
+    if (!have_passphrase && (env = getenv(PASSPHRASE_ENV)) != NULL) {
+        if (strlen(env) >= sizeof passphrase)
+            fatale(FILEIO_PASSPHRASE_TOO_LONG);
+        strcpy(passphrase, env);
+        have_passphrase = 1;
+    }
 
-    /* parse as opensshkey */
-    if ((e = openssh_key_v1_parse(filebuffer, &privatekey))!= SUCCESS)
-        cleanreturn(e);
+    /* probe the cpu once and install all kernels */
+    cpu_dispatch();
 
-    /* ask for destination */
-    if (!have_destfn &&
-        (e = prompt ("Enter a destination directory", destfn, sizeof destfn, DESTFN_DEFAULT)) != SUCCESS)
+    /* prompt for source if neither -f nor any keyfile is given */
+    if (output_format == OUTPUT_TINYSSH && !have_sourcefn && optind >= argc) {
+        if ((e = prompt ("Enter a source filename", sourcefn, sizeof sourcefn, SOURCEFN_DEFAULT)) != SUCCESS)
             cleanreturn(e);
+        have_sourcefn = 1;
+    }
 
-    /* export tinyssh keys */
-    if ((e = opensshkey_save_to_tinyssh(privatekey, destfn)) != 0)
+    /* -f is just the first of the files, put it in front of the others
+       in place of the last option, which getopt has already consumed */
+    if (have_sourcefn)
+        argv[--optind] = sourcefn;
+    if (optind >= argc)
+        usage();
+
+    /* openssh keys for a batch of keydirs */
+    if (output_format == OUTPUT_OPENSSH)
+        cleanreturn(reverse_keydirs_to_openssh(argv + optind, argc - optind));
+
+    /* tinyssh public keys for a batch of public key files */
+    if (output_format == OUTPUT_TINYSSH_PUBLIC)
+        cleanreturn(convert_public(argv + optind, argc - optind));
+
+    /* write public key lines for a batch of keyfiles to one stream */
+    if (output_format != OUTPUT_TINYSSH) {
+
+        if (!have_outputfn)
+            output = stdout;
+        else if ((output = fopen(outputfn, "w")) == NULL)
+            cleanreturn(FILEIO_CANNOT_OPEN_WRITING);
+        setvbuf(output, output_buffer, _IOFBF, sizeof output_buffer);
+
+        e = write_public_lines(argv + optind, argc - optind);
+        if (fflush(output) != 0 && e == SUCCESS)
+            e = FILEIO_IOERROR;
         cleanreturn(e);
+    }
+
+    /* tinyssh keys of one keyfile, or of several into the same keydir */
+    if (argc - optind == 1)
+        e = convert_keyfile(argv[optind], 0);
+    else
+        e = convert_keyfiles(argv + optind, argc - optind);
 
     cleanup:
         freebuffer(filebuffer);
         freeopensshkey(privatekey);
+        buffer_pool_drain();
+        kdf_cache_clear();
+        if (output != NULL && output != stdout)
+            fclose(output);
+        memzero(passphrase, sizeof passphrase);
 
     if (e != SUCCESS)
         fatale(e);
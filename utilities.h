@@ -20,13 +20,20 @@
 
 /* volatile memset to try & avoid optmising it away */
 static void * (* const volatile volatile_memset)(void *,  int, size_t) = memset;
-#define memzero(ptr, size)       volatile_memset(   ptr,    0,   size)
+#ifdef HAVE_EXPLICIT_BZERO
+# define memzero(ptr, size)      explicit_bzero(    ptr,         size)
+#else
+# define memzero(ptr, size)      volatile_memset(   ptr,    0,   size)
+#endif
 #define memfill(ptr, size, fill) volatile_memset(   ptr, fill,   size)
 
 /* shorthand for zeroing, freeing and NULLing pointers */
 #define nullpointer(ptr, size) if (ptr != NULL) { memzero(ptr, size); free(ptr); ptr = NULL; }
 
 
+/* compare a non-terminated string of given length to a literal */
+#define memeqstr(ptr, len, str) ((len) == strlen(str) && memcmp(ptr, str, len) == 0)
+
 /* check if a string is not zero and not empty */
 extern int strnzero (const char *str);
 